@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "array.hpp"
+#include "heap.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+
+// The bulk kernels against the one-element-at-a-time loop they replace, on
+// the same double elements, and a program whose reduction loop runs in the
+// VM against one that calls the dot builtin instead, and the collector on a
+// program that makes short-lived arrays, with nurseries of several sizes.
+
+static volatile double sink;
+
+static void kernels(std::size_t size) {
+	auto name = std::string("arrays.kernels");
+	if (!selected(name)) {
+		return;
+	}
+	Heap heap;
+	Heap::Scope scope(heap);
+	auto value = Array::make(ValueType::DOUBLE, size, true);
+	auto& array = value.as_array();
+	for (std::size_t i = 0; i < size; ++i) {
+		array.set(i, static_cast<double>(i % 1000) / 7);
+	}
+	std::vector<double> elements(size);
+	for (std::size_t i = 0; i < size; ++i) {
+		elements[i] = array.get(i).as_double();
+	}
+
+	auto sum = measure([&] { sink = array.sum().as_double(); });
+	auto dot = measure([&] { sink = array.dot(array).as_double(); });
+	auto max = measure([&] { sink = array.max().as_double(); });
+	auto scalar_sum = measure([&] {
+		double total = 0;
+		for (auto element : elements) {
+			total += element;
+		}
+		sink = total;
+	});
+	auto scalar_dot = measure([&] {
+		double total = 0;
+		for (auto element : elements) {
+			total += element * element;
+		}
+		sink = total;
+	});
+	auto scalar_max = measure([&] {
+		double result = elements[0];
+		for (auto element : elements) {
+			if (result != result || element > result) {
+				result = element;
+			}
+		}
+		sink = result;
+	});
+	report(name) << " elements=" << size << " sum_ms=" << sum * 1e3 << " dot_ms=" << dot * 1e3 << " max_ms=" << max * 1e3
+		<< " sum_speedup=" << scalar_sum / sum << " dot_speedup=" << scalar_dot / dot << " max_speedup=" << scalar_max / max << "\n";
+}
+
+// The heap statistics are those of the last run
+static int run(const Workload& workload, double& seconds, std::size_t nursery_size = Heap::default_nursery_size, Heap::Stats* heap = nullptr) {
+	auto unit = Parser(TokenStream(Lexer(workload.source))).parse();
+	Resolver().resolve(*unit);
+	auto program = Compiler().compile(*unit);
+	std::ostringstream output;
+	int status = 0;
+	seconds = measure([&] {
+		VirtualMachine machine(program, output, nullptr, SIZE_MAX, true, nursery_size);
+		status = machine.run();
+		if (heap) {
+			*heap = machine.heap_stats();
+		}
+	}, 3);
+	return status;
+}
+
+static void reduction(std::size_t size) {
+	auto name = std::string("arrays.reduction");
+	if (!selected(name)) {
+		return;
+	}
+	auto loop = array_reduction(size, false), builtin = array_reduction(size, true);
+	double loop_seconds, builtin_seconds;
+	auto loop_status = run(loop, loop_seconds), builtin_status = run(builtin, builtin_seconds);
+	if (loop_status != builtin_status) {
+		std::cerr << name << ": programs disagree (" << loop_status << " vs " << builtin_status << ")\n";
+	}
+	report(name) << " elements=" << size << " loop_ops_s=" << loop.operations / loop_seconds
+		<< " builtin_ops_s=" << builtin.operations / builtin_seconds << " speedup=" << loop_seconds / builtin_seconds << "\n";
+}
+
+static void collection(std::size_t size) {
+	auto name = std::string("arrays.collection");
+	if (!selected(name)) {
+		return;
+	}
+	auto churn = array_churn(size);
+	for (std::size_t nursery_size : {std::size_t(64) << 10, std::size_t(1) << 20, Heap::default_nursery_size, std::size_t(16) << 20}) {
+		double seconds;
+		Heap::Stats heap;
+		run(churn, seconds, nursery_size, &heap);
+		auto pause = std::chrono::duration<double>(heap.pause).count();
+		report(name) << " nursery_kb=" << (nursery_size >> 10) << " arrays_s=" << churn.operations / seconds
+			<< " minor=" << heap.minor_collections << " major=" << heap.major_collections
+			<< " pause_share=" << pause / seconds << " longest_pause_us=" << std::chrono::duration<double, std::micro>(heap.longest_pause).count()
+			<< " peak_kb=" << (heap.peak_bytes >> 10) << "\n";
+	}
+}
+
+void run_array_benchmarks() {
+	kernels(scaled(1 << 16));
+	reduction(scaled(1 << 20));
+	collection(scaled(1 << 20));
+}
@@ -0,0 +1,65 @@
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "counter.hpp"
+#include "printer.hpp"
+#include "flat_ast.hpp"
+
+// The flat tree against the node classes it is built from: the cost of
+// building it, its size, and two walks over each, counting the nodes and
+// printing the source to a stream that discards it.
+
+static std::size_t count(const FlatTree& tree, FlatTree::Index node) {
+	std::size_t nodes = 1;
+	tree.for_each_child(node, [&](FlatTree::Index child) { nodes += count(tree, child); });
+	return nodes;
+}
+
+static void compare(const Shape& shape) {
+	auto name = std::string("ast.") + shape.name;
+	if (!selected(name)) {
+		return;
+	}
+	auto source = shape.generate(scaled(1 << 20));
+	auto unit = Parser(TokenStream(Lexer(source))).parse();
+	auto parse = measure([&] { Parser(TokenStream(Lexer(source))).parse(); });
+	auto flatten = measure([&] { FlatTree tree(*unit); });
+	FlatTree tree(*unit);
+
+	std::size_t nodes = 0, flat_nodes = 0;
+	auto visit_count = measure([&] { nodes = NodeCounter().count(*unit); });
+	auto flat_count = measure([&] {
+		flat_nodes = 0;
+		for (auto declaration : tree.declarations()) {
+			flat_nodes += count(tree, declaration);
+		}
+	});
+	// The unit itself is a node for the NodeCounter
+	if (nodes != flat_nodes + 1) {
+		std::cerr << name << ": node counts disagree (" << nodes << " vs " << flat_nodes << ")\n";
+	}
+
+	std::ostringstream printed, flat_printed;
+	Printer(printed).visit(*unit);
+	tree.print(flat_printed);
+	if (printed.view() != flat_printed.view()) {
+		std::cerr << name << ": printed sources differ\n";
+	}
+	std::ostream discard(nullptr);
+	auto visit_print = measure([&] { Printer printer(discard); unit->accept(printer); });
+	auto flat_print = measure([&] { tree.print(discard); });
+
+	report(name) << " nodes=" << flat_nodes << " arena_bytes=" << unit->arena.stats().bytes_used << " flat_bytes=" << tree.bytes()
+		<< " parse_ms=" << parse * 1e3 << " flatten_ms=" << flatten * 1e3
+		<< " count_speedup=" << visit_count / flat_count << " print_speedup=" << visit_print / flat_print << "\n";
+}
+
+void run_ast_benchmarks() {
+	for (auto& shape : shapes) {
+		compare(shape);
+	}
+}
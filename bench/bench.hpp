@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Settings from the command line: bin/bench [--scale=F] [--repetitions=N]
+// [--filter=TEXT]. Sizes of the generated programs are multiplied by scale.
+struct Config {
+	double scale = 1.0;
+	int repetitions = 5;
+	std::string filter;
+};
+
+extern Config config;
+
+// Best wall-clock time in seconds over the given number of runs.
+template<typename Function>
+double measure(Function function, int repetitions = config.repetitions) {
+	double best = 1e300;
+	for (int i = 0; i < repetitions; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+// Measurements are printed as one "suite.case key=value ..." line each, with
+// a fixed number of significant digits so runs can be diffed.
+bool selected(std::string_view);
+std::ostream& report(std::string_view);
+
+// Synthetic programs. Every generator returns a complete program with a main
+// function; the source-shaped ones grow to roughly the requested byte size.
+struct Shape {
+	const char* name;
+	std::string (*generate)(std::size_t);
+};
+
+std::string deep_expressions(std::size_t);
+std::string many_functions(std::size_t);
+std::string comment_blocks(std::size_t);
+std::string long_lines(std::size_t);
+
+inline constexpr Shape shapes[] = {
+	{"deep_expressions", deep_expressions},
+	{"many_functions", many_functions},
+	{"comment_blocks", comment_blocks},
+	{"long_lines", long_lines},
+};
+
+// Programs for the engines, with the number of operations they perform.
+struct Workload {
+	std::string source;
+	std::size_t operations;
+};
+
+Workload long_loop(std::size_t);
+Workload recursive_calls(int);
+Workload array_reduction(std::size_t, bool);
+Workload array_churn(std::size_t);
+Workload string_building(std::size_t, bool);
+
+std::size_t scaled(std::size_t);
+
+void run_lexer_benchmarks();
+void run_parser_benchmarks();
+void run_ast_benchmarks();
+void run_engine_benchmarks();
+void run_array_benchmarks();
+void run_string_benchmarks();
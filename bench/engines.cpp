@@ -0,0 +1,46 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "evaluator.hpp"
+
+// Operations per second of the bytecode VM, with and without its native
+// tier, and the tree-walking Evaluator on a loop-heavy and a call-heavy
+// program. Compilation is timed with the VM.
+
+static void compare(const char* workload_name, const Workload& workload) {
+	auto name = std::string("engines.") + workload_name;
+	if (!selected(name)) {
+		return;
+	}
+	auto unit = Parser(TokenStream(Lexer(workload.source))).parse();
+	Resolver().resolve(*unit);
+	std::ostringstream output;
+	int ast_status = 0, vm_status = 0, jit_status = 0;
+	auto ast = measure([&] { ast_status = Evaluator(output).run(*unit); }, 3);
+	auto vm = measure([&] {
+		auto program = Compiler().compile(*unit);
+		vm_status = VirtualMachine(program, output, nullptr, SIZE_MAX, false).run();
+	}, 3);
+	auto jit = measure([&] {
+		auto program = Compiler().compile(*unit);
+		jit_status = VirtualMachine(program, output).run();
+	}, 3);
+	if (ast_status != vm_status || vm_status != jit_status) {
+		std::cerr << name << ": engines disagree (" << ast_status << " vs " << vm_status << " vs " << jit_status << ")\n";
+	}
+	report(name) << " ops=" << workload.operations << " vm_ops_s=" << workload.operations / vm
+		<< " jit_ops_s=" << workload.operations / jit << " ast_ops_s=" << workload.operations / ast
+		<< " speedup=" << ast / vm << " jit_speedup=" << vm / jit << "\n";
+}
+
+void run_engine_benchmarks() {
+	compare("loop", long_loop(scaled(2000000)));
+	compare("calls", recursive_calls(25));
+}
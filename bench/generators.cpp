@@ -0,0 +1,162 @@
+#include <string>
+
+#include "bench.hpp"
+
+// Nested arithmetic over the parameters, 48 levels deep per function.
+std::string deep_expressions(std::size_t size) {
+	std::string source;
+	for (std::size_t index = 0; source.size() < size; ++index) {
+		std::string expression = "a";
+		for (int depth = 0; depth < 48; ++depth) {
+			static const char* operators[] = {" + ", " * ", " - ", " % "};
+			expression = "(" + expression + operators[depth % 4] + (depth % 3 ? "b" : std::to_string(depth + 1)) + ")";
+		}
+		source += "int deep" + std::to_string(index) + "(int a, int b) {\n\treturn " + expression + ";\n}\n";
+	}
+	return source + "int main() {\n\treturn deep0(3, 5) % 256;\n}\n";
+}
+
+// Small functions with locals, a loop, a branch and a call to the previous one.
+std::string many_functions(std::size_t size) {
+	std::string source = "int f0(int n) {\n\treturn n;\n}\n";
+	std::size_t index = 1;
+	for (; source.size() < size; ++index) {
+		auto name = "f" + std::to_string(index);
+		auto previous = "f" + std::to_string(index - 1);
+		source += "int " + name + "(int n) {\n"
+			"\tint total = 0;\n"
+			"\tint i = 0;\n"
+			"\twhile (i < n) {\n"
+			"\t\tif (i % 2 == 0) {\n"
+			"\t\t\ttotal += i * 3;\n"
+			"\t\t} else {\n"
+			"\t\t\ttotal -= 1;\n"
+			"\t\t}\n"
+			"\t\ti++;\n"
+			"\t}\n"
+			"\treturn total + " + previous + "(n - 1);\n"
+			"}\n";
+	}
+	return source + "int main() {\n\treturn f" + std::to_string(index - 1) + "(2) % 256;\n}\n";
+}
+
+// Mostly block and line comments around a few declarations.
+std::string comment_blocks(std::size_t size) {
+	std::string block = "/*\n";
+	for (int line = 0; line < 20; ++line) {
+		block += " * Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod.\n";
+	}
+	block += " */\n";
+	std::string source;
+	for (std::size_t index = 0; source.size() < size; ++index) {
+		source += block + "// " + std::string(100, '-') + "\nint g" + std::to_string(index) + " = " + std::to_string(index) + "; // trailing note\n";
+	}
+	return source + "int main() {\n\treturn g0;\n}\n";
+}
+
+// Long identifiers, long literals and deep indentation.
+std::string long_lines(std::size_t size) {
+	std::string source;
+	for (std::size_t index = 0; source.size() < size; ++index) {
+		auto name = "a_rather_long_and_descriptive_variable_name_number_" + std::to_string(index);
+		source += "\t\t\t\t\t\t\t\tstring " + name + " = \"" + std::string(80, 's') + "\";\n"
+			"\t\t\t\t\t\t\t\tdouble " + name + "_ratio = 1234567.891011 * 0.000123456789;\n";
+	}
+	return source + "int main() {\n\treturn 0;\n}\n";
+}
+
+// 4 arithmetic operations, one comparison and one increment per iteration.
+Workload long_loop(std::size_t iterations) {
+	auto source = "int main() {\n"
+		"\tint i = 0;\n"
+		"\tint sum = 0;\n"
+		"\twhile (i < " + std::to_string(iterations) + ") {\n"
+		"\t\tsum = (sum + i % 7 * 3) % 1000;\n"
+		"\t\ti++;\n"
+		"\t}\n"
+		"\treturn sum % 256;\n"
+		"}\n";
+	return {source, iterations * 6};
+}
+
+// Naive Fibonacci; each call counts as one operation.
+Workload recursive_calls(int n) {
+	auto source = "int fib(int n) {\n"
+		"\tif (n < 2) {\n"
+		"\t\treturn n;\n"
+		"\t}\n"
+		"\treturn fib(n - 1) + fib(n - 2);\n"
+		"}\n"
+		"int main() {\n"
+		"\treturn fib(" + std::to_string(n) + ") % 256;\n"
+		"}\n";
+	// fib(n) makes 2 * F(n + 1) - 1 calls
+	std::size_t previous = 0, current = 1;
+	for (int i = 0; i < n; ++i) {
+		auto next = previous + current;
+		previous = current;
+		current = next;
+	}
+	return {source, 2 * current - 1};
+}
+
+// Fills a double array element by element, then takes its dot product with
+// itself either in a second loop or with the dot builtin. Each element of
+// each pass counts as one operation.
+Workload array_reduction(std::size_t size, bool builtin) {
+	std::string source = "int main() {\n"
+		"\tdouble a[" + std::to_string(size) + "];\n"
+		"\tint i = 0;\n"
+		"\twhile (i < len(a)) {\n"
+		"\t\ta[i] = i % 10;\n"
+		"\t\ti++;\n"
+		"\t}\n";
+	if (builtin) {
+		source += "\tdouble total = dot(a, a);\n";
+	} else {
+		source += "\tdouble total = 0;\n"
+			"\ti = 0;\n"
+			"\twhile (i < len(a)) {\n"
+			"\t\ttotal += a[i] * a[i];\n"
+			"\t\ti++;\n"
+			"\t}\n";
+	}
+	source += "\treturn total % 256;\n"
+		"}\n";
+	return {source, size * 2};
+}
+
+// Makes a 64-element array per iteration that is garbage by the next, and
+// keeps every thousandth in one that lives for the whole run. Each array made
+// counts as one operation.
+Workload array_churn(std::size_t size) {
+	std::string source = "int main() {\n"
+		"\tint kept[];\n"
+		"\tint i = 0;\n"
+		"\twhile (i < " + std::to_string(size) + ") {\n"
+		"\t\tint t[64];\n"
+		"\t\tt[i % 64] = i;\n"
+		"\t\tif (i % 1000 == 0) {\n"
+		"\t\t\tpush(kept, sum(t));\n"
+		"\t\t}\n"
+		"\t\ti++;\n"
+		"\t}\n"
+		"\treturn len(kept) % 256;\n"
+		"}\n";
+	return {source, size};
+}
+
+// Builds a string of three characters per iteration, with `s += ...` or in
+// the `s = s + ...` form. Each append counts as one operation.
+Workload string_building(std::size_t size, bool compound) {
+	std::string source = "int main() {\n"
+		"\tstring s;\n"
+		"\tint i = 0;\n"
+		"\twhile (i < " + std::to_string(size) + ") {\n";
+	source += compound ? "\t\ts += \"abc\";\n" : "\t\ts = s + \"abc\";\n";
+	source += "\t\ti++;\n"
+		"\t}\n"
+		"\treturn s < \"abd\";\n"
+		"}\n";
+	return {source, size};
+}
@@ -0,0 +1,57 @@
+#include <string>
+#include <string_view>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "scan.hpp"
+
+// Lexer throughput on every generated shape, plus each vectorized scanner
+// against the byte-at-a-time loop it replaces on long runs of its byte class.
+
+static void lex(const Shape& shape) {
+	auto name = std::string("lexer.") + shape.name;
+	if (!selected(name)) {
+		return;
+	}
+	auto source = shape.generate(scaled(4 << 20));
+	std::size_t tokens = 0;
+	auto seconds = measure([&] { tokens = Lexer(source).tokenize().size(); });
+	report(name) << " impl=" << scan_implementation() << " bytes=" << source.size() << " tokens=" << tokens
+		<< " mb_s=" << source.size() / seconds / 1e6 << " tokens_s=" << tokens / seconds << "\n";
+}
+
+template<typename Scan, typename Scalar>
+static void scanner(const char* scanner_name, char fill, char stop, Scan scan, Scalar scalar) {
+	auto name = std::string("scan.") + scanner_name;
+	if (!selected(name)) {
+		return;
+	}
+	std::string run(scaled(1 << 20), fill);
+	run += stop;
+	std::size_t end = 0;
+	auto vector_seconds = measure([&] { end = scan(run, 0); }, config.repetitions * 4);
+	auto scalar_seconds = measure([&] {
+		std::size_t offset = 0;
+		while (offset < run.size() && scalar(run[offset])) {
+			++offset;
+		}
+		end = offset;
+	}, config.repetitions * 4);
+	if (end != run.size() - 1) {
+		std::cerr << name << ": stopped at " << end << "\n";
+	}
+	report(name) << " impl=" << scan_implementation() << " mb_s=" << run.size() / vector_seconds / 1e6
+		<< " scalar_mb_s=" << run.size() / scalar_seconds / 1e6 << "\n";
+}
+
+void run_lexer_benchmarks() {
+	for (auto& shape : shapes) {
+		lex(shape);
+	}
+	scanner("whitespace", ' ', ';', scan_whitespace, [](char c) { return c == ' ' || (c >= '\t' && c <= '\r'); });
+	scanner("identifier", 'x', ';', scan_identifier, [](char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	});
+	scanner("digits", '7', ';', scan_digits, [](char c) { return c >= '0' && c <= '9'; });
+	scanner("line_comment", 'l', '\n', scan_line_end, [](char c) { return c != '\n'; });
+}
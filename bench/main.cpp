@@ -0,0 +1,44 @@
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "bench.hpp"
+
+Config config;
+
+bool selected(std::string_view name) {
+	return config.filter.empty() || name.find(config.filter) != std::string_view::npos;
+}
+
+std::ostream& report(std::string_view name) {
+	return std::cout << std::setprecision(4) << name;
+}
+
+std::size_t scaled(std::size_t size) {
+	return std::max<std::size_t>(1, static_cast<std::size_t>(size * config.scale));
+}
+
+int main(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if (arg.starts_with("--scale=")) {
+			config.scale = std::stod(std::string(arg.substr(8)));
+		} else if (arg.starts_with("--repetitions=")) {
+			config.repetitions = std::max(1, std::stoi(std::string(arg.substr(14))));
+		} else if (arg.starts_with("--filter=")) {
+			config.filter = arg.substr(9);
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--scale=F] [--repetitions=N] [--filter=TEXT]\n";
+			return 1;
+		}
+	}
+	run_lexer_benchmarks();
+	run_parser_benchmarks();
+	run_ast_benchmarks();
+	run_engine_benchmarks();
+	run_array_benchmarks();
+	run_string_benchmarks();
+	return 0;
+}
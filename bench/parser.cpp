@@ -0,0 +1,105 @@
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "parallel_parser.hpp"
+#include "incremental.hpp"
+#include "counter.hpp"
+
+// Parser throughput in AST nodes per second, sequential and with one thread
+// per core, the latency of a one-statement incremental reparse, and the
+// error-collecting mode behind --check.
+
+static void parse(const Shape& shape) {
+	auto name = std::string("parser.") + shape.name;
+	if (!selected(name)) {
+		return;
+	}
+	auto source = shape.generate(scaled(4 << 20));
+	std::size_t nodes = 0;
+	auto sequential = measure([&] {
+		auto unit = Parser(TokenStream(Lexer(source))).parse();
+		nodes = NodeCounter().count(*unit);
+	});
+	auto parallel = measure([&] { ParallelParser(source).parse(); });
+	report(name) << " bytes=" << source.size() << " nodes=" << nodes << " nodes_s=" << nodes / sequential
+		<< " threads=" << std::max(1u, std::thread::hardware_concurrency()) << " parallel_nodes_s=" << nodes / parallel << "\n";
+}
+
+static void reparse() {
+	if (!selected("parser.incremental")) {
+		return;
+	}
+	auto source = many_functions(scaled(4 << 20));
+	auto unit = IncrementalParser().parse(source);
+	auto offset = source.find("total -= 1;", source.size() / 2);
+	std::string edit = "total -= 2;";
+	auto seconds = measure([&] {
+		source.replace(offset, edit.size(), edit);
+		IncrementalParser().reparse(*unit, source, Edit{offset, edit.size(), edit.size()});
+	}, config.repetitions * 20);
+	auto full = measure([&] { IncrementalParser().parse(source); });
+	report("parser.incremental") << " bytes=" << source.size() << " declarations=" << unit->declarations.size()
+		<< " edit_ms=" << seconds * 1e3 << " full_ms=" << full * 1e3 << "\n";
+}
+
+static std::size_t check(std::string_view source) {
+	std::vector<Diagnostic> diagnostics;
+	Parser(TokenStream(Lexer(source, 0, &diagnostics)), &diagnostics).parse();
+	return diagnostics.size();
+}
+
+// A large source with a missing semicolon in every 16th function, checked in
+// one pass, and small files with an error in their last function, checked
+// against a parse that throws at it.
+static void check_errors() {
+	if (!selected("parser.check")) {
+		return;
+	}
+	auto source = many_functions(scaled(4 << 20));
+	std::string_view statement = "total -= 1;";
+	std::size_t errors = 0, found = 0;
+	auto broken = source;
+	for (auto at = broken.find(statement), index = std::size_t(0); at != std::string::npos; at = broken.find(statement, at + 1), ++index) {
+		if (index % 16 == 0) {
+			broken[at + statement.size() - 1] = ' ';
+			++errors;
+		}
+	}
+	auto full = measure([&] { Parser(TokenStream(Lexer(source))).parse(); });
+	auto checked = measure([&] { check(source); });
+	auto collected = measure([&] { found = check(broken); });
+	if (found != errors) {
+		std::cerr << "parser.check: " << found << " diagnostics for " << errors << " errors\n";
+	}
+
+	auto file = many_functions(2048);
+	file[file.rfind(statement) + statement.size() - 1] = ' ';
+	constexpr int files = 1000;
+	auto thrown = measure([&] {
+		for (int i = 0; i < files; ++i) {
+			try {
+				Parser(TokenStream(Lexer(file))).parse();
+			} catch (const std::runtime_error&) {}
+		}
+	});
+	auto small = measure([&] {
+		for (int i = 0; i < files; ++i) {
+			check(file);
+		}
+	});
+	report("parser.check") << " bytes=" << broken.size() << " errors=" << errors << " overhead=" << checked / full
+		<< " broken_ms=" << collected * 1e3 << " files_s=" << files / small << " throwing_files_s=" << files / thrown << "\n";
+}
+
+void run_parser_benchmarks() {
+	for (auto& shape : shapes) {
+		parse(shape);
+	}
+	reparse();
+	check_errors();
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "evaluator.hpp"
+
+// Appends per second while building a string, in both engines, at a size and
+// at four times that size. growth is how much longer the larger string took
+// per append: about 1 when appending runs in constant time.
+
+static double run(const Workload& workload, bool ast) {
+	auto unit = Parser(TokenStream(Lexer(workload.source))).parse();
+	Resolver().resolve(*unit);
+	auto program = Compiler().compile(*unit);
+	std::ostringstream output;
+	return measure([&] {
+		if (ast) {
+			Evaluator(output).run(*unit);
+		} else {
+			VirtualMachine(program, output).run();
+		}
+	}, 3);
+}
+
+static void append(const char* form, bool compound, std::size_t size) {
+	auto name = std::string("strings.") + form;
+	if (!selected(name)) {
+		return;
+	}
+	auto small = string_building(size, compound), large = string_building(size * 4, compound);
+	auto vm = run(small, false), vm_large = run(large, false);
+	auto ast = run(small, true), ast_large = run(large, true);
+	report(name) << " appends=" << size << " vm_ops_s=" << small.operations / vm << " ast_ops_s=" << small.operations / ast
+		<< " vm_growth=" << vm_large / vm / 4 << " ast_growth=" << ast_large / ast / 4 << "\n";
+}
+
+void run_string_benchmarks() {
+	append("compound", true, scaled(1 << 16));
+	append("concatenation", false, scaled(1 << 16));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump-pointer allocator that owns every node of a translation unit.
+// Objects are never freed one by one: the whole arena is released at once,
+// running destructors only for the objects whose type actually needs one.
+class Arena {
+public:
+	struct Statistics {
+		std::size_t objects = 0;
+		std::size_t arrays = 0;
+		std::size_t strings = 0;
+		std::size_t blocks = 0;
+		std::size_t bytes_used = 0;
+		std::size_t bytes_reserved = 0;
+	};
+
+	static constexpr std::size_t default_block_size = 64 * 1024;
+
+	Arena(std::size_t block_size = default_block_size);
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena();
+
+	void* allocate(std::size_t, std::size_t);
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			add_finalizer(object, [](void* p) { static_cast<T*>(p)->~T(); });
+		}
+		++statistics.objects;
+		return object;
+	}
+
+	template<typename T>
+	std::span<T> copy(const std::vector<T>& items) {
+		static_assert(std::is_trivially_destructible_v<T>);
+		if (items.empty()) {
+			return {};
+		}
+		T* data = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+		std::uninitialized_copy(items.begin(), items.end(), data);
+		++statistics.arrays;
+		return {data, items.size()};
+	}
+
+	std::string_view copy(std::string_view);
+
+	// Takes over every block and pending destructor of the other arena,
+	// leaving it empty. Objects keep their addresses.
+	void adopt(Arena&);
+
+	const Statistics& stats() const;
+
+private:
+	struct Block {
+		Block* next;
+		std::size_t size;
+	};
+
+	struct Finalizer {
+		void (*destroy)(void*);
+		void* object;
+		Finalizer* next;
+	};
+
+	void add_block(std::size_t);
+	void add_finalizer(void*, void (*)(void*));
+
+	std::size_t block_size;
+	Block* blocks = nullptr;
+	char* cursor = nullptr;
+	char* limit = nullptr;
+	Finalizer* finalizers = nullptr;
+	Statistics statistics;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+
+#include "value.hpp"
+
+// Storage behind an array value: elements of one of int, double, char or
+// bool, unboxed and contiguous in a block aligned for the widest vector
+// loads. A fixed-size array keeps the size it was made with; a dynamic one
+// starts empty and grows with push and resize. Every copy of the Value
+// shares the elements, so a function that is passed an array writes the
+// caller's. Arrays are made on the engine's Heap, which frees them once no
+// value refers to them.
+//
+// The bulk operations behind the builtins are vector loops unless
+// ARRAY_NO_SIMD is set. int arithmetic wraps, as it does elsewhere. double
+// sums and dot products always add in the same eight lanes, so their result
+// does not depend on the vector width the code was built for.
+class Array : public ArrayHeader {
+public:
+	// A value referring to a new array of size default elements, adopted by
+	// the current Heap
+	static Value make(ValueType element, std::size_t size, bool fixed);
+
+	Array(const Array&) = delete;
+	Array& operator=(const Array&) = delete;
+	~Array();
+
+	ValueType element_type() const { return element; }
+	std::size_t size() const { return count; }
+	bool fixed() const { return is_fixed; }
+	// Held on the heap, the elements' storage included
+	std::size_t bytes() const;
+
+	Value get(std::size_t) const;
+	// Stores the value converted to the element type and returns it as stored
+	Value set(std::size_t, const Value&);
+
+	void push(const Value&);
+	void resize(std::size_t);
+
+	void fill(const Value&);
+	// Overwrites the first elements with all of the source's, which must be
+	// of the same type and fit
+	void copy_from(const Array&);
+	// An int for every element type but double
+	Value sum() const;
+	// Of a non-empty array. NaNs are skipped unless every element is one.
+	Value min() const;
+	Value max() const;
+	Value dot(const Array&) const;
+
+private:
+	Array(ValueType, bool);
+
+	template<typename T> T* elements() const { return static_cast<T*>(data); }
+	std::size_t element_size() const;
+	void reserve(std::size_t);
+	void resize_unchecked(std::size_t);
+
+	ValueType element;
+	bool is_fixed;
+	std::size_t count = 0;
+	std::size_t capacity = 0;
+	void* data = nullptr;
+};
+
+inline Array& Value::as_array() const {
+	return static_cast<Array&>(*payload.array);
+}
+
+// A size asked for by a fixed-size array declaration or resize: a
+// non-negative integer.
+std::size_t array_size(const Value&);
+
+// Position of an element for the engines. The base must be an array and the
+// index an integer; the range is checked unless the Resolver proved it
+// cannot fail and cleared checked.
+std::size_t checked_index(const Value&, const Value&);
+
+inline std::size_t element_index(const Value& base, const Value& index, bool checked) {
+	auto number = index.int_if();
+	if (number && is_array(base.type()) && (!checked || static_cast<unsigned>(*number) < base.as_array().size())) {
+		return static_cast<unsigned>(*number);
+	}
+	return checked_index(base, index);
+}
+
+inline Value load_element(const Value& base, const Value& index, bool checked) {
+	return base.as_array().get(element_index(base, index, checked));
+}
+
+inline Value store_element(const Value& base, const Value& index, const Value& value, bool checked) {
+	return base.as_array().set(element_index(base, index, checked), value);
+}
@@ -1,17 +1,29 @@
 #pragma once
 
-#include <vector>
-#include <memory>
+#include <cstdint>
+#include <span>
+
+#include "arena.hpp"
+#include "types.hpp"
 
 class Visitor;
 
+// Nodes live in the Arena of their TranslationUnit and are released together
+// with it, so they are never destroyed through a pointer to the base class.
+//
+// Statements and declarations remember where they start. A top-level
+// declaration's offset is its byte offset in the source; every node nested in
+// it stores an offset relative to that, so moving a declaration only touches
+// the declaration itself.
 struct ASTNode {
-	virtual ~ASTNode() = default;
 	virtual void accept(Visitor&) = 0;
+protected:
+	~ASTNode() = default;
 };
 
 struct Statement: public ASTNode {
-	virtual ~Statement() = default;
+	std::uint32_t offset = 0;
+
 	virtual void accept(Visitor&) override = 0;
 };
 
@@ -20,24 +32,31 @@ struct Declaration: public ASTNode {
 	struct Declarator;
 	struct NoPtrDeclarator;
 	struct PtrDeclarator;
+	struct ArrayDeclarator;
 
 	struct InitDeclarator;
 
-	virtual ~Declaration() = default;
+	std::uint32_t offset = 0;
+
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct Expression: public ASTNode {
-	virtual ~Expression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
-using DeclarationSeq = std::vector<std::shared_ptr<Declaration>>;
+using DeclarationSeq = std::span<Declaration*>;
 
 struct TranslationUnit : public ASTNode {
+	Arena arena;
+	TypeContext types;
 	DeclarationSeq declarations;
+	// Source offset just past each declaration, set by IncrementalParser
+	std::span<std::size_t> extents;
+	std::size_t global_count = 0;
+	std::size_t call_site_count = 0;
 
-	TranslationUnit(const DeclarationSeq&);
+	TranslationUnit() = default;
 
 	void accept(Visitor&) override;
-};
\ No newline at end of file
+};
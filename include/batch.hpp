@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+
+// Runs many scripts in one process on a pool of worker threads. Every file
+// gets its own Interpreter whose output and diagnostics are captured, and
+// the captures are written out in list order as soon as a file and all the
+// files before it have finished, so the combined output does not depend on
+// the number of jobs.
+class Batch {
+public:
+	// 0 jobs uses every hardware thread
+	Batch(const Interpreter::Options&, std::size_t);
+
+	// 0 when every file exited with 0, otherwise the first non-zero status.
+	int run(const std::vector<std::string>&, std::ostream&, std::ostream&);
+
+	// One path per line, blank lines skipped; "-" reads the list from stdin.
+	static std::vector<std::string> read_list(const std::string&);
+
+private:
+	Interpreter::Options options;
+	std::size_t jobs;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <ostream>
+#include <span>
+#include <string_view>
+
+#include "value.hpp"
+
+struct Builtin {
+	std::string_view name;
+	Value (*call)(std::span<const Value>, std::ostream&);
+};
+
+const Builtin* find_builtin(std::string_view);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "value.hpp"
+
+// The opcode list is shared with the VM's dispatch table, so new opcodes
+// only need to be added here and given a handler. The entries from
+// JUMP_UNLESS_EQUAL on are superinstructions emitted by the Compiler unless
+// VM_NO_FUSION is set. LOOP is the backward jump that closes a loop; it
+// counts iterations towards compiling the function natively. TAIL_CALL
+// replaces the current frame with the callee's; a builtin callee is called
+// normally and the code after it runs.
+//
+// NEW_ARRAY pushes an empty dynamic array of the operand's array type and
+// NEW_FIXED_ARRAY replaces the size on top with a fixed-size one. Element
+// access takes the array and the index from the stack, with the range
+// checked unless the operand is 0; STORE_ELEMENT leaves the stored value and
+// INCREMENT_ELEMENT, which adds its operand, the previous one.
+//
+// APPEND_LOCAL pops a value and appends it to the string in the local slot
+// of its operand, in place when the slot holds the only reference.
+#define OPCODES(X) \
+	X(CONSTANT) X(POP) X(DUP) \
+	X(LOAD_LOCAL) X(STORE_LOCAL) X(LOAD_GLOBAL) X(STORE_GLOBAL) \
+	X(ADD) X(SUBTRACT) X(MULTIPLY) X(DIVIDE) X(MODULO) X(POWER) X(SHIFT_LEFT) X(SHIFT_RIGHT) \
+	X(EQUAL) X(NOT_EQUAL) X(LESS) X(LESS_EQUAL) X(GREATER) X(GREATER_EQUAL) \
+	X(NEGATE) X(PLUS) X(NOT) \
+	X(CONVERT) \
+	X(JUMP) X(JUMP_IF_FALSE) X(LOOP) \
+	X(CALL) X(RETURN) X(TAIL_CALL) \
+	X(DUP2) X(NEW_ARRAY) X(NEW_FIXED_ARRAY) X(LOAD_ELEMENT) X(STORE_ELEMENT) X(INCREMENT_ELEMENT) \
+	X(APPEND_LOCAL) \
+	X(JUMP_UNLESS_EQUAL) X(JUMP_UNLESS_NOT_EQUAL) X(JUMP_UNLESS_LESS) X(JUMP_UNLESS_LESS_EQUAL) \
+	X(JUMP_UNLESS_GREATER) X(JUMP_UNLESS_GREATER_EQUAL) \
+	X(INCREMENT_LOCAL) X(DECREMENT_LOCAL) \
+	X(CALL_0) X(CALL_1) X(CALL_2) X(CALL_3)
+
+enum class OpCode : std::uint8_t {
+#define OPCODE_ENUMERATOR(name) name,
+	OPCODES(OPCODE_ENUMERATOR)
+#undef OPCODE_ENUMERATOR
+};
+
+struct Instruction {
+	OpCode op;
+	std::int32_t operand;
+};
+
+// Source offset of the statement whose code starts at an instruction index.
+struct Location {
+	std::uint32_t instruction;
+	std::uint32_t offset;
+};
+
+struct CallSite {
+	std::string name;
+	std::uint32_t argument_count;
+};
+
+struct Function {
+	std::string name;
+	ValueType return_type = ValueType::NONE;
+	std::vector<ValueType> parameter_types;
+	std::size_t frame_size = 0;
+	bool defined = false;
+	std::vector<Instruction> code;
+	std::vector<Location> locations;
+};
+
+// A compiled translation unit. functions[initializer] stores every global
+// initializer in declaration order and runs before main.
+struct Program {
+	std::vector<Function> functions;
+	std::vector<Value> constants;
+	std::vector<CallSite> call_sites;
+	std::size_t global_count = 0;
+	std::size_t initializer = 0;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "bytecode.hpp"
+
+// Directory of compiled Programs, one file per source. An entry is named by
+// a hash of the source text, the build's bytecode format and the compile
+// options, and repeats all three in its header, followed by a hash of the
+// body. A stale, truncated, damaged or foreign file, or one whose code
+// fails verification, is treated as a miss rather than run.
+class ProgramCache {
+public:
+	ProgramCache(const std::string&, std::string_view, bool);
+
+	std::optional<Program> load() const;
+	void store(const Program&) const;
+
+	static std::uint64_t hash(std::string_view);
+
+private:
+	std::string directory;
+	std::string path;
+	std::uint64_t source_hash;
+	std::uint64_t source_size;
+	bool optimized;
+};
+
+// Compiled Programs kept in memory by a long-running process and shared by
+// the Interpreters on all its threads. Entries are found by hash and then
+// compared against the full source. Once capacity is reached an arbitrary
+// entry makes room for a new one.
+class MemoryCache {
+public:
+	MemoryCache(std::size_t);
+
+	std::shared_ptr<const Program> find(std::string_view, bool) const;
+	std::shared_ptr<const Program> insert(std::string_view, bool, Program&&);
+
+private:
+	struct Entry {
+		std::string source;
+		bool optimized;
+		std::shared_ptr<const Program> program;
+	};
+
+	std::size_t capacity;
+	mutable std::shared_mutex mutex;
+	std::unordered_multimap<std::uint64_t, Entry> entries;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "visitor.hpp"
+#include "bytecode.hpp"
+
+// Lowers a TranslationUnit into the linear bytecode run by VirtualMachine.
+// Every expression visit leaves exactly one value on the operand stack.
+class Compiler : public Visitor {
+public:
+	Program compile(TranslationUnit&);
+public:
+	void visit(TranslationUnit&) override;
+public:
+	void visit(Declaration::PtrDeclarator&) override;
+	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
+	void visit(Declaration::InitDeclarator&) override;
+	void visit(VarDeclaration&) override;
+	void visit(ParameterDeclaration&) override;
+	void visit(FuncDeclaration&) override;
+public:
+	void visit(CompoundStatement&) override;
+	void visit(DeclarationStatement&) override;
+	void visit(ExpressionStatement&) override;
+	void visit(ConditionalStatement&) override;
+	void visit(WhileStatement&) override;
+	void visit(RepeatStatement&) override;
+	void visit(ForStatement&) override;
+	void visit(ReturnStatement&) override;
+	void visit(BreakStatement&) override;
+	void visit(ContinueStatement&) override;
+public:
+	void visit(BinaryOperation&) override;
+	void visit(PrefixExpression&) override;
+	void visit(PostfixIncrementExpression&) override;
+	void visit(PostfixDecrementExpression&) override;
+	void visit(FunctionCallExpression&) override;
+	void visit(SubscriptExpression&) override;
+	void visit(IntLiteral&) override;
+	void visit(FloatLiteral&) override;
+	void visit(CharLiteral&) override;
+	void visit(StringLiteral&) override;
+	void visit(BoolLiteral&) override;
+	void visit(IdentifierExpression&) override;
+	void visit(ParenthesizedExpression&) override;
+
+private:
+	struct Loop {
+		std::size_t continue_target;
+		std::vector<std::size_t> breaks;
+	};
+
+	void declare_function(FuncDeclaration&);
+	void declare_variable(Declaration::InitDeclarator&);
+	IdentifierExpression& assignable(Expression*) const;
+
+	void load(const Symbol&);
+	void store(const Symbol&);
+	void update(Expression*, OpCode, bool);
+	std::size_t jump_unless(Expression*);
+
+	void locate(std::uint32_t);
+	std::size_t emit(OpCode, std::int32_t = 0);
+	void emit_constant(Value);
+	void patch(std::size_t);
+	std::size_t here() const;
+
+	Program program;
+	Function* function = nullptr;
+	// Offset of the declaration being compiled; statement offsets are relative to it
+	std::uint32_t origin = 0;
+	std::unordered_map<std::string_view, std::size_t> functions;
+	// Constant index of each string literal
+	std::unordered_map<std::string_view, std::int32_t> strings;
+	std::vector<Loop> loops;
+};
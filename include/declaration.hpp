@@ -1,19 +1,21 @@
 #pragma once
 
-#include <string>
-#include <vector>
-#include <memory>
+#include <string_view>
+#include <span>
 
 #include "ast.hpp"
+#include "symbols.hpp"
 
 struct CompoundStatement;
 
 struct Declaration::Declarator {
-	std::string name;
-	Declarator(const std::string&);
+	std::string_view name;
+	Symbol symbol;
+	Declarator(std::string_view);
 
-	virtual ~Declarator() = default;
 	virtual void accept(Visitor&) = 0;
+protected:
+	~Declarator() = default;
 };
 
 struct Declaration::NoPtrDeclarator : public Declaration::Declarator{
@@ -28,41 +30,51 @@ struct Declaration::PtrDeclarator : public Declaration::Declarator{
 	void accept(Visitor&) override;
 };
 
+// name[size], or name[] for a dynamic array
+struct Declaration::ArrayDeclarator : public Declaration::Declarator{
+	Expression* size;
+
+	ArrayDeclarator(std::string_view, Expression*);
+	void accept(Visitor&) override;
+};
+
 struct Declaration::InitDeclarator {
-	std::shared_ptr<Declarator> declarator;
-	std::shared_ptr<Expression> initializer;
+	Declarator* declarator;
+	Expression* initializer;
 
-	InitDeclarator(const std::shared_ptr<Declarator>&, const std::shared_ptr<Expression>&);
+	InitDeclarator(Declarator*, Expression*);
 	void accept(Visitor&);
 };
 
 struct VarDeclaration: public Declaration {
-	std::string type;
-	std::vector<std::shared_ptr<InitDeclarator>> declarator_list;
+	std::string_view type;
+	std::span<InitDeclarator*> declarator_list;
 
-	VarDeclaration(const std::string&, const std::vector<std::shared_ptr<InitDeclarator>>&);
+	VarDeclaration(std::string_view, std::span<InitDeclarator*>);
 	void accept(Visitor&) override;
 };
 
 struct ParameterDeclaration: public Declaration {
-	std::string type;
-	std::shared_ptr<InitDeclarator> init_declarator;
+	std::string_view type;
+	InitDeclarator* init_declarator;
 
-	ParameterDeclaration(const std::string&, const std::shared_ptr<InitDeclarator>&);
+	ParameterDeclaration(std::string_view, InitDeclarator*);
 	void accept(Visitor&) override;
 };
 
 struct FuncDeclaration: public Declaration {
-	std::string type;
-	std::shared_ptr<Declarator> declarator;
-	std::vector<std::shared_ptr<ParameterDeclaration>> args;
-	std::shared_ptr<CompoundStatement> body;
-
-	FuncDeclaration(const std::string&,
-					const std::shared_ptr<Declarator>&,
-					const std::vector<std::shared_ptr<ParameterDeclaration>>&,
-					const std::shared_ptr<CompoundStatement>&
+	std::string_view type;
+	Declarator* declarator;
+	std::span<ParameterDeclaration*> args;
+	CompoundStatement* body;
+	const Type* signature = nullptr;
+	std::size_t frame_size = 0;
+
+	FuncDeclaration(std::string_view,
+					Declarator*,
+					std::span<ParameterDeclaration*>,
+					CompoundStatement*
 					);
 
 	void accept(Visitor&) override;
-};
\ No newline at end of file
+};
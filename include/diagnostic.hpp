@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// A problem found in a source, at the byte offset in the whole source of the
+// character or token it was found at.
+struct Diagnostic {
+	std::uint32_t offset;
+	std::string message;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "visitor.hpp"
+#include "value.hpp"
+#include "heap.hpp"
+#include "stop.hpp"
+#include "profiler.hpp"
+
+struct Builtin;
+
+// Reference tree-walking engine: executes the resolved AST directly, keeping
+// variables in per-call frames indexed by their Symbol slots. Kept for
+// differential testing and as the baseline the bytecode VM is measured against.
+// Frames are windows of one value stack, like the VM's, and returned calls
+// to a function of the same return type reuse the caller's frame.
+class Evaluator : public Visitor {
+public:
+	// With a profiler attached, samples are offered before every statement.
+	// Calls nested deeper than the limit fail, and so do calls once three
+	// quarters of the thread's native stack are in use, since every call
+	// recurses through several visits.
+	// Arrays live on a Heap with a nursery of the given bytes, collected
+	// after a declaration makes an array. A stop request is checked at every
+	// loop iteration and call.
+	Evaluator(std::ostream&, Profiler* = nullptr, std::size_t = SIZE_MAX, std::size_t = Heap::default_nursery_size, const StopRequest* = nullptr);
+
+	int run(TranslationUnit&);
+
+	const Heap::Stats& heap_stats() const { return heap.stats(); }
+
+	// Calls answered by a site's inline cache, and those that filled it
+	std::size_t call_cache_hits() const { return cache_hits; }
+	std::size_t call_cache_misses() const { return cache_misses; }
+public:
+	void visit(TranslationUnit&) override;
+public:
+	void visit(Declaration::PtrDeclarator&) override;
+	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
+	void visit(Declaration::InitDeclarator&) override;
+	void visit(VarDeclaration&) override;
+	void visit(ParameterDeclaration&) override;
+	void visit(FuncDeclaration&) override;
+public:
+	void visit(CompoundStatement&) override;
+	void visit(DeclarationStatement&) override;
+	void visit(ExpressionStatement&) override;
+	void visit(ConditionalStatement&) override;
+	void visit(WhileStatement&) override;
+	void visit(RepeatStatement&) override;
+	void visit(ForStatement&) override;
+	void visit(ReturnStatement&) override;
+	void visit(BreakStatement&) override;
+	void visit(ContinueStatement&) override;
+public:
+	void visit(BinaryOperation&) override;
+	void visit(PrefixExpression&) override;
+	void visit(PostfixIncrementExpression&) override;
+	void visit(PostfixDecrementExpression&) override;
+	void visit(FunctionCallExpression&) override;
+	void visit(SubscriptExpression&) override;
+	void visit(IntLiteral&) override;
+	void visit(FloatLiteral&) override;
+	void visit(CharLiteral&) override;
+	void visit(StringLiteral&) override;
+	void visit(BoolLiteral&) override;
+	void visit(IdentifierExpression&) override;
+	void visit(ParenthesizedExpression&) override;
+
+private:
+	// TAIL unwinds like RETURN; the callee's arguments then sit in the
+	// returning frame's first slots.
+	enum class Flow {
+		NORMAL, BREAK, CONTINUE, RETURN, TAIL
+	};
+
+	struct Call {
+		FuncDeclaration* function;
+		std::size_t base;
+	};
+
+	// What a call site resolved to: a defined function or a builtin. An
+	// entry holds while its generation is current; defining a function
+	// starts a new one.
+	struct CallCache {
+		FuncDeclaration* function = nullptr;
+		const Builtin* builtin = nullptr;
+		std::size_t generation = 0;
+	};
+
+	// Roots an array that only a C++ local holds while more expressions are
+	// evaluated, since any of them may call a function that collects
+	struct Pin {
+		Pin(std::vector<const Value*>& pinned, const Value& value) : pinned(is_array(value.type()) ? &pinned : nullptr) {
+			if (this->pinned) {
+				this->pinned->push_back(&value);
+			}
+		}
+		Pin(const Pin&) = delete;
+		~Pin() {
+			if (pinned) {
+				pinned->pop_back();
+			}
+		}
+		std::vector<const Value*>* pinned;
+	};
+
+	Value evaluate(Expression*);
+	void execute(Statement*);
+	Value call(FuncDeclaration&, std::size_t);
+	const CallCache& resolve(FunctionCallExpression&);
+	Value& lookup(const Symbol&);
+	IdentifierExpression& assignable(Expression*);
+	void update(Expression*, Token::Type, bool);
+	bool loop_step();
+	void sample(Statement*);
+	void collect();
+	void check_stop() const;
+
+	// Destroyed after everything that refers to its arrays
+	Heap heap;
+	std::vector<const Value*> pinned;
+	std::ostream& output;
+	std::unordered_map<std::string_view, FuncDeclaration*> functions;
+	std::vector<CallCache> call_caches;
+	std::size_t generation = 1;
+	std::size_t cache_hits = 0;
+	std::size_t cache_misses = 0;
+	// One value per distinct literal too long to store inline, keyed by its
+	// own characters
+	std::unordered_map<std::string_view, Value> strings;
+	std::vector<Value> globals;
+	std::vector<Value> stack;
+	std::vector<Call> calls;
+	Value result;
+	Flow flow = Flow::NORMAL;
+	FuncDeclaration* tail_target = nullptr;
+	Profiler* profiler;
+	std::size_t recursion_limit;
+	const StopRequest* stop;
+	std::uintptr_t stack_floor = 0;
+	std::unordered_map<const FuncDeclaration*, std::uint32_t> profile_ids;
+};
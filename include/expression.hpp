@@ -1,87 +1,95 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <vector>
-#include <memory>
+#include <string_view>
+#include <span>
 
 #include "ast.hpp"
+#include "token.hpp"
+#include "symbols.hpp"
 
 struct BinaryExpression: public Expression {
-	virtual ~BinaryExpression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct BinaryOperation: public BinaryExpression {
-	std::string op;
-	std::shared_ptr<BinaryExpression> lhs, rhs;
+	Token::Type op;
+	BinaryExpression *lhs, *rhs;
+	// Set by the Resolver on `s += x` and `s = s + x` where s is a local
+	// string and x writes no variable, so x can be appended to s in place
+	bool appends = false;
 
-	BinaryOperation(const std::string&, const std::shared_ptr<BinaryExpression>&, const std::shared_ptr<BinaryExpression>&);
+	BinaryOperation(Token::Type, BinaryExpression*, BinaryExpression*);
 	void accept(Visitor&) override;
+	// x of such an assignment, or nullptr
+	BinaryExpression* appended() const;
 };
 
 struct UnaryExpression: public BinaryExpression {
-	virtual ~UnaryExpression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct PrefixExpression: public UnaryExpression {
-	std::string op;
-	std::shared_ptr<UnaryExpression> base;
+	Token::Type op;
+	UnaryExpression* base;
 
-	PrefixExpression(const std::string&, const std::shared_ptr<UnaryExpression>&);
+	PrefixExpression(Token::Type, UnaryExpression*);
 	void accept(Visitor&) override;
 };
 
 
 struct PostfixExpression: public UnaryExpression {
-	virtual ~PostfixExpression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct FunctionCallExpression: public PostfixExpression {
-	std::shared_ptr<PostfixExpression> base;
-	std::vector<std::shared_ptr<Expression>> args;
+	PostfixExpression* base;
+	std::span<Expression*> args;
+	// Index of the call's inline cache in the Evaluator, set by the Resolver
+	std::uint32_t site = 0;
 
-	FunctionCallExpression(const std::shared_ptr<PostfixExpression>&, const std::vector<std::shared_ptr<Expression>>&);
+	FunctionCallExpression(PostfixExpression*, std::span<Expression*>);
 	void accept(Visitor&) override;
 };
 
 struct SubscriptExpression: public PostfixExpression {
-	std::shared_ptr<PostfixExpression> base;
-	std::shared_ptr<Expression> index;
+	PostfixExpression* base;
+	Expression* index;
+	// Cleared by the Resolver where the index is proved to be in range
+	bool checked = true;
 
-	SubscriptExpression(const std::shared_ptr<PostfixExpression>&, const std::shared_ptr<Expression>&);
+	SubscriptExpression(PostfixExpression*, Expression*);
 	void accept(Visitor&) override;
 };
 
 struct PostfixIncrementExpression: public PostfixExpression {
-	std::shared_ptr<PostfixExpression> base;
+	PostfixExpression* base;
 
-	PostfixIncrementExpression(const std::shared_ptr<PostfixExpression>&);
+	PostfixIncrementExpression(PostfixExpression*);
 	void accept(Visitor&) override;
 };
 
 struct PostfixDecrementExpression: public PostfixExpression {
-	std::shared_ptr<PostfixExpression> base;
+	PostfixExpression* base;
 
-	PostfixDecrementExpression(const std::shared_ptr<PostfixExpression>&);
+	PostfixDecrementExpression(PostfixExpression*);
 	void accept(Visitor&) override;
 };
 
 struct PrimaryExpression: public PostfixExpression {
-	virtual ~PrimaryExpression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct IdentifierExpression: public PrimaryExpression {
-	std::string name;
+	std::string_view name;
+	Symbol symbol;
 
-	IdentifierExpression(const std::string&);
+	IdentifierExpression(std::string_view);
 	void accept(Visitor&) override;
 };
 
 struct LiteralExpression: public PrimaryExpression {
-	virtual ~LiteralExpression() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
@@ -89,41 +97,51 @@ struct LiteralExpression: public PrimaryExpression {
 struct IntLiteral: public LiteralExpression {
 	int value;
 
-	IntLiteral(const std::string&);
+	IntLiteral(std::string_view);
+	IntLiteral(int);
 	void accept(Visitor&) override;
 };
 
 struct FloatLiteral: public LiteralExpression {
 	float value;
 
-	FloatLiteral(const std::string&);
+	FloatLiteral(std::string_view);
+	FloatLiteral(float);
 	void accept(Visitor&) override;
 };
 
 struct CharLiteral: public LiteralExpression {
 	char value;
 
-	CharLiteral(const std::string&);
+	CharLiteral(std::string_view);
+	CharLiteral(char);
 	void accept(Visitor&) override;
 };
 
+// The value holds the decoded characters, not the source text
 struct StringLiteral: public LiteralExpression {
-	std::string value;
+	std::string_view value;
 
-	StringLiteral(const std::string&);
+	// Decodes the escapes of a literal's source text into the arena
+	StringLiteral(Arena&, std::string_view);
+	StringLiteral(std::string_view);
 	void accept(Visitor&) override;
 };
 
+// Spells a string literal's value with the escapes its source would use
+std::string escape(std::string_view);
+
 struct BoolLiteral: public LiteralExpression {
 	bool value;
 
-	BoolLiteral(const std::string&);
+	BoolLiteral(std::string_view);
+	BoolLiteral(bool);
 	void accept(Visitor&) override;
 };
 
 struct ParenthesizedExpression: public PrimaryExpression {
-	std::shared_ptr<Expression> expression;
+	Expression* expression;
 
-	ParenthesizedExpression(const std::shared_ptr<Expression>&);
+	ParenthesizedExpression(Expression*);
 	void accept(Visitor&) override;
 };
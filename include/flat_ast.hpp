@@ -0,0 +1,113 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "token.hpp"
+
+// Same syntax as the node classes, in contiguous arrays indexed by 32-bit
+// node indices: a kind tag, an operator and two data fields per node, with
+// variable-length children in a shared extra array and names in a string
+// table. Passes walk it with a switch on the kind instead of accept() and
+// visit(). Nodes are laid out in preorder, children in source order, so a
+// walk reads forward.
+//
+// The data fields by kind ("list" is an index into extra holding a count
+// followed by that many node indices, "string" an index into the string
+// table, and none marks an absent child):
+//   VAR_DECLARATION        type string, list of INIT_DECLARATORs
+//   PARAMETER_DECLARATION  type string, INIT_DECLARATOR
+//   FUNC_DECLARATION       type string, extra index of declarator, body and
+//                          then a list of parameters
+//   POINTER/NAME_DECLARATOR name string
+//   ARRAY_DECLARATOR       name string, size
+//   INIT_DECLARATOR        declarator, initializer
+//   COMPOUND               list of statements
+//   CONDITIONAL            list of condition and statement pairs, else branch
+//   WHILE                  condition, statement
+//   REPEAT, DECLARATION_STATEMENT, EXPRESSION_STATEMENT, RETURN, PREFIX,
+//   POSTFIX_INCREMENT, POSTFIX_DECREMENT, PARENTHESIZED   the one child
+//   BINARY, SUBSCRIPT      left and right operand
+//   CALL                   callee, list of arguments
+//   INT/FLOAT/CHAR/BOOL_LITERAL   the value's bits
+//   STRING_LITERAL, IDENTIFIER    string
+//
+// Only the syntax is kept: source offsets and what the Resolver and
+// Optimizer attach to the nodes stay on the TranslationUnit.
+#define FLAT_KINDS(X) \
+	X(VAR_DECLARATION) X(PARAMETER_DECLARATION) X(FUNC_DECLARATION) \
+	X(POINTER_DECLARATOR) X(NAME_DECLARATOR) X(ARRAY_DECLARATOR) X(INIT_DECLARATOR) \
+	X(COMPOUND) X(CONDITIONAL) X(WHILE) X(REPEAT) X(FOR) X(RETURN) X(BREAK) X(CONTINUE) \
+	X(DECLARATION_STATEMENT) X(EXPRESSION_STATEMENT) \
+	X(BINARY) X(PREFIX) X(POSTFIX_INCREMENT) X(POSTFIX_DECREMENT) X(CALL) X(SUBSCRIPT) \
+	X(INT_LITERAL) X(FLOAT_LITERAL) X(CHAR_LITERAL) X(STRING_LITERAL) X(BOOL_LITERAL) \
+	X(IDENTIFIER) X(PARENTHESIZED)
+
+class FlatTree {
+public:
+	using Index = std::uint32_t;
+	static constexpr Index none = UINT32_MAX;
+
+	enum class Kind : std::uint8_t {
+#define FLAT_KIND_ENUMERATOR(name) name,
+		FLAT_KINDS(FLAT_KIND_ENUMERATOR)
+#undef FLAT_KIND_ENUMERATOR
+	};
+
+	struct Data {
+		Index lhs;
+		Index rhs;
+	};
+
+	// Flattens the unit's declarations through a Visitor. The names are the
+	// unit's own, so the tree must not outlive it.
+	FlatTree(TranslationUnit&);
+
+	std::size_t size() const { return kinds.size(); }
+	std::size_t bytes() const;
+	std::span<const Index> declarations() const { return roots; }
+
+	Kind kind(Index node) const { return kinds[node]; }
+	Token::Type op(Index node) const { return static_cast<Token::Type>(operators[node]); }
+	const Data& data(Index node) const { return fields[node]; }
+	std::span<const Index> list(Index at) const { return {extra.data() + at + 1, extra[at]}; }
+	Index extra_at(Index at) const { return extra[at]; }
+	std::string_view string(Index at) const { return strings[at]; }
+	float float_value(Index node) const { return std::bit_cast<float>(fields[node].lhs); }
+
+	// Calls the function on every direct child of the node, in source order.
+	// A subtree is the range from its root to its end, so the children are
+	// found without looking at the kind.
+	template<typename Function>
+	void for_each_child(Index node, Function function) const {
+		for (Index child = node + 1, end = ends[node]; child < end; child = ends[child]) {
+			function(child);
+		}
+	}
+
+	// Source text, exactly as Printer writes it.
+	void print(std::ostream&) const;
+	// One line per node: its index, kind, operator, name or value, and the
+	// indices of its children.
+	void dump(std::ostream&) const;
+
+	static std::string_view name(Kind);
+
+private:
+	friend class Flattener;
+
+	std::vector<Kind> kinds;
+	std::vector<std::uint8_t> operators;
+	std::vector<Data> fields;
+	// One past the last node of each node's subtree
+	std::vector<Index> ends;
+	std::vector<Index> extra;
+	std::vector<std::string_view> strings;
+	std::vector<Index> roots;
+};
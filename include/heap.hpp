@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "value.hpp"
+
+class Array;
+
+// Owner of the arrays made while an engine runs. Values refer to them
+// without counting; the collector frees the arrays no root reaches. New
+// arrays start in the nursery, and once the nursery holds nursery_size bytes
+// the engine collects it at its next safepoint, promoting the arrays still
+// reached to the old generation. The old generation is swept too once it has
+// grown to twice what survived the last full collection, or to twice the
+// nursery size before the first.
+//
+// An array's elements are scalars, so marking the roots is the whole trace,
+// and no old array can reach a young one: collections need no write barrier
+// or remembered set.
+class Heap {
+public:
+	struct Stats {
+		std::size_t minor_collections = 0;
+		std::size_t major_collections = 0;
+		std::chrono::nanoseconds pause{};
+		std::chrono::nanoseconds longest_pause{};
+		std::size_t allocated_bytes = 0;
+		std::size_t promoted_bytes = 0;
+		std::size_t freed_bytes = 0;
+		std::size_t peak_bytes = 0;
+	};
+
+	// Makes the heap current on this thread until the scope ends
+	class Scope {
+	public:
+		Scope(Heap&);
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+	private:
+		Heap* previous;
+	};
+
+	static constexpr std::size_t default_nursery_size = 4 << 20;
+
+	explicit Heap(std::size_t = default_nursery_size);
+	Heap(const Heap&) = delete;
+	Heap& operator=(const Heap&) = delete;
+	// Frees every array, reached or not
+	~Heap();
+
+	// The heap new arrays go to; making one without a current heap fails
+	static Heap& current();
+
+	void adopt(Array*);
+	// Accounts for the array's storage growing or shrinking by the bytes
+	void resized(const Array&, std::ptrdiff_t);
+
+	// Whether the engine should collect at its next safepoint
+	bool due() const { return young_bytes >= nursery_size; }
+
+	// Calls roots, which must pass every value the engine may still read to
+	// mark(), then frees the arrays left unmarked.
+	template<typename Roots>
+	void collect(Roots&& roots) {
+		auto start = std::chrono::steady_clock::now();
+		major = old_bytes >= old_limit;
+		roots();
+		sweep(start);
+	}
+
+	void mark(const Value& value) {
+		if (is_array(value.type())) {
+			auto& header = *value.payload.array;
+			header.marked |= major || !header.old;
+		}
+	}
+
+	void mark(std::span<const Value> values) {
+		for (auto& value : values) {
+			mark(value);
+		}
+	}
+
+	const Stats& stats() const { return statistics; }
+
+private:
+	void sweep(std::chrono::steady_clock::time_point);
+
+	std::size_t nursery_size;
+	std::vector<Array*> young;
+	std::vector<Array*> old;
+	std::size_t young_bytes = 0;
+	std::size_t old_bytes = 0;
+	std::size_t old_limit;
+	bool major = false;
+	Stats statistics;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+#include "ast.hpp"
+
+// Replacement of the old source bytes [offset, offset + removed) by inserted
+// new bytes.
+struct Edit {
+	std::size_t offset;
+	std::size_t removed;
+	std::size_t inserted;
+};
+
+// Front end for editors. parse records where every top-level declaration
+// ends; reparse then lexes and parses only the declarations an edit touches,
+// from the one containing the edit up to the first unchanged boundary after
+// it, and splices them into the unit. Every other declaration node is kept;
+// only the offsets of those after the edit move. Replaced nodes stay in the unit's Arena until it is released.
+// If the new text does not parse, the exception propagates and the unit is
+// left describing its previous source.
+class IncrementalParser {
+public:
+	std::unique_ptr<TranslationUnit> parse(std::string_view);
+	// Returns the number of declarations that were parsed again.
+	std::size_t reparse(TranslationUnit&, std::string_view, const Edit&);
+
+private:
+	std::vector<Declaration*> parse_chunk(TranslationUnit&, std::string_view, std::size_t, std::size_t);
+};
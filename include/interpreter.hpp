@@ -1,15 +1,95 @@
+#pragma once
+
+#include <exception>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
-#include "token.hpp"
 #include "ast.hpp"
+#include "stats.hpp"
+#include "heap.hpp"
+#include "profiler.hpp"
+#include "stop.hpp"
+
+class MemoryCache;
+struct Program;
 
 class Interpreter {
 public:
-	void interpret(const std::string&);
-	void interpret_file(const std::string&);
+	enum class Engine {
+		VM, AST
+	};
+
+	enum class DumpFormat {
+		NONE, SOURCE, SEXP, FLAT
+	};
+
+	struct Options {
+		Engine engine = Engine::VM;
+		DumpFormat dump_ast = DumpFormat::NONE;
+		// Only parses, reporting every syntax error found as
+		// "name:line:column: message" to the diagnostics stream
+		bool check = false;
+		bool optimize = false;
+		// 0 uses every hardware thread; a memory limit implies 1
+		std::size_t parse_threads = 0;
+		// Compiled bytecode is reused from here when set (VM engine only)
+		std::string cache_directory;
+		// Shared by the Interpreters of a server, checked before the
+		// directory (VM engine only)
+		MemoryCache* memory_cache = nullptr;
+		// Heap bytes the interpreting thread may hold at once; 0 for no limit
+		std::size_t memory_limit = 0;
+		// Deepest nesting of calls, not counting tail calls; 0 for no limit
+		std::size_t recursion_limit = 1'000'000;
+		// Bytes of new arrays that start a collection; 0 collects whenever
+		// an array is made
+		std::size_t nursery_size = Heap::default_nursery_size;
+		// Set from another thread to stop the program with its message
+		const StopRequest* stop = nullptr;
+		// Compiles hot functions to native code (VM engine only, and not
+		// while profiling); jit_stats reports on it to stderr after the run
+		bool jit = true;
+		bool jit_stats = false;
+		// Writes per-phase statistics as JSON to stats_path, or to stderr
+		bool stats = false;
+		std::string stats_path;
+		// Samples the running program; collapsed stacks go to profile_path
+		// and a per-function and per-line summary to stderr
+		bool profile = false;
+		std::string profile_path = "profile.folded";
+	};
+
+	Interpreter();
+	// Program output goes to the first stream, diagnostics, statistics and
+	// profile reports to the second. Instances share no mutable state, so
+	// several can run on different threads.
+	Interpreter(const Options&, std::ostream& = std::cout, std::ostream& = std::cerr);
+
+	int interpret(std::string_view);
+	int interpret_file(const std::string&);
 private:
-	std::vector<Token> tokenize(const std::string&);
-	std::shared_ptr<TranslationUnit> parse(const std::vector<Token>&);
+	std::unique_ptr<TranslationUnit> parse(std::string_view);
+	int check(std::string_view);
+	void optimize(TranslationUnit&);
+	int execute(const Program&);
+	template<typename Function>
+	int run(Function&&);
+	void fail(const std::exception&);
+	template<typename Machine>
+	void count_calls(const Machine&);
+	void count_collections(const Heap::Stats&);
+	Profiler* start_profiler();
+	int finish(int);
+
+	Options options;
+	std::ostream& output;
+	std::ostream& errors;
+	Statistics statistics;
+	std::unique_ptr<Profiler> profiler;
+	std::string_view source;
+	// The file being interpreted, for diagnostics
+	std::string name = "<source>";
 };
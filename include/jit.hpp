@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "stop.hpp"
+
+// Baseline native tier of the VM. A hot function is compiled as a whole
+// from the types its locals and operands provably have at every
+// instruction: starting from the parameter types, the bytecode is walked to
+// a fixed point, with CONVERT fixing the declared type of every stored
+// value. Each instruction then becomes a fixed sequence of machine code on
+// unboxed payloads. Locals stay in the VM's frame slots, so a loop that is
+// already running in the VM can carry on natively from its start.
+//
+// Functions that call, use globals or strings, raise an int to a power or
+// use a value whose type depends on the path taken are rejected and stay in
+// the VM. With a stop request, every loop back edge checks it and returns
+// STOPPED once it is set. Only x86-64 has a code generator; elsewhere every
+// function is rejected.
+class Jit {
+public:
+	enum class Status : std::int32_t {
+		RETURNED, DIVISION_BY_ZERO, SHIFT_OUT_OF_RANGE, STOPPED
+	};
+
+	// Runs on a frame's locals from its first instruction (0) or from one of
+	// its loop entries, and stores the returned value, or the shift count
+	// for SHIFT_OUT_OF_RANGE, in the last argument.
+	using Entry = Status (*)(Value*, std::uint32_t, Value*);
+
+	static constexpr std::size_t tag_offset = offsetof(Value, tag);
+	static constexpr std::size_t payload_offset = offsetof(Value, payload);
+
+	struct Code {
+		Entry entry;
+		// The instructions it can start at: 0 and every loop start that is
+		// reached with an empty operand stack
+		std::vector<std::uint32_t> loop_entries;
+		std::size_t size;
+
+		bool enters(std::uint32_t) const;
+	};
+
+	Jit(const StopRequest* = nullptr);
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+	~Jit();
+
+	// nullptr, with the reason in the string, when the function is rejected.
+	const Code* compile(const Function&, const Program&, std::string&);
+
+private:
+	struct Region {
+		void* memory;
+		std::size_t size;
+	};
+
+	const StopRequest* stop;
+	std::vector<std::unique_ptr<Code>> codes;
+	std::vector<Region> regions;
+};
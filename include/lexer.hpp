@@ -1,15 +1,24 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <unordered_set>
 
 #include "token.hpp"
+#include "diagnostic.hpp"
 
 class Lexer {
 public:
-	Lexer(const std::string&);
+	// The offset is where the input starts in the whole source, for lexing
+	// one slice of a larger buffer. Malformed input is thrown as an error,
+	// or with a diagnostics vector recorded there and returned as an INVALID
+	// token, after which lexing goes on.
+	Lexer(std::string_view, std::size_t = 0, std::vector<Diagnostic>* = nullptr);
 
+	Token next();
 	std::vector<Token> tokenize();
 
 private:
@@ -20,13 +29,39 @@ private:
 	Token extract_operator();
 	
 	void skip_line_comment();
-	void skip_multiline_comment();
+	// False when the comment is never closed
+	bool skip_multiline_comment();
+	// Reports the input from the current offset to the given end as malformed
+	Token fail(std::string, std::size_t);
 
-	static const std::string metachars;
-	static const std::unordered_set<std::string> keywords;
-	static const std::unordered_set<std::string> types;
-	static const std::unordered_set<std::string> specials;
+	std::pair<Token::Type, std::size_t> match_operator() const;
+	char peek(std::size_t = 0) const;
+	Token token(Token::Type, std::string_view, std::size_t) const;
 
-	std::string input;
+	static Token::Type classify(std::string_view);
+
+	static const std::string_view metachars;
+
+	std::string_view input;
+	std::size_t base;
 	std::size_t offset = 0;
-};
\ No newline at end of file
+	std::vector<Diagnostic>* diagnostics;
+};
+
+// Pulls tokens from a Lexer only as the parser asks for them, remembering
+// just the few it has peeked at. Past the end of the input every token is
+// END, however far ahead the parser looks.
+class TokenStream {
+public:
+	static constexpr std::size_t lookahead = 4;
+
+	explicit TokenStream(Lexer);
+
+	const Token& peek(std::size_t = 0);
+	Token advance();
+private:
+	Lexer lexer;
+	std::array<Token, lookahead> buffer;
+	std::size_t head = 0;
+	std::size_t size = 0;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include "visitor.hpp"
+#include "value.hpp"
+
+// Rewrites a resolved TranslationUnit in place: folds constant operators,
+// drops branches whose condition is a constant, unwraps parentheses and
+// turns multiplications and divisions by powers of two into cheaper
+// operations where the static types make that exact. New nodes are taken
+// from the unit's arena; replaced ones are simply left unreferenced there.
+class Optimizer : public Visitor {
+public:
+	std::size_t optimize(TranslationUnit&);
+public:
+	void visit(TranslationUnit&) override;
+public:
+	void visit(Declaration::PtrDeclarator&) override;
+	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
+	void visit(Declaration::InitDeclarator&) override;
+	void visit(VarDeclaration&) override;
+	void visit(ParameterDeclaration&) override;
+	void visit(FuncDeclaration&) override;
+public:
+	void visit(CompoundStatement&) override;
+	void visit(DeclarationStatement&) override;
+	void visit(ExpressionStatement&) override;
+	void visit(ConditionalStatement&) override;
+	void visit(WhileStatement&) override;
+	void visit(RepeatStatement&) override;
+	void visit(ForStatement&) override;
+	void visit(ReturnStatement&) override;
+	void visit(BreakStatement&) override;
+	void visit(ContinueStatement&) override;
+public:
+	void visit(BinaryOperation&) override;
+	void visit(PrefixExpression&) override;
+	void visit(PostfixIncrementExpression&) override;
+	void visit(PostfixDecrementExpression&) override;
+	void visit(FunctionCallExpression&) override;
+	void visit(SubscriptExpression&) override;
+	void visit(IntLiteral&) override;
+	void visit(FloatLiteral&) override;
+	void visit(CharLiteral&) override;
+	void visit(StringLiteral&) override;
+	void visit(BoolLiteral&) override;
+	void visit(IdentifierExpression&) override;
+	void visit(ParenthesizedExpression&) override;
+
+private:
+	template<typename T>
+	void rewrite(T*&);
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		return arena->make<T>(std::forward<Args>(args)...);
+	}
+
+	Expression* literal(const Value&);
+	Expression* reduce(BinaryOperation&);
+	Statement* scoped(Statement*);
+
+	Arena* arena = nullptr;
+	Expression* expression = nullptr;
+	Statement* statement = nullptr;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Fixed-size byte buffer in front of a caller's stream. Text and numbers are
+// formatted in place and handed to the stream only when the buffer fills up,
+// on flush and on destruction, so writing many small fragments costs neither
+// allocations nor a system call each.
+class OutputBuffer {
+public:
+	static constexpr std::size_t default_capacity = 256 * 1024;
+
+	explicit OutputBuffer(std::ostream&, std::size_t = default_capacity);
+	OutputBuffer(const OutputBuffer&) = delete;
+	OutputBuffer& operator=(const OutputBuffer&) = delete;
+	~OutputBuffer();
+
+	OutputBuffer& operator<<(std::string_view);
+	OutputBuffer& operator<<(const char*);
+	OutputBuffer& operator<<(char);
+	OutputBuffer& operator<<(int);
+	OutputBuffer& operator<<(std::size_t);
+	// Formatted like an ostream at its default precision (%g).
+	OutputBuffer& operator<<(float);
+
+	void flush();
+
+private:
+	char* reserve(std::size_t);
+
+	std::ostream& sink;
+	std::unique_ptr<char[]> data;
+	std::size_t capacity;
+	std::size_t size = 0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+
+// Parses the top-level declarations of a source on several threads. A byte
+// pre-scan cuts the source where brace depth returns to zero after a '}' or
+// ';', each worker lexes and parses whole chunks into its own Arena, and the
+// results are concatenated in source order and adopted by the unit's Arena,
+// so the tree is the same as the one a single Parser would build.
+class ParallelParser {
+public:
+	static constexpr std::size_t min_chunk_size = 64 * 1024;
+
+	ParallelParser(std::string_view, std::size_t = 0);
+
+	std::unique_ptr<TranslationUnit> parse();
+
+	// Cuts the source at declaration boundaries into chunks of at least the
+	// given size; the last chunk holds whatever follows the final boundary.
+	static std::vector<std::string_view> split(std::string_view, std::size_t);
+	// End of the top-level declaration starting at the offset, or npos.
+	static std::size_t boundary(std::string_view, std::size_t);
+
+private:
+	std::string_view source;
+	std::size_t threads;
+};
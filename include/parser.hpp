@@ -1,9 +1,15 @@
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "token.hpp"
+#include "lexer.hpp"
+#include "diagnostic.hpp"
 #include "ast.hpp"
 #include "declaration.hpp"
 #include "statement.hpp"
@@ -11,44 +17,59 @@
 
 class Parser {
 public:
-	Parser(const std::vector<Token>&);
-
-	std::shared_ptr<TranslationUnit> parse();
-	std::shared_ptr<Declaration> parse_declaration();
-	std::shared_ptr<FuncDeclaration> parse_function_declaration();
-	std::shared_ptr<ParameterDeclaration> parse_parameter_declaration();
-	std::shared_ptr<VarDeclaration> parse_var_declaration();
-	std::shared_ptr<Declaration::InitDeclarator> parse_init_declarator();
-	std::shared_ptr<Declaration::Declarator> parse_declarator();
-
-	std::shared_ptr<Statement> parse_statement();
-	std::shared_ptr<CompoundStatement> parse_compound_statement();
-	std::shared_ptr<ConditionalStatement> parse_conditional_statement();
-	std::shared_ptr<LoopStatement> parse_loop_statement();
-	std::shared_ptr<WhileStatement> parse_while_statement();
-	std::shared_ptr<ForStatement> parse_for_statement();
-	std::shared_ptr<RepeatStatement> parse_repeat_statement();
-	std::shared_ptr<JumpStatement> parse_jump_statement();
-	std::shared_ptr<BreakStatement> parse_break_statement();
-	std::shared_ptr<ContinueStatement> parse_continue_statement();
-	std::shared_ptr<ReturnStatement> parse_return_statement();
-	std::shared_ptr<DeclarationStatement> parse_declaration_statement();
-	std::shared_ptr<ExpressionStatement> parse_expression_statement();
-
-	std::shared_ptr<Expression> parse_expression();
-	std::shared_ptr<BinaryExpression> parse_binary_expression(int);
-	std::shared_ptr<UnaryExpression> parse_unary_expression();
-	std::shared_ptr<PostfixExpression> parse_postfix_expression();
-	std::vector<std::shared_ptr<Expression>> parse_function_call_expression();
-	std::shared_ptr<Expression> parse_subscript_expression();
-	std::shared_ptr<PrimaryExpression> parse_primary_expression();
-	std::shared_ptr<ParenthesizedExpression> parse_parenthesized_expression();
+	// Syntax errors are thrown, or with a diagnostics vector each recorded
+	// there without unwinding: the parse functions return early until
+	// parsing resumes after the next ';' or block, or at the '}' that closes
+	// the enclosing one. A tree with errors is incomplete and only good for
+	// discarding.
+	Parser(TokenStream&&, std::vector<Diagnostic>* = nullptr);
+
+	std::unique_ptr<TranslationUnit> parse();
+	std::vector<Declaration*> parse_declarations(Arena&);
+	Declaration* parse_declaration();
+	FuncDeclaration* parse_function_declaration();
+	ParameterDeclaration* parse_parameter_declaration();
+	VarDeclaration* parse_var_declaration();
+	Declaration::InitDeclarator* parse_init_declarator();
+	Declaration::Declarator* parse_declarator();
+
+	Statement* parse_statement();
+	CompoundStatement* parse_compound_statement();
+	ConditionalStatement* parse_conditional_statement();
+	LoopStatement* parse_loop_statement();
+	WhileStatement* parse_while_statement();
+	ForStatement* parse_for_statement();
+	RepeatStatement* parse_repeat_statement();
+	JumpStatement* parse_jump_statement();
+	BreakStatement* parse_break_statement();
+	ContinueStatement* parse_continue_statement();
+	ReturnStatement* parse_return_statement();
+	DeclarationStatement* parse_declaration_statement();
+	ExpressionStatement* parse_expression_statement();
+
+	Expression* parse_expression();
+	BinaryExpression* parse_binary_expression(int);
+	UnaryExpression* parse_unary_expression();
+	PostfixExpression* parse_postfix_expression();
+	std::span<Expression*> parse_function_call_expression();
+	Expression* parse_subscript_expression();
+	PrimaryExpression* parse_primary_expression();
+	ParenthesizedExpression* parse_parenthesized_expression();
 
 private:
-	std::vector<Token> tokens;
-	std::size_t offset;
+	TokenStream tokens;
+	Arena* arena;
+	// Offset of the top-level declaration being parsed
+	std::uint32_t origin = 0;
+	std::vector<Diagnostic>* diagnostics;
+	// Set from an error until the next synchronize(): no check matches and
+	// extract_token consumes nothing
+	bool recovering = false;
 
 private:
+	template<typename T, typename... Args>
+	T* make(Args&&...);
+
 	template<typename... Args>
 	bool check_token(const Args&...);
 
@@ -56,12 +77,49 @@ private:
 	bool match_token(const Args&...);
 
 	template<typename... Args>
-	std::string extract_token(const Args&...);
+	std::string_view extract_token(const Args&...);
 
 	template<typename... Args>
 	bool match_pattern(const Args&...);
 
+	// Type of the next token, INVALID while recovering
+	Token::Type next_type();
+	template<typename T>
+	T number(const Token&);
+
+	void error(const Token&, std::string);
+	void unexpected();
+	void synchronize(bool);
+
 private:
-	static const std::unordered_map<std::string, int> operator_precedences;
-	static const std::unordered_set<std::string> unary_operators;
+	struct BinaryOperator {
+		int precedence;
+		bool right_associative;
+	};
+
+	static constexpr auto binary_operators = [] {
+		std::array<BinaryOperator, Token::type_count> table{};
+		table.fill({-1, false});
+		for (auto type : {Token::ASSIGNMENT, Token::PLUS_ASSIGNMENT, Token::MINUS_ASSIGNMENT, Token::MULTIPLY_ASSIGNMENT,
+						  Token::DIVIDE_ASSIGNMENT, Token::MODULO_ASSIGNMENT, Token::POWER_ASSIGNMENT}) {
+			table[type] = {0, true};
+		}
+		table[Token::OR] = {1, false};
+		table[Token::AND] = {2, false};
+		table[Token::EQUAL] = table[Token::NOT_EQUAL] = {3, false};
+		table[Token::LESS] = table[Token::LESS_EQUAL] = table[Token::GREATER] = table[Token::GREATER_EQUAL] = {4, false};
+		table[Token::SHIFT_LEFT] = table[Token::SHIFT_RIGHT] = {5, false};
+		table[Token::PLUS] = table[Token::MINUS] = {6, false};
+		table[Token::MULTIPLY] = table[Token::DIVIDE] = table[Token::MODULO] = {7, false};
+		table[Token::POWER] = {8, true};
+		return table;
+	}();
+
+	static constexpr auto unary_operators = [] {
+		std::array<bool, Token::type_count> table{};
+		for (auto type : {Token::PLUS, Token::MINUS, Token::AMPERSAND, Token::MULTIPLY, Token::NOT, Token::INCREMENT, Token::DECREMENT}) {
+			table[type] = true;
+		}
+		return table;
+	}();
 };
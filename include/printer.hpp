@@ -1,11 +1,20 @@
+#pragma once
+
+#include <ostream>
+
 #include "visitor.hpp"
+#include "output.hpp"
 
+// Prints the tree back as source text, buffered in front of the given stream.
 class Printer : public Visitor {
+public:
+	Printer(std::ostream&);
 public:
 	void visit(TranslationUnit&) override;
 public:
 	void visit(Declaration::PtrDeclarator&) override;
 	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
 	void visit(Declaration::InitDeclarator&) override;
 	void visit(VarDeclaration&) override;
 	void visit(ParameterDeclaration&) override;
@@ -35,4 +44,7 @@ public:
 	void visit(BoolLiteral&) override;
 	void visit(IdentifierExpression&) override;
 	void visit(ParenthesizedExpression&) override;
-};
\ No newline at end of file
+
+private:
+	OutputBuffer out;
+};
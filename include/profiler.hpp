@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <signal.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "source.hpp"
+
+// Sampling profiler behind --profile. A CPU-time interval timer raises
+// SIGPROF, whose handler only counts the tick; an engine with a profiler
+// attached checks for pending ticks at every instruction or statement and
+// hands over its call stack and current source offset there. Calls are
+// counted exactly, time is estimated from the samples. One profiler can be
+// active per process.
+class Profiler {
+public:
+	static constexpr std::chrono::microseconds interval{1000};
+	static constexpr std::uint32_t no_offset = -1;
+
+	Profiler();
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+	~Profiler();
+
+	static bool pending() {
+		return ticks.load(std::memory_order_relaxed) != 0;
+	}
+
+	std::uint32_t function(std::string_view);
+	void enter(std::uint32_t);
+	// The stack lists function ids from the outermost call inwards.
+	void sample(const std::vector<std::uint32_t>&, std::uint32_t);
+
+	// One "main;f;g count" line per distinct stack, as read by flamegraph.pl.
+	void write_folded(std::ostream&) const;
+	// Calls, inclusive and exclusive time per function and the hottest lines.
+	void write_report(std::ostream&, const LineTable&) const;
+
+private:
+	static void tick(int);
+
+	static std::atomic<int> ticks;
+
+	struct sigaction previous_action;
+	std::vector<std::string> names;
+	std::unordered_map<std::string, std::uint32_t> ids;
+	std::vector<std::size_t> calls;
+	std::map<std::vector<std::uint32_t>, std::size_t> stacks;
+	std::map<std::uint32_t, std::size_t> offsets;
+	std::size_t samples = 0;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "visitor.hpp"
+#include "symbols.hpp"
+
+// Static pass run before either engine: binds every IdentifierExpression and
+// Declarator to a Symbol, gives every function its interned signature, sizes
+// each function's frame and the global frame, and rejects undeclared names,
+// calls to unknown functions and conflicting declarations.
+//
+// It also clears the range check of a[i] in loops of the form
+//   i = <literal >= 0>;   (or int i = ...)
+//   while (i < len(a)) { ... i++; }
+// where the body writes neither i nor a before that last step and calls no
+// function that could shrink a: user functions and resize. It marks the
+// string appends that can extend a local in place, see BinaryOperation.
+class Resolver : public Visitor {
+public:
+	void resolve(TranslationUnit&);
+public:
+	void visit(TranslationUnit&) override;
+public:
+	void visit(Declaration::PtrDeclarator&) override;
+	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
+	void visit(Declaration::InitDeclarator&) override;
+	void visit(VarDeclaration&) override;
+	void visit(ParameterDeclaration&) override;
+	void visit(FuncDeclaration&) override;
+public:
+	void visit(CompoundStatement&) override;
+	void visit(DeclarationStatement&) override;
+	void visit(ExpressionStatement&) override;
+	void visit(ConditionalStatement&) override;
+	void visit(WhileStatement&) override;
+	void visit(RepeatStatement&) override;
+	void visit(ForStatement&) override;
+	void visit(ReturnStatement&) override;
+	void visit(BreakStatement&) override;
+	void visit(ContinueStatement&) override;
+public:
+	void visit(BinaryOperation&) override;
+	void visit(PrefixExpression&) override;
+	void visit(PostfixIncrementExpression&) override;
+	void visit(PostfixDecrementExpression&) override;
+	void visit(FunctionCallExpression&) override;
+	void visit(SubscriptExpression&) override;
+	void visit(IntLiteral&) override;
+	void visit(FloatLiteral&) override;
+	void visit(CharLiteral&) override;
+	void visit(StringLiteral&) override;
+	void visit(BoolLiteral&) override;
+	void visit(IdentifierExpression&) override;
+	void visit(ParenthesizedExpression&) override;
+
+private:
+	// A loop whose subscripts of array by index are in range as long as
+	// nothing in the body but its last statement, step, writes either.
+	struct BoundedLoop {
+		Symbol index;
+		Symbol array;
+		Expression* step;
+		std::vector<SubscriptExpression*> subscripts;
+		bool proved = true;
+	};
+
+	const Type* declarator_type(Declaration::Declarator&, std::string_view);
+	void declare(Declaration::InitDeclarator&, std::string_view);
+	bool bound(WhileStatement&, const Statement*);
+	void write(Expression*, const Expression*);
+
+	std::vector<BoundedLoop> loops;
+	// The statement before the one being resolved in the same compound statement
+	const Statement* preceding = nullptr;
+	const Statement* current = nullptr;
+	// Variable writes resolved so far
+	std::uint32_t writes = 0;
+
+	TypeContext* types = nullptr;
+	SymbolTable symbols;
+	const FuncDeclaration* function = nullptr;
+	std::uint32_t call_sites = 0;
+	std::unordered_map<std::string_view, const Type*> functions;
+};
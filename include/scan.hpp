@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Byte-class scanners used by the Lexer. Each one starts at an offset into
+// the input and classifies 16 (SSE2, NEON) or 32 (AVX2) bytes per step,
+// finishing the last partial block one byte at a time. Building with
+// SCAN_NO_SIMD leaves only the byte-at-a-time loops.
+
+// End of the run of whitespace starting at the offset.
+std::size_t scan_whitespace(std::string_view, std::size_t);
+// End of the run of identifier characters [A-Za-z0-9_] starting at the offset.
+std::size_t scan_identifier(std::string_view, std::size_t);
+// End of the run of decimal digits starting at the offset.
+std::size_t scan_digits(std::string_view, std::size_t);
+// Position of the next newline, or the input size if there is none.
+std::size_t scan_line_end(std::string_view, std::size_t);
+// Position of the next "*/", or npos if the comment is never closed.
+std::size_t scan_comment_end(std::string_view, std::size_t);
+
+// Name of the instruction set the scanners were built for.
+std::string_view scan_implementation();
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "interpreter.hpp"
+#include "cache.hpp"
+#include "stop.hpp"
+
+// Long-running mode behind --serve. Clients connect to a Unix socket and
+// send requests that name a script file or carry its source inline; each is
+// answered with the script's exit status, output and diagnostics. Every
+// request runs in its own Interpreter under the options' memory limit, at
+// most `jobs` of them at a time, and all of them share one MemoryCache of
+// compiled programs. At most max_connections clients are served at once, a
+// connection that sends or reads nothing for idle_timeout is closed, and an
+// inline source larger than the memory limit, or than max_source_size
+// without one, is refused as malformed. A request still running after
+// time_limit, when one is given, is stopped and fails.
+//
+// A connection carries any number of requests, one after another:
+//   request:  "path <path>\n", or "source <size>\n" followed by the source
+//   response: "<status> <output size> <error size>\n" followed by the output
+//             and then the diagnostics
+class Server {
+public:
+	static constexpr std::size_t cache_capacity = 1024;
+	static constexpr std::size_t max_connections = 256;
+	static constexpr std::size_t max_source_size = 64 << 20;
+	static constexpr int idle_timeout = 30;
+
+	// 0 jobs uses every hardware thread; a zero time limit lets requests run
+	// for as long as they take
+	Server(const Interpreter::Options&, const std::string&, std::size_t, std::chrono::milliseconds = {});
+
+	// Serves until SIGINT or SIGTERM, then stops the requests still running,
+	// answers them with the failure and removes the socket.
+	int run();
+
+private:
+	struct Running {
+		StopRequest stop{nullptr};
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	void serve(int);
+	void watch(std::stop_token);
+
+	Interpreter::Options options;
+	std::string path;
+	MemoryCache cache;
+	std::counting_semaphore<> slots;
+	std::mutex mutex;
+	std::condition_variable closed;
+	std::unordered_set<int> connections;
+	std::chrono::milliseconds time_limit;
+	std::string time_limit_message;
+	std::unordered_set<Running*> running;
+	bool stopping = false;
+};
+
+// Sends requests to a Server over one connection.
+class Client {
+public:
+	struct Response {
+		int status;
+		std::string output;
+		std::string errors;
+	};
+
+	Client(const std::string&);
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+	~Client();
+
+	// Relative paths are resolved against the client's working directory.
+	Response run_file(const std::string&);
+	Response run_source(std::string_view);
+
+private:
+	Response request(const std::string&, std::string_view);
+
+	int fd;
+	std::string buffer;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of a script's bytes. Regular files are memory-mapped so the
+// lexer reads the page cache directly; pipes, terminals and stdin ("-") are
+// read into an owned buffer instead.
+class SourceBuffer {
+public:
+	SourceBuffer(const std::string&);
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+	~SourceBuffer();
+
+	std::string_view view() const;
+	bool is_mapped() const;
+
+private:
+	void read_all(int);
+
+	const char* data = nullptr;
+	std::size_t size = 0;
+	bool mapped = false;
+	std::string buffer;
+};
+
+// Maps byte offsets in a source to 1-based line and column numbers.
+class LineTable {
+public:
+	LineTable(std::string_view);
+
+	std::size_t line(std::size_t) const;
+	// In bytes from the start of the line
+	std::size_t column(std::size_t) const;
+
+private:
+	std::vector<std::size_t> starts;
+};
@@ -1,55 +1,49 @@
 #pragma once
 
-#include <string>
-#include <vector>
-#include <memory>
+#include <span>
+#include <utility>
 
 #include "ast.hpp"
 
 struct VarDeclaration;
+struct FunctionCallExpression;
 
-using StatementSeq = std::vector<std::shared_ptr<Statement>>;
+using StatementSeq = std::span<Statement*>;
 
 struct CompoundStatement: public Statement {
 	StatementSeq statements;
 
-	CompoundStatement(const StatementSeq&);
+	CompoundStatement(StatementSeq);
 	void accept(Visitor&) override;
 };
 
 struct ConditionalStatement: public Statement {
-	std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>> if_branch;
-	std::vector<std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>> elif_branches;
-	std::shared_ptr<Statement> else_branch;
-
-	ConditionalStatement(
-		const std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>&,
-		const std::vector<std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>>&,
-		const std::shared_ptr<Statement>&
-	);
+	using Branch = std::pair<Expression*, Statement*>;
+
+	Branch if_branch;
+	std::span<Branch> elif_branches;
+	Statement* else_branch;
+
+	ConditionalStatement(const Branch&, std::span<Branch>, Statement*);
 	void accept(Visitor&) override;
 };
 
 struct LoopStatement: public Statement {
-	virtual ~LoopStatement() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct WhileStatement: public LoopStatement {
-	std::shared_ptr<Expression> condition;
-	std::shared_ptr<Statement> statement;
+	Expression* condition;
+	Statement* statement;
 
-	WhileStatement(
-		const std::shared_ptr<Expression>&,
-		const std::shared_ptr<Statement>&
-	);
+	WhileStatement(Expression*, Statement*);
 	void accept(Visitor&) override;
 };
 
 struct RepeatStatement: public LoopStatement {
-	std::shared_ptr<Statement> statement;
+	Statement* statement;
 
-	RepeatStatement(const std::shared_ptr<Statement>&);
+	RepeatStatement(Statement*);
 	void accept(Visitor&) override;
 };
 
@@ -58,14 +52,17 @@ struct ForStatement: public LoopStatement {
 };
 
 struct JumpStatement: public Statement {
-	virtual ~JumpStatement() = default;
 	virtual void accept(Visitor&) override = 0;
 };
 
 struct ReturnStatement: public JumpStatement {
-	std::shared_ptr<Expression> expression;
+	Expression* expression;
+	// The expression, when it is a call to a function whose return type is
+	// that of the enclosing one, so the callee can take over its frame. Set
+	// by the Resolver.
+	FunctionCallExpression* tail_call = nullptr;
 
-	ReturnStatement(const std::shared_ptr<Expression>&);
+	ReturnStatement(Expression*);
 	void accept(Visitor&) override;
 };
 
@@ -78,15 +75,15 @@ struct ContinueStatement: public JumpStatement {
 };
 
 struct DeclarationStatement: public Statement {
-	std::shared_ptr<VarDeclaration> declaration;
+	VarDeclaration* declaration;
 
-	DeclarationStatement(const std::shared_ptr<VarDeclaration>&);
+	DeclarationStatement(VarDeclaration*);
 	void accept(Visitor&) override;
 };
 
 struct ExpressionStatement: public Statement {
-	std::shared_ptr<Expression> expression;
+	Expression* expression;
 
-	ExpressionStatement(const std::shared_ptr<Expression>&);
+	ExpressionStatement(Expression*);
 	void accept(Visitor&) override;
-};
\ No newline at end of file
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Measurements behind --stats. Each phase records its wall time, the heap
+// allocations made while it ran (counted by the program's replacement of the
+// global operator new) and the peak resident set size at its end. Counters
+// and notes carry sizes and outcomes such as token counts or cache hits.
+// A disabled instance just runs the phases.
+class Statistics {
+public:
+	Statistics(bool);
+
+	template<typename Function>
+	decltype(auto) measure(std::string_view name, Function&& function) {
+		if (!enabled) {
+			return function();
+		}
+		Recorder recorder{*this, name, sample()};
+		return function();
+	}
+
+	bool active() const;
+	void count(std::string_view, long long);
+	void note(std::string_view, std::string_view);
+	void write(std::ostream&) const;
+
+private:
+	struct Sample {
+		std::chrono::steady_clock::time_point time;
+		std::size_t allocations;
+		std::size_t allocated_bytes;
+	};
+
+	struct Phase {
+		std::string name;
+		double milliseconds;
+		std::size_t allocations;
+		std::size_t allocated_bytes;
+		long peak_rss_kb;
+	};
+
+	struct Recorder {
+		Statistics& statistics;
+		std::string_view name;
+		Sample start;
+		~Recorder();
+	};
+
+	static Sample sample();
+
+	bool enabled;
+	std::chrono::steady_clock::time_point start;
+	std::vector<Phase> phases;
+	std::vector<std::pair<std::string, long long>> counters;
+	std::vector<std::pair<std::string, std::string>> notes;
+};
+
+// Caps the heap bytes the current thread holds while the limit is in scope;
+// an allocation past it throws MemoryLimitExceeded. Memory freed by other
+// threads is not credited back, and neither is memory allocated before the
+// limit took effect. Threads the current one starts are not limited. The
+// limit lifts after the first failure so the thread can unwind and report it.
+class AllocationLimit {
+public:
+	// 0 imposes no limit
+	AllocationLimit(std::size_t);
+	AllocationLimit(const AllocationLimit&) = delete;
+	AllocationLimit& operator=(const AllocationLimit&) = delete;
+	~AllocationLimit();
+};
+
+class MemoryLimitExceeded : public std::bad_alloc {
+public:
+	const char* what() const noexcept override;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <atomic>
+
+// Set from another thread to stop a running program. The engines check it
+// at every loop iteration and call, and native code at every loop back edge;
+// once it points to a message the run fails with that message, which must
+// outlive the run.
+using StopRequest = std::atomic<const char*>;
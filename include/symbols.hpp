@@ -1,31 +1,52 @@
 #pragma once
 
-#include <string>
-#include <vector>
+#include <cstdint>
+#include <string_view>
 #include <unordered_map>
-#include <memory>
-
-class Object {
-protected:
-	std::shared_ptr<Type> type;
-	int scope_level;
-};
+#include <vector>
 
-class Variable : public Object {
-	std::shared_ptr<Value> value;
-	bool is_initialized;
-};
+struct Type;
 
-class Function : public Object {
-	std::vector<std::shared_ptr<Type>> parameters;
-	std::shared_ptr<CompoundStatement> body;
-};
+// Storage a name was bound to by the Resolver. depth is the nesting level of
+// the declaring scope: 0 is the global frame, 1 a function's parameters and
+// anything deeper a block inside it. Every non-global symbol indexes the
+// frame of the function it appears in.
+struct Symbol {
+	static constexpr std::uint32_t unresolved = UINT32_MAX;
 
+	std::uint32_t depth = unresolved;
+	std::uint32_t slot = 0;
+	const Type* type = nullptr;
 
-class Scope {
-	std::unordered_map<std::string, SymbolInfo>
+	bool resolved() const { return depth != unresolved; }
+	bool global() const { return depth == 0; }
 };
 
+// Compile-time scope chain used to assign slots. Block scopes reuse the slots
+// of the blocks that closed before them, so a frame is only as large as its
+// deepest nesting of live variables.
 class SymbolTable {
+public:
+	SymbolTable();
+
+	void enter();
+	void leave();
+
+	void begin_function();
+	std::size_t end_function();
+
+	Symbol declare(std::string_view, const Type*);
+	const Symbol* find(std::string_view) const;
+
+	std::size_t global_count() const;
+private:
+	struct Scope {
+		std::unordered_map<std::string_view, Symbol> symbols;
+		std::uint32_t first_slot;
+	};
+
 	std::vector<Scope> scopes;
-};
\ No newline at end of file
+	std::uint32_t next_slot = 0;
+	std::uint32_t frame_size = 0;
+	std::uint32_t globals = 0;
+};
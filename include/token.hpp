@@ -1,24 +1,71 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 
+// Token values are views into the source buffer handed to the Lexer; that
+// buffer has to outlive every token produced from it.
 struct Token {
 	enum Type{
 		INTEGER_LITERAL, FLOAT_LITERAL, CHAR_LITERAL, BOOL_LITERAL, STRING_LITERAL, POINTER_LITERAL,
-		IDENTIFIER, KEYWORD, TYPE,
-		SPECIAL,
+		IDENTIFIER, TYPE,
+		IF, ELIF, ELSE, WHILE, FOR, REPEAT, RETURN, BREAK, CONTINUE,
+		PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, POWER,
+		SHIFT_LEFT, SHIFT_RIGHT,
+		INCREMENT, DECREMENT,
+		AMPERSAND,
+		AND, OR, NOT,
+		EQUAL, NOT_EQUAL, GREATER, LESS, GREATER_EQUAL, LESS_EQUAL,
+		ASSIGNMENT, PLUS_ASSIGNMENT, MINUS_ASSIGNMENT, MULTIPLY_ASSIGNMENT, DIVIDE_ASSIGNMENT, MODULO_ASSIGNMENT, POWER_ASSIGNMENT,
+		COMMA, SEMICOLON, LPAREN, RPAREN, LBRACE, RBRACE, LBRACKET, RBRACKET,
 		INVALID, END
 	} type;
 
-	std::string value;
+	std::string_view value;
+	// Byte offset of the token's first character in the whole source
+	std::uint32_t offset;
 
-	Token(Type type, const std::string& value) : type(type), value(value) {}
+	Token() : Token(END, "") {}
+	Token(Type type, std::string_view value, std::uint32_t offset = 0) : type(type), value(value), offset(offset) {}
 
 	bool operator==(Type other_type) const {
 		return type == other_type;
 	}
 
-	bool operator==(const std::string& other_value) const {
+	bool operator==(std::string_view other_value) const {
 		return value == other_value;
 	}
-};
\ No newline at end of file
+
+	static constexpr std::size_t type_count = END + 1;
+
+	static constexpr std::string_view spelling(Type type) {
+		constexpr std::string_view spellings[] = {
+			"integer literal", "floating-point literal", "character literal", "boolean literal", "string literal", "pointer literal",
+			"identifier", "type",
+			"if", "elif", "else", "while", "for", "repeat", "return", "break", "continue",
+			"+", "-", "*", "/", "%", "**",
+			"<<", ">>",
+			"++", "--",
+			"&",
+			"&&", "||", "!",
+			"==", "!=", ">", "<", ">=", "<=",
+			"=", "+=", "-=", "*=", "/=", "%=", "**=",
+			",", ";", "(", ")", "{", "}", "[", "]",
+			"invalid token", "end of input"
+		};
+		static_assert(std::size(spellings) == type_count);
+		return spellings[type];
+	}
+
+	static constexpr Type compound_operator(Type type) {
+		switch (type) {
+			case PLUS_ASSIGNMENT: return PLUS;
+			case MINUS_ASSIGNMENT: return MINUS;
+			case MULTIPLY_ASSIGNMENT: return MULTIPLY;
+			case DIVIDE_ASSIGNMENT: return DIVIDE;
+			case MODULO_ASSIGNMENT: return MODULO;
+			case POWER_ASSIGNMENT: return POWER;
+			default: return INVALID;
+		}
+	}
+};
@@ -1,111 +1,72 @@
 #pragma once
 
-#include <iostream>
-#include <vector>
-#include <memory>
-
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "arena.hpp"
+#include "value.hpp"
+
+// A type is created once per TypeContext and never changes, so two types are
+// the same exactly when their pointers are. Passes switch on kind instead of
+// casting between subclasses.
 struct Type {
-	bool isConst;
-
-	Type(bool isConst) : isConst(isConst) {}
-	virtual ~Type() = default;
-
-	virtual void print() const = 0;
-	virtual std::shared_ptr<Type> getBaseType() const = 0;
-};
-
-struct NonRefType : public Type {
-	NonRefType(bool isConst) : Type(isConst) {}
-	virtual ~NonRefType() = default;
-
-	virtual void print() const override = 0;
-	virtual std::shared_ptr<Type> getBaseType() const override = 0;
-};
-
-struct FunctionType : public NonRefType {
-
-	std::shared_ptr<Type> returnType;
-	std::vector<std::shared_ptr<Type>> parameterTypes;
-
-	FunctionType(const std::shared_ptr<Type>& returnType, const std::vector<std::shared_ptr<Type>>& parameterTypes)
-		: NonRefType(false), returnType(returnType), parameterTypes(parameterTypes) {}
-
-	void print() const override {}
-
-	std::shared_ptr<Type> getBaseType() const override {
-		return nullptr;
-	}
-};
-
-struct BasicType : public NonRefType {
-	std::string name;
-
-	BasicType(const std::string& name, bool isConst = false) : name(name), NonRefType(isConst) {}
-
-	void print() const override {
-		std::cout << name << " ";
-	}
-
-	std::shared_ptr<Type> getBaseType() const override {
-		return nullptr;
-	}
-};
-
-struct IntType : public BasicType {
-	IntType(bool isConst = false) : BasicType("", isConst) {}
-	void print() const override {
-		std::cout << "int ";
-	}
-	std::shared_ptr<Type> getBaseType() const override {
-		return nullptr;
-	}
-
-	bool isCompatible(const std::shared_ptr<Type>& other_type) {
-		if (std::dynamic_pointer_cast<IntType>(other_type)
-		|| std::dynamic_pointer_cast<FloatType>(other_type))
-	}
-};
-
-struct NonBasicType : public NonRefType {
-	std::string name;
-
-	NonBasicType(const std::string& name, bool isConst = false) : name(name), NonRefType(isConst) {}
-
-	void print() const override {
-		std::cout << name << " ";
-	}
-
-	std::shared_ptr<Type> getBaseType() const override {
-		return nullptr;
-	}
+	enum Kind : std::uint8_t {
+		VOID, INT, DOUBLE, CHAR, BOOL, STRING,
+		POINTER, REFERENCE, FUNCTION, ARRAY
+	};
+
+	Kind kind;
+	bool is_const;
+	ValueType value_type;
+	const Type* base;
+	std::span<const Type* const> parameters;
+
+	bool is_basic() const { return kind <= STRING; }
+	bool is_arithmetic() const { return kind >= INT && kind <= BOOL; }
 };
 
-struct PtrType : public NonRefType {
-	std::shared_ptr<NonRefType> baseType;
-
-	PtrType(const std::shared_ptr<NonRefType>& baseType, bool isConst = false) : baseType(baseType), NonRefType(isConst) {}
-
-	void print() const override {
-		baseType->print();
-		std::cout << "* ";
-	}
-
-	std::shared_ptr<Type> getBaseType() const override {
-		return baseType;
-	}
+std::string to_string(const Type*);
+bool convertible(const Type*, const Type*);
+
+// Hash-conses every type of a translation unit. Basic types are looked up by
+// index; derived types go through a table keyed on their components, which
+// are themselves interned and therefore compared by address.
+class TypeContext {
+public:
+	TypeContext();
+	TypeContext(const TypeContext&) = delete;
+	TypeContext& operator=(const TypeContext&) = delete;
+
+	const Type* basic(Type::Kind, bool = false);
+	const Type* named(std::string_view, bool = false);
+	const Type* pointer(const Type*, bool = false);
+	const Type* reference(const Type*);
+	const Type* function(const Type*, std::span<const Type* const>);
+	// Of int, double, char or bool elements
+	const Type* array(const Type*);
+
+	std::size_t size() const;
+private:
+	struct Key {
+		Type::Kind kind;
+		bool is_const;
+		const Type* base;
+		std::span<const Type* const> parameters;
+
+		bool operator==(const Key&) const;
+	};
+
+	struct KeyHash {
+		std::size_t operator()(const Key&) const;
+	};
+
+	const Type* intern(const Key&);
+
+	Arena arena;
+	const Type* basics[Type::STRING + 1][2];
+	std::unordered_map<Key, const Type*, KeyHash> derived;
 };
-
-struct RefType : public Type {
-	std::shared_ptr<NonRefType> baseType;
-
-	RefType(const std::shared_ptr<NonRefType>& baseType, bool isConst = false) : baseType(baseType), Type(isConst) {}
-
-	void print() const override {
-		baseType->print();
-		std::cout << "& ";
-	}
-
-	std::shared_ptr<Type> getBaseType() const override {
-		return baseType;
-	}
-};
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "token.hpp"
+
+// Every type from STRING on is a reference to heap storage. The array types
+// follow the element types in the same order.
+enum class ValueType : std::uint8_t {
+	NONE, INT, DOUBLE, CHAR, BOOL, STRING,
+	INT_ARRAY, DOUBLE_ARRAY, CHAR_ARRAY, BOOL_ARRAY
+};
+
+constexpr bool is_array(ValueType type) { return type >= ValueType::INT_ARRAY; }
+constexpr ValueType array_of(ValueType element) {
+	return static_cast<ValueType>(static_cast<int>(element) - static_cast<int>(ValueType::INT) + static_cast<int>(ValueType::INT_ARRAY));
+}
+constexpr ValueType element_of(ValueType array) {
+	return static_cast<ValueType>(static_cast<int>(array) - static_cast<int>(ValueType::INT_ARRAY) + static_cast<int>(ValueType::INT));
+}
+
+class Array;
+
+// Header of an Array's storage, see array.hpp. Arrays are never Program
+// constants, so they stay on the thread that made them; its Heap frees them
+// and keeps the collector's state here.
+struct ArrayHeader {
+	bool marked = false;
+	bool old = false;
+};
+
+// Runtime value shared by every execution engine: a type tag next to an
+// eight-byte payload. Scalars are stored inline, so copying or computing
+// with them never allocates. Strings of up to inline_capacity characters
+// are stored inline as well, in the bytes after the tag. Longer ones are
+// reference-counted heap buffers shared by every copy and copied on the
+// first append to a shared one; the count is atomic because the constants
+// of a shared Program are copied by engines on several threads. Arrays are
+// mutable and shared by every copy of the value, which does not count them:
+// they belong to the Heap of the engine that made them, see heap.hpp.
+class Value {
+public:
+	Value() = default;
+	Value(int number) : tag(ValueType::INT) { payload.integer = number; }
+	Value(double number) : tag(ValueType::DOUBLE) { payload.number = number; }
+	Value(char character) : tag(ValueType::CHAR) { payload.character = character; }
+	Value(bool boolean) : tag(ValueType::BOOL) { payload.boolean = boolean; }
+	Value(std::string_view);
+	Value(const std::string& text) : Value(std::string_view(text)) {}
+	Value(const char* text) : Value(std::string_view(text)) {}
+	// Refers to an array the current Heap has adopted
+	explicit Value(Array*);
+
+	Value(const Value& other) : tag(other.tag), inline_size(other.inline_size), text(other.text), payload(other.payload) {
+		if (inline_size == counted) {
+			payload.string->references.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	Value(Value&& other) noexcept : tag(other.tag), inline_size(other.inline_size), text(other.text), payload(other.payload) {
+		other.tag = ValueType::NONE;
+		other.inline_size = 0;
+	}
+
+	Value& operator=(const Value& other) {
+		Value copy(other);
+		swap(copy);
+		return *this;
+	}
+
+	Value& operator=(Value&& other) noexcept {
+		Value moved(std::move(other));
+		swap(moved);
+		return *this;
+	}
+
+	~Value() {
+		if (inline_size == counted) {
+			release();
+		}
+	}
+
+	ValueType type() const { return tag; }
+
+	// The accessors expect a value of their type; nothing is converted.
+	int as_int() const { return payload.integer; }
+	double as_double() const { return payload.number; }
+	char as_char() const { return payload.character; }
+	bool as_bool() const { return payload.boolean; }
+	std::string_view as_string() const {
+		if (inline_size == counted) {
+			return {payload.string->data(), payload.string->size};
+		}
+		return {inline_data(), inline_size};
+	}
+	// Defined in array.hpp
+	Array& as_array() const;
+
+	// The stored int, for updating it in place, or nullptr for other types.
+	int* int_if() { return tag == ValueType::INT ? &payload.integer : nullptr; }
+	const int* int_if() const { return tag == ValueType::INT ? &payload.integer : nullptr; }
+
+	// Adds the text to the end of a string. The buffer is reused while this is
+	// its only reference and grows to at least twice its size when it is
+	// full, so building a string by repeated appends takes linear time.
+	void append(std::string_view);
+
+	static constexpr std::size_t inline_capacity = 14;
+
+private:
+	// Native code reads and writes the tag and payload in place
+	friend class Jit;
+	// The collector marks arrays through the payload
+	friend class Heap;
+
+	// Header of a single allocation that room for capacity characters follows
+	struct String {
+		std::atomic<std::uint32_t> references;
+		std::size_t size;
+		std::size_t capacity;
+
+		char* data() { return reinterpret_cast<char*>(this + 1); }
+	};
+
+	// inline_size of a string whose payload is counted heap storage
+	static constexpr std::uint8_t counted = 0xFF;
+
+	// An inline string runs from text on into the payload
+	char* inline_data() { return reinterpret_cast<char*>(this) + offsetof(Value, text); }
+	const char* inline_data() const { return reinterpret_cast<const char*>(this) + offsetof(Value, text); }
+	void allocate(std::size_t capacity, std::string_view, std::string_view);
+
+	void swap(Value& other) noexcept {
+		std::swap(tag, other.tag);
+		std::swap(inline_size, other.inline_size);
+		std::swap(text, other.text);
+		std::swap(payload, other.payload);
+	}
+
+	void release();
+
+	ValueType tag = ValueType::NONE;
+	// The length of an inline string, or counted
+	std::uint8_t inline_size = 0;
+	std::array<char, 6> text{};
+	union Payload {
+		int integer;
+		double number;
+		char character;
+		bool boolean;
+		String* string;
+		ArrayHeader* array;
+	} payload{};
+};
+
+static_assert(sizeof(Value) == 16);
+
+ValueType type_of(const Value&);
+ValueType type_from_name(std::string_view);
+std::string_view type_name(ValueType);
+
+Value default_value(ValueType);
+Value convert(const Value&, ValueType);
+bool truthy(const Value&);
+std::string to_string(const Value&);
+// Writes the same text as to_string without building a string.
+std::ostream& operator<<(std::ostream&, const Value&);
+
+Value add(const Value&, const Value&);
+// lhs + rhs, stored in lhs. A string lhs is appended to in place.
+void add_to(Value& lhs, const Value& rhs);
+Value subtract(const Value&, const Value&);
+Value multiply(const Value&, const Value&);
+Value divide(const Value&, const Value&);
+Value modulo(const Value&, const Value&);
+Value power(const Value&, const Value&);
+Value shift_left(const Value&, const Value&);
+Value shift_right(const Value&, const Value&);
+
+bool equal(const Value&, const Value&);
+bool less(const Value&, const Value&);
+
+Value negate(const Value&);
+Value unary_plus(const Value&);
+
+Value binary_operation(Token::Type, const Value&, const Value&);
+Value unary_operation(Token::Type, const Value&);
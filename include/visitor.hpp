@@ -13,6 +13,7 @@ public:
 public:
 	virtual void visit(Declaration::PtrDeclarator&) = 0;
 	virtual void visit(Declaration::NoPtrDeclarator&) = 0;
+	virtual void visit(Declaration::ArrayDeclarator&) = 0;
 	virtual void visit(Declaration::InitDeclarator&) = 0;
 	virtual void visit(VarDeclaration&) = 0;
 	virtual void visit(ParameterDeclaration&) = 0;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "heap.hpp"
+#include "stop.hpp"
+#include "profiler.hpp"
+#include "jit.hpp"
+
+struct Builtin;
+
+// GCC and Clang get direct-threaded dispatch: every instruction is translated
+// once into the address of its handler and handlers jump straight to the
+// next one. Other compilers, or -DVM_NO_THREADING, use a switch loop.
+#if defined(__GNUC__) && !defined(VM_NO_THREADING)
+#define VM_THREADED 1
+#else
+#define VM_THREADED 0
+#endif
+
+class VirtualMachine {
+public:
+	// With a profiler the VM runs a copy of its dispatch loop that offers a
+	// sample before every instruction.
+	// Calls nested deeper than the limit fail; frames live on the heap, so
+	// there is no other bound on recursion.
+	// Unless the native tier is turned off, a function is compiled once it
+	// has been called hot_calls times or its loops have run hot_iterations
+	// times; a profiled VM always interprets.
+	// Arrays live on a Heap with a nursery of the given bytes, collected
+	// right after an instruction makes an array, when the stack and the
+	// globals hold every value still in use.
+	// A stop request is checked at every LOOP and call.
+	VirtualMachine(const Program&, std::ostream&, Profiler* = nullptr, std::size_t = SIZE_MAX, bool = true, std::size_t = Heap::default_nursery_size,
+		const StopRequest* = nullptr);
+
+	static constexpr std::uint32_t hot_calls = 100;
+	static constexpr std::uint32_t hot_iterations = 1000;
+
+	int run();
+
+	// Per function: calls, loop iterations, native runs and code size, or
+	// why it was not compiled.
+	void write_jit_report(std::ostream&) const;
+
+	// Calls answered by a site's inline cache, and those that filled it
+	std::size_t call_cache_hits() const { return cache_hits; }
+	std::size_t call_cache_misses() const { return cache_misses; }
+
+	const Heap::Stats& heap_stats() const { return heap.stats(); }
+
+private:
+#if VM_THREADED
+	struct Code {
+		const void* handler;
+		std::int32_t operand;
+	};
+#else
+	using Code = Instruction;
+#endif
+
+	// A frame's locals are the slots of the value stack from base on, with
+	// the arguments in the first ones; its operands are pushed above them.
+	struct Frame {
+		const Function* function;
+		const Code* code;
+		const Code* pc;
+		std::size_t base;
+	};
+
+	// What a call site resolved to on its first call: a defined function and
+	// its code, or a builtin. A Program's bindings never change, so an entry
+	// stays valid for the whole run.
+	struct CallCache {
+		const Function* function = nullptr;
+		const Code* code = nullptr;
+		const Builtin* builtin = nullptr;
+	};
+
+	struct Tier {
+		std::uint32_t calls = 0;
+		std::uint32_t iterations = 0;
+		std::size_t native_calls = 0;
+		std::size_t loop_entries = 0;
+		const Jit::Code* code = nullptr;
+		std::string rejection;
+	};
+
+	static constexpr std::size_t dynamic_arity = -1;
+
+	template<bool>
+	Value execute(std::size_t);
+	template<std::size_t>
+	void call(std::int32_t);
+	void tail_call(std::int32_t);
+	const CallCache& resolve(std::int32_t);
+	void bind(const Function&, std::size_t, std::size_t);
+	const Jit::Code* native(std::size_t, bool);
+	Value run_native(const Jit::Code&, std::size_t, std::uint32_t);
+	void sample(const Code*);
+	const Code* code_of(const Function&) const;
+	void collect();
+	void check_stop() const {
+		if (stop) {
+			if (auto reason = stop->load(std::memory_order_relaxed)) {
+				stopped(reason);
+			}
+		}
+	}
+	[[noreturn]] static void stopped(const char*);
+
+	const Program& program;
+	// Destroyed after everything that refers to its arrays
+	Heap heap;
+	std::ostream& output;
+	std::unordered_map<std::string, const Function*> functions;
+	std::vector<std::vector<Code>> threaded_code;
+	std::vector<CallCache> call_caches;
+	std::size_t cache_hits = 0;
+	std::size_t cache_misses = 0;
+	std::vector<Value> globals;
+	std::vector<Value> stack;
+	std::vector<Frame> frames;
+	Profiler* profiler;
+	std::vector<std::uint32_t> profile_ids;
+	std::size_t recursion_limit;
+	const StopRequest* stop;
+	// Null when the native tier is off
+	std::unique_ptr<Jit> jit;
+	std::vector<Tier> tiers;
+};
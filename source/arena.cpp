@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "arena.hpp"
+
+Arena::Arena(
+	std::size_t block_size
+	) : block_size(block_size) {}
+
+Arena::~Arena() {
+	for (auto* finalizer = finalizers; finalizer; finalizer = finalizer->next) {
+		finalizer->destroy(finalizer->object);
+	}
+	while (blocks) {
+		auto* next = blocks->next;
+		std::free(blocks);
+		blocks = next;
+	}
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+	auto address = reinterpret_cast<std::uintptr_t>(cursor);
+	auto aligned = (address + alignment - 1) & ~(alignment - 1);
+	if (!cursor || aligned + size > reinterpret_cast<std::uintptr_t>(limit)) {
+		add_block(size + alignment);
+		address = reinterpret_cast<std::uintptr_t>(cursor);
+		aligned = (address + alignment - 1) & ~(alignment - 1);
+	}
+	cursor = reinterpret_cast<char*>(aligned + size);
+	statistics.bytes_used += size;
+	return reinterpret_cast<void*>(aligned);
+}
+
+std::string_view Arena::copy(std::string_view text) {
+	if (text.empty()) {
+		return {};
+	}
+	auto* data = static_cast<char*>(allocate(text.size(), 1));
+	std::memcpy(data, text.data(), text.size());
+	++statistics.strings;
+	return {data, text.size()};
+}
+
+void Arena::adopt(Arena& other) {
+	if (!other.blocks) {
+		return;
+	}
+	if (!blocks) {
+		blocks = other.blocks;
+		cursor = other.cursor;
+		limit = other.limit;
+	} else {
+		auto* tail = blocks;
+		while (tail->next) {
+			tail = tail->next;
+		}
+		tail->next = other.blocks;
+	}
+	if (other.finalizers) {
+		auto* tail = other.finalizers;
+		while (tail->next) {
+			tail = tail->next;
+		}
+		tail->next = finalizers;
+		finalizers = other.finalizers;
+	}
+	statistics.objects += other.statistics.objects;
+	statistics.arrays += other.statistics.arrays;
+	statistics.strings += other.statistics.strings;
+	statistics.blocks += other.statistics.blocks;
+	statistics.bytes_used += other.statistics.bytes_used;
+	statistics.bytes_reserved += other.statistics.bytes_reserved;
+
+	other.blocks = nullptr;
+	other.cursor = other.limit = nullptr;
+	other.finalizers = nullptr;
+	other.statistics = Statistics();
+}
+
+const Arena::Statistics& Arena::stats() const {
+	return statistics;
+}
+
+void Arena::add_block(std::size_t min_size) {
+	auto size = std::max(block_size, min_size + sizeof(Block));
+	auto* block = static_cast<Block*>(std::malloc(size));
+	if (!block) {
+		throw std::bad_alloc();
+	}
+	block->next = blocks;
+	block->size = size;
+	blocks = block;
+	cursor = reinterpret_cast<char*>(block + 1);
+	limit = reinterpret_cast<char*>(block) + size;
+	++statistics.blocks;
+	statistics.bytes_reserved += size;
+}
+
+void Arena::add_finalizer(void* object, void (*destroy)(void*)) {
+	finalizers = new (allocate(sizeof(Finalizer), alignof(Finalizer))) Finalizer{destroy, object, finalizers};
+}
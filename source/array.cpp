@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <iterator>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "array.hpp"
+#include "heap.hpp"
+
+// GCC and Clang vectors as wide as the target's registers: 32 bytes with
+// AVX2, 16 with SSE2 or NEON. Wider ones would live in memory.
+#if !defined(ARRAY_NO_SIMD) && defined(__GNUC__)
+#define ARRAY_VECTORS 1
+#ifdef __AVX2__
+#define ARRAY_VECTOR_BYTES 32
+#else
+#define ARRAY_VECTOR_BYTES 16
+#endif
+typedef std::uint32_t Words __attribute__((vector_size(ARRAY_VECTOR_BYTES)));
+typedef std::int32_t Ints __attribute__((vector_size(ARRAY_VECTOR_BYTES)));
+typedef double Doubles __attribute__((vector_size(ARRAY_VECTOR_BYTES)));
+static constexpr std::size_t int_lanes = ARRAY_VECTOR_BYTES / sizeof(int);
+static constexpr std::size_t doubles_per_vector = ARRAY_VECTOR_BYTES / sizeof(double);
+#else
+#define ARRAY_VECTORS 0
+#endif
+
+// double reductions run in eight lanes whatever the vector width, lane k
+// taking the elements at 8n + k, so they round the same way in every build.
+static constexpr std::size_t double_lanes = 8;
+static constexpr std::align_val_t alignment{32};
+
+static std::uint32_t sum_ints(const int* data, std::size_t size) {
+	std::size_t i = 0;
+	std::uint32_t total = 0;
+#if ARRAY_VECTORS
+	Words lanes{};
+	for (; i + int_lanes <= size; i += int_lanes) {
+		Words block;
+		std::memcpy(&block, data + i, sizeof(block));
+		lanes += block;
+	}
+	for (std::size_t lane = 0; lane < int_lanes; ++lane) {
+		total += lanes[lane];
+	}
+#endif
+	for (; i < size; ++i) {
+		total += static_cast<std::uint32_t>(data[i]);
+	}
+	return total;
+}
+
+static std::uint32_t dot_ints(const int* lhs, const int* rhs, std::size_t size) {
+	std::size_t i = 0;
+	std::uint32_t total = 0;
+#if ARRAY_VECTORS
+	Words lanes{};
+	for (; i + int_lanes <= size; i += int_lanes) {
+		Words a, b;
+		std::memcpy(&a, lhs + i, sizeof(a));
+		std::memcpy(&b, rhs + i, sizeof(b));
+		lanes += a * b;
+	}
+	for (std::size_t lane = 0; lane < int_lanes; ++lane) {
+		total += lanes[lane];
+	}
+#endif
+	for (; i < size; ++i) {
+		total += static_cast<std::uint32_t>(lhs[i]) * static_cast<std::uint32_t>(rhs[i]);
+	}
+	return total;
+}
+
+// The lanes are added pairwise, then the elements past the last whole block
+// in order.
+static double combine(const double* lanes, const double* rest, const double* end) {
+	double total = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+	for (; rest != end; ++rest) {
+		total += *rest;
+	}
+	return total;
+}
+
+static double sum_doubles(const double* data, std::size_t size) {
+	std::size_t i = 0;
+	double lanes[double_lanes] = {};
+#if ARRAY_VECTORS
+	Doubles vectors[double_lanes / doubles_per_vector] = {};
+	for (; i + double_lanes <= size; i += double_lanes) {
+		for (std::size_t v = 0; v < std::size(vectors); ++v) {
+			Doubles block;
+			std::memcpy(&block, data + i + v * doubles_per_vector, sizeof(block));
+			vectors[v] += block;
+		}
+	}
+	std::memcpy(lanes, vectors, sizeof(lanes));
+#else
+	for (; i + double_lanes <= size; i += double_lanes) {
+		for (std::size_t lane = 0; lane < double_lanes; ++lane) {
+			lanes[lane] += data[i + lane];
+		}
+	}
+#endif
+	return combine(lanes, data + i, data + size);
+}
+
+static double dot_doubles(const double* lhs, const double* rhs, std::size_t size) {
+	std::size_t i = 0;
+	double lanes[double_lanes] = {};
+#if ARRAY_VECTORS
+	Doubles vectors[double_lanes / doubles_per_vector] = {};
+	for (; i + double_lanes <= size; i += double_lanes) {
+		for (std::size_t v = 0; v < std::size(vectors); ++v) {
+			Doubles a, b;
+			std::memcpy(&a, lhs + i + v * doubles_per_vector, sizeof(a));
+			std::memcpy(&b, rhs + i + v * doubles_per_vector, sizeof(b));
+			vectors[v] += a * b;
+		}
+	}
+	std::memcpy(lanes, vectors, sizeof(lanes));
+#else
+	for (; i + double_lanes <= size; i += double_lanes) {
+		for (std::size_t lane = 0; lane < double_lanes; ++lane) {
+			lanes[lane] += lhs[i + lane] * rhs[i + lane];
+		}
+	}
+#endif
+	double products[double_lanes];
+	std::size_t rest = size - i;
+	for (std::size_t k = 0; k < rest; ++k) {
+		products[k] = lhs[i + k] * rhs[i + k];
+	}
+	return combine(lanes, products, products + rest);
+}
+
+template<bool maximum>
+static int extreme_ints(const int* data, std::size_t size) {
+	int result = data[0];
+	std::size_t i = 1;
+#if ARRAY_VECTORS
+	if (size >= int_lanes) {
+		Ints lanes;
+		std::memcpy(&lanes, data, sizeof(lanes));
+		for (i = int_lanes; i + int_lanes <= size; i += int_lanes) {
+			Ints block;
+			std::memcpy(&block, data + i, sizeof(block));
+			lanes = maximum ? (block > lanes ? block : lanes) : (block < lanes ? block : lanes);
+		}
+		for (std::size_t lane = 0; lane < int_lanes; ++lane) {
+			result = maximum ? std::max(result, lanes[lane]) : std::min(result, lanes[lane]);
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		result = maximum ? std::max(result, data[i]) : std::min(result, data[i]);
+	}
+	return result;
+}
+
+// A NaN is replaced by the first number that meets it, so it only survives
+// when there is nothing else.
+template<bool maximum>
+static bool better(double candidate, double current) {
+	return current != current || (maximum ? candidate > current : candidate < current);
+}
+
+template<bool maximum>
+static double extreme_doubles(const double* data, std::size_t size) {
+	double result = data[0];
+	std::size_t i = 1;
+#if ARRAY_VECTORS
+	if (size >= double_lanes) {
+		Doubles vectors[double_lanes / doubles_per_vector];
+		std::memcpy(vectors, data, sizeof(vectors));
+		for (i = double_lanes; i + double_lanes <= size; i += double_lanes) {
+			for (std::size_t v = 0; v < std::size(vectors); ++v) {
+				Doubles block;
+				std::memcpy(&block, data + i + v * doubles_per_vector, sizeof(block));
+				auto take = (vectors[v] != vectors[v]) | (maximum ? block > vectors[v] : block < vectors[v]);
+				vectors[v] = take ? block : vectors[v];
+			}
+		}
+		double lanes[double_lanes];
+		std::memcpy(lanes, vectors, sizeof(lanes));
+		result = lanes[0];
+		for (std::size_t lane = 1; lane < double_lanes; ++lane) {
+			if (better<maximum>(lanes[lane], result)) {
+				result = lanes[lane];
+			}
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if (better<maximum>(data[i], result)) {
+			result = data[i];
+		}
+	}
+	return result;
+}
+
+template<bool maximum, typename T>
+static T extreme(const T* data, std::size_t size) {
+	T result = data[0];
+	for (std::size_t i = 1; i < size; ++i) {
+		result = maximum ? std::max(result, data[i]) : std::min(result, data[i]);
+	}
+	return result;
+}
+
+template<typename T, typename U>
+static std::uint32_t integer_dot(const T* lhs, const U* rhs, std::size_t size) {
+	std::uint32_t total = 0;
+	for (std::size_t i = 0; i < size; ++i) {
+		total += static_cast<std::uint32_t>(lhs[i]) * static_cast<std::uint32_t>(rhs[i]);
+	}
+	return total;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Value::Value(Array* array) : tag(array_of(array->element_type())) {
+	payload.array = array;
+}
+
+Value Array::make(ValueType element, std::size_t size, bool fixed) {
+	auto& heap = Heap::current();
+	std::unique_ptr<Array> array(new Array(element, fixed));
+	heap.adopt(array.get());
+	Value value(array.release());
+	value.as_array().resize_unchecked(size);
+	return value;
+}
+
+Array::Array(ValueType element, bool fixed) : element(element), is_fixed(fixed) {}
+
+Array::~Array() {
+	if (data) {
+		::operator delete(data, alignment);
+	}
+}
+
+Value Array::get(std::size_t index) const {
+	switch (element) {
+		case ValueType::INT: return elements<int>()[index];
+		case ValueType::DOUBLE: return elements<double>()[index];
+		case ValueType::CHAR: return elements<char>()[index];
+		default: return elements<bool>()[index];
+	}
+}
+
+Value Array::set(std::size_t index, const Value& value) {
+	auto stored = type_of(value) == element ? value : convert(value, element);
+	switch (element) {
+		case ValueType::INT: elements<int>()[index] = stored.as_int(); break;
+		case ValueType::DOUBLE: elements<double>()[index] = stored.as_double(); break;
+		case ValueType::CHAR: elements<char>()[index] = stored.as_char(); break;
+		default: elements<bool>()[index] = stored.as_bool(); break;
+	}
+	return stored;
+}
+
+void Array::push(const Value& value) {
+	if (is_fixed) {
+		throw std::runtime_error("Cannot resize a fixed-size array");
+	}
+	auto stored = convert(value, element);
+	if (count == capacity) {
+		reserve(std::max<std::size_t>(capacity * 2, 8));
+	}
+	++count;
+	set(count - 1, stored);
+}
+
+void Array::resize(std::size_t size) {
+	if (is_fixed) {
+		throw std::runtime_error("Cannot resize a fixed-size array");
+	}
+	resize_unchecked(size);
+}
+
+void Array::fill(const Value& value) {
+	auto stored = convert(value, element);
+	switch (element) {
+		case ValueType::INT: std::fill_n(elements<int>(), count, stored.as_int()); break;
+		case ValueType::DOUBLE: std::fill_n(elements<double>(), count, stored.as_double()); break;
+		case ValueType::CHAR: std::fill_n(elements<char>(), count, stored.as_char()); break;
+		default: std::fill_n(elements<bool>(), count, stored.as_bool()); break;
+	}
+}
+
+void Array::copy_from(const Array& source) {
+	if (source.element != element) {
+		throw std::runtime_error("Cannot copy " + std::string(type_name(array_of(source.element))) + " into "
+			+ std::string(type_name(array_of(element))));
+	} else if (source.count > count) {
+		throw std::runtime_error("Cannot copy " + std::to_string(source.count) + " elements into an array of "
+			+ std::to_string(count));
+	}
+	if (source.count) {
+		std::memmove(data, source.data, source.count * element_size());
+	}
+}
+
+Value Array::sum() const {
+	switch (element) {
+		case ValueType::INT: return static_cast<int>(sum_ints(elements<int>(), count));
+		case ValueType::DOUBLE: return sum_doubles(elements<double>(), count);
+		case ValueType::CHAR: {
+			std::uint32_t total = 0;
+			for (std::size_t i = 0; i < count; ++i) {
+				total += static_cast<std::uint32_t>(elements<char>()[i]);
+			}
+			return static_cast<int>(total);
+		}
+		default:
+			return static_cast<int>(std::count(elements<bool>(), elements<bool>() + count, true));
+	}
+}
+
+Value Array::min() const {
+	if (!count) {
+		throw std::runtime_error("min of an empty array");
+	}
+	switch (element) {
+		case ValueType::INT: return extreme_ints<false>(elements<int>(), count);
+		case ValueType::DOUBLE: return extreme_doubles<false>(elements<double>(), count);
+		case ValueType::CHAR: return extreme<false>(elements<char>(), count);
+		default: return extreme<false>(elements<bool>(), count);
+	}
+}
+
+Value Array::max() const {
+	if (!count) {
+		throw std::runtime_error("max of an empty array");
+	}
+	switch (element) {
+		case ValueType::INT: return extreme_ints<true>(elements<int>(), count);
+		case ValueType::DOUBLE: return extreme_doubles<true>(elements<double>(), count);
+		case ValueType::CHAR: return extreme<true>(elements<char>(), count);
+		default: return extreme<true>(elements<bool>(), count);
+	}
+}
+
+Value Array::dot(const Array& other) const {
+	if (other.element != element) {
+		throw std::runtime_error("dot of " + std::string(type_name(array_of(element))) + " and "
+			+ std::string(type_name(array_of(other.element))));
+	} else if (other.count != count) {
+		throw std::runtime_error("dot of arrays of " + std::to_string(count) + " and " + std::to_string(other.count) + " elements");
+	}
+	switch (element) {
+		case ValueType::INT: return static_cast<int>(dot_ints(elements<int>(), other.elements<int>(), count));
+		case ValueType::DOUBLE: return dot_doubles(elements<double>(), other.elements<double>(), count);
+		case ValueType::CHAR: return static_cast<int>(integer_dot(elements<char>(), other.elements<char>(), count));
+		default: return static_cast<int>(integer_dot(elements<bool>(), other.elements<bool>(), count));
+	}
+}
+
+std::size_t Array::bytes() const {
+	return sizeof(Array) + capacity * element_size();
+}
+
+std::size_t Array::element_size() const {
+	switch (element) {
+		case ValueType::INT: return sizeof(int);
+		case ValueType::DOUBLE: return sizeof(double);
+		case ValueType::CHAR: return sizeof(char);
+		default: return sizeof(bool);
+	}
+}
+
+void Array::reserve(std::size_t size) {
+	if (size > INT_MAX) {
+		throw std::runtime_error("Array size " + std::to_string(size) + " is too large");
+	}
+	auto block = ::operator new(size * element_size(), alignment);
+	if (data) {
+		std::memcpy(block, data, count * element_size());
+		::operator delete(data, alignment);
+	}
+	data = block;
+	Heap::current().resized(*this, static_cast<std::ptrdiff_t>((size - capacity) * element_size()));
+	capacity = size;
+}
+
+// New elements start zeroed, which is every element type's default
+void Array::resize_unchecked(std::size_t size) {
+	if (size > capacity) {
+		reserve(std::max(size, count * 2));
+	}
+	if (size > count) {
+		std::memset(elements<char>() + count * element_size(), 0, (size - count) * element_size());
+	}
+	count = size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::size_t array_size(const Value& size) {
+	auto type = type_of(size);
+	if (type != ValueType::INT && type != ValueType::CHAR && type != ValueType::BOOL) {
+		throw std::runtime_error("Array size must be an integer, got " + std::string(type_name(type)));
+	}
+	auto number = convert(size, ValueType::INT).as_int();
+	if (number < 0) {
+		throw std::runtime_error("Array size " + std::to_string(number) + " is negative");
+	}
+	return static_cast<std::size_t>(number);
+}
+
+std::size_t checked_index(const Value& base, const Value& index) {
+	if (!is_array(type_of(base))) {
+		throw std::runtime_error("Subscripted value is not an array");
+	}
+	auto type = type_of(index);
+	if (type != ValueType::INT && type != ValueType::CHAR && type != ValueType::BOOL) {
+		throw std::runtime_error("Array index must be an integer, got " + std::string(type_name(type)));
+	}
+	auto number = convert(index, ValueType::INT).as_int();
+	auto size = base.as_array().size();
+	if (number < 0 || static_cast<std::size_t>(number) >= size) {
+		throw std::runtime_error("Index " + std::to_string(number) + " is out of range for an array of "
+			+ std::to_string(size) + " elements");
+	}
+	return static_cast<std::size_t>(number);
+}
@@ -1,9 +1,5 @@
 #include "visitor.hpp"
 
-TranslationUnit::TranslationUnit(
-	const DeclarationSeq& declarations
-	) : declarations(declarations) {}
-
 void TranslationUnit::accept(Visitor& visitor) {
 	visitor.visit(*this);
-}
\ No newline at end of file
+}
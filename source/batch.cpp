@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "batch.hpp"
+
+Batch::Batch(const Interpreter::Options& options, std::size_t jobs) : options(options), jobs(jobs ? jobs : std::max(1u, std::thread::hardware_concurrency())) {
+	// The pool already occupies the hardware threads
+	if (this->options.parse_threads == 0) {
+		this->options.parse_threads = 1;
+	}
+}
+
+int Batch::run(const std::vector<std::string>& paths, std::ostream& output, std::ostream& errors) {
+	struct Result {
+		std::ostringstream output;
+		std::ostringstream errors;
+		int status = 0;
+		bool done = false;
+	};
+
+	std::vector<Result> results(paths.size());
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::atomic<std::size_t> next = 0;
+	auto work = [&] {
+		for (auto index = next++; index < paths.size(); index = next++) {
+			auto& result = results[index];
+			try {
+				result.status = Interpreter(options, result.output, result.errors).interpret_file(paths[index]);
+			} catch (const std::exception& e) {
+				result.errors << "Error: " << e.what() << std::endl;
+				result.status = 1;
+			}
+			std::lock_guard lock(mutex);
+			result.done = true;
+			finished.notify_one();
+		}
+	};
+	std::vector<std::jthread> pool;
+	for (std::size_t i = 0; i < std::min(jobs, paths.size()); ++i) {
+		pool.emplace_back(work);
+	}
+
+	int status = 0;
+	for (auto& result : results) {
+		{
+			std::unique_lock lock(mutex);
+			finished.wait(lock, [&] { return result.done; });
+		}
+		output << result.output.view();
+		output.flush();
+		errors << result.errors.view();
+		// A capture that grew past the memory limit stopped taking writes
+		if (result.output.bad() || result.errors.bad()) {
+			errors << "Error: Output exceeded memory limit\n";
+			result.status = 1;
+		}
+		if (status == 0) {
+			status = result.status;
+		}
+		result.output.str({});
+		result.errors.str({});
+	}
+	return status;
+}
+
+std::vector<std::string> Batch::read_list(const std::string& path) {
+	std::ifstream file;
+	if (path != "-") {
+		file.open(path);
+		if (!file) {
+			throw std::runtime_error("Failed to open file list " + path);
+		}
+	}
+	std::istream& input = path == "-" ? std::cin : file;
+	std::vector<std::string> paths;
+	for (std::string line; std::getline(input, line);) {
+		if (!line.empty()) {
+			paths.push_back(std::move(line));
+		}
+	}
+	return paths;
+}
@@ -0,0 +1,103 @@
+#include <array>
+#include <stdexcept>
+#include <string>
+
+#include "builtins.hpp"
+#include "array.hpp"
+
+static void expect(std::span<const Value> arguments, std::size_t count, std::string_view name) {
+	if (arguments.size() != count) {
+		throw std::runtime_error(std::string(name) + " expects " + std::to_string(count) + (count == 1 ? " argument" : " arguments")
+			+ ", got " + std::to_string(arguments.size()));
+	}
+}
+
+static Array& array_argument(const Value& argument, std::string_view name) {
+	if (!is_array(type_of(argument))) {
+		throw std::runtime_error(std::string(name) + " expects an array, got " + std::string(type_name(type_of(argument))));
+	}
+	return argument.as_array();
+}
+
+static Value print(std::span<const Value> arguments, std::ostream& output) {
+	for (std::size_t i = 0; i < arguments.size(); ++i) {
+		if (i != 0) {
+			output << ' ';
+		}
+		output << arguments[i];
+	}
+	output << '\n';
+	return Value();
+}
+
+static Value len(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 1, "len");
+	return static_cast<int>(array_argument(arguments[0], "len").size());
+}
+
+static Value push(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 2, "push");
+	array_argument(arguments[0], "push").push(arguments[1]);
+	return Value();
+}
+
+static Value resize(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 2, "resize");
+	array_argument(arguments[0], "resize").resize(array_size(arguments[1]));
+	return Value();
+}
+
+static Value fill(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 2, "fill");
+	array_argument(arguments[0], "fill").fill(arguments[1]);
+	return Value();
+}
+
+// copy(destination, source)
+static Value copy(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 2, "copy");
+	array_argument(arguments[0], "copy").copy_from(array_argument(arguments[1], "copy"));
+	return Value();
+}
+
+static Value sum(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 1, "sum");
+	return array_argument(arguments[0], "sum").sum();
+}
+
+static Value min(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 1, "min");
+	return array_argument(arguments[0], "min").min();
+}
+
+static Value max(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 1, "max");
+	return array_argument(arguments[0], "max").max();
+}
+
+static Value dot(std::span<const Value> arguments, std::ostream&) {
+	expect(arguments, 2, "dot");
+	return array_argument(arguments[0], "dot").dot(array_argument(arguments[1], "dot"));
+}
+
+static constexpr std::array builtins = {
+	Builtin{"print", print},
+	Builtin{"len", len},
+	Builtin{"push", push},
+	Builtin{"resize", resize},
+	Builtin{"fill", fill},
+	Builtin{"copy", copy},
+	Builtin{"sum", sum},
+	Builtin{"min", min},
+	Builtin{"max", max},
+	Builtin{"dot", dot}
+};
+
+const Builtin* find_builtin(std::string_view name) {
+	for (auto& builtin : builtins) {
+		if (builtin.name == name) {
+			return &builtin;
+		}
+	}
+	return nullptr;
+}
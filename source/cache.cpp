@@ -0,0 +1,542 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.hpp"
+#include "source.hpp"
+
+// Bump format_version whenever the file layout changes. The build version
+// also covers the opcode list and the executable's build id, so a rebuilt
+// interpreter, whose VM may read the same code differently, never runs
+// entries written by another build.
+static constexpr std::uint32_t format_version = 5;
+static constexpr char magic[8] = {'C', 'P', 'I', 'P', 'R', 'O', 'G', '\n'};
+
+// The linker's build id of the running executable, or the time this file
+// was compiled when it was linked without one. The executable is the first
+// object dl_iterate_phdr reports.
+static std::uint64_t executable_id() {
+	std::string id;
+	::dl_iterate_phdr([](dl_phdr_info* info, std::size_t, void* data) {
+		for (int i = 0; i < info->dlpi_phnum; ++i) {
+			auto& segment = info->dlpi_phdr[i];
+			if (segment.p_type != PT_NOTE) {
+				continue;
+			}
+			auto note = reinterpret_cast<const char*>(info->dlpi_addr + segment.p_vaddr);
+			auto end = note + segment.p_memsz;
+			while (note + sizeof(ElfW(Nhdr)) <= end) {
+				auto header = reinterpret_cast<const ElfW(Nhdr)*>(note);
+				auto name = note + sizeof(ElfW(Nhdr));
+				auto description = name + ((header->n_namesz + 3) & ~3u);
+				if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && std::memcmp(name, "GNU", 4) == 0) {
+					static_cast<std::string*>(data)->assign(description, header->n_descsz);
+					return 1;
+				}
+				note = description + ((header->n_descsz + 3) & ~3u);
+			}
+		}
+		return 1;
+	}, &id);
+	return ProgramCache::hash(id.empty() ? std::string_view(__DATE__ " " __TIME__) : std::string_view(id));
+}
+
+#define OPCODE_NAME(name) #name " "
+static const std::uint64_t build_version = ProgramCache::hash(OPCODES(OPCODE_NAME)) ^ (executable_id() * 0x9e3779b97f4a7c15ull) ^ format_version;
+#undef OPCODE_NAME
+
+#define OPCODE_ONE(name) + 1
+static constexpr std::size_t opcode_count = 0 OPCODES(OPCODE_ONE);
+#undef OPCODE_ONE
+
+static std::atomic<unsigned> store_count = 0;
+
+namespace {
+
+struct Writer {
+	std::string bytes;
+
+	template<typename T>
+	void put(T value) {
+		bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void put_string(std::string_view text) {
+		put(static_cast<std::uint32_t>(text.size()));
+		bytes.append(text);
+	}
+};
+
+struct Reader {
+	std::string_view bytes;
+
+	template<typename T>
+	T get() {
+		T value;
+		std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+		return value;
+	}
+
+	std::string get_string() {
+		return std::string(take(get<std::uint32_t>()));
+	}
+
+	// Bytes a bool, a ValueType or an OpCode cannot hold are rejected
+	// rather than reinterpreted.
+	bool get_flag() {
+		return checked(get<std::uint8_t>(), 1);
+	}
+
+	ValueType get_type() {
+		return static_cast<ValueType>(checked(get<std::uint8_t>(), static_cast<std::uint8_t>(ValueType::BOOL_ARRAY)));
+	}
+
+	OpCode get_opcode() {
+		return static_cast<OpCode>(checked(get<std::uint8_t>(), opcode_count - 1));
+	}
+
+	static std::uint8_t checked(std::uint8_t byte, std::uint8_t maximum) {
+		if (byte > maximum) {
+			throw std::runtime_error("Invalid cache entry");
+		}
+		return byte;
+	}
+
+	std::string_view take(std::size_t size) {
+		if (size > bytes.size()) {
+			throw std::runtime_error("Truncated cache entry");
+		}
+		auto taken = bytes.substr(0, size);
+		bytes.remove_prefix(size);
+		return taken;
+	}
+};
+
+}
+
+// Values an instruction pops from the operand stack and pushes onto it.
+// Every opcode is listed, so a new one does not build until it is given
+// its effect here.
+static std::pair<std::size_t, std::size_t> stack_effect(const Program& program, const Instruction& instruction) {
+	switch (instruction.op) {
+		case OpCode::JUMP:
+		case OpCode::LOOP:
+		case OpCode::INCREMENT_LOCAL:
+		case OpCode::DECREMENT_LOCAL:
+			return {0, 0};
+		case OpCode::CONSTANT:
+		case OpCode::LOAD_LOCAL:
+		case OpCode::LOAD_GLOBAL:
+		case OpCode::NEW_ARRAY:
+			return {0, 1};
+		case OpCode::POP:
+		case OpCode::STORE_LOCAL:
+		case OpCode::STORE_GLOBAL:
+		case OpCode::JUMP_IF_FALSE:
+		case OpCode::APPEND_LOCAL:
+		case OpCode::RETURN:
+			return {1, 0};
+		case OpCode::NEGATE:
+		case OpCode::PLUS:
+		case OpCode::NOT:
+		case OpCode::CONVERT:
+		case OpCode::NEW_FIXED_ARRAY:
+			return {1, 1};
+		case OpCode::DUP:
+			return {1, 2};
+		case OpCode::ADD:
+		case OpCode::SUBTRACT:
+		case OpCode::MULTIPLY:
+		case OpCode::DIVIDE:
+		case OpCode::MODULO:
+		case OpCode::POWER:
+		case OpCode::SHIFT_LEFT:
+		case OpCode::SHIFT_RIGHT:
+		case OpCode::EQUAL:
+		case OpCode::NOT_EQUAL:
+		case OpCode::LESS:
+		case OpCode::LESS_EQUAL:
+		case OpCode::GREATER:
+		case OpCode::GREATER_EQUAL:
+		case OpCode::LOAD_ELEMENT:
+		case OpCode::INCREMENT_ELEMENT:
+			return {2, 1};
+		case OpCode::JUMP_UNLESS_EQUAL:
+		case OpCode::JUMP_UNLESS_NOT_EQUAL:
+		case OpCode::JUMP_UNLESS_LESS:
+		case OpCode::JUMP_UNLESS_LESS_EQUAL:
+		case OpCode::JUMP_UNLESS_GREATER:
+		case OpCode::JUMP_UNLESS_GREATER_EQUAL:
+			return {2, 0};
+		case OpCode::DUP2:
+			return {2, 4};
+		case OpCode::STORE_ELEMENT:
+			return {3, 1};
+		// A builtin reached by TAIL_CALL leaves its result for the code after it
+		case OpCode::CALL:
+		case OpCode::TAIL_CALL:
+		case OpCode::CALL_0:
+		case OpCode::CALL_1:
+		case OpCode::CALL_2:
+		case OpCode::CALL_3:
+			return {program.call_sites[instruction.operand].argument_count, 1};
+	}
+	return {0, 0};
+}
+
+// Whether every path through the code finds the operands each instruction
+// pops, reaching each instruction with the same number of values above the
+// frame's slots. The operands must be in range already.
+static bool balanced(const Program& program, const std::vector<Instruction>& code) {
+	constexpr auto unreached = SIZE_MAX;
+	std::vector<std::size_t> depths(code.size(), unreached);
+	std::vector<std::size_t> pending{0};
+	depths[0] = 0;
+	auto reach = [&](std::size_t target, std::size_t depth) {
+		if (depths[target] == unreached) {
+			depths[target] = depth;
+			pending.push_back(target);
+		}
+		return depths[target] == depth;
+	};
+	while (!pending.empty()) {
+		auto at = pending.back();
+		pending.pop_back();
+		auto& instruction = code[at];
+		auto [pops, pushes] = stack_effect(program, instruction);
+		if (depths[at] < pops) {
+			return false;
+		}
+		auto depth = depths[at] - pops + pushes;
+		auto target = static_cast<std::size_t>(instruction.operand);
+		switch (instruction.op) {
+			case OpCode::RETURN:
+				break;
+			case OpCode::JUMP:
+			case OpCode::LOOP:
+				if (!reach(target, depth)) {
+					return false;
+				}
+				break;
+			case OpCode::JUMP_IF_FALSE:
+			case OpCode::JUMP_UNLESS_EQUAL:
+			case OpCode::JUMP_UNLESS_NOT_EQUAL:
+			case OpCode::JUMP_UNLESS_LESS:
+			case OpCode::JUMP_UNLESS_LESS_EQUAL:
+			case OpCode::JUMP_UNLESS_GREATER:
+			case OpCode::JUMP_UNLESS_GREATER_EQUAL:
+				if (!reach(target, depth) || !reach(at + 1, depth)) {
+					return false;
+				}
+				break;
+			default:
+				// The last instruction is a RETURN, so this one has a successor
+				if (!reach(at + 1, depth)) {
+					return false;
+				}
+				break;
+		}
+	}
+	return true;
+}
+
+// Whether the VM can run every instruction without reading outside the
+// code, the constants, the frame, the globals, the call sites or the
+// operands pushed in the current frame. Operand types are left to the
+// instructions, which check them. The VM trusts the Programs it is given,
+// so an entry that fails is compiled again.
+static bool verify(const Program& program) {
+	if (program.initializer >= program.functions.size()) {
+		return false;
+	}
+	for (auto& function : program.functions) {
+		auto& code = function.code;
+		if (function.frame_size < function.parameter_types.size()
+			|| (code.empty() ? function.defined : code.back().op != OpCode::RETURN)) {
+			return false;
+		}
+		for (auto& instruction : code) {
+			auto below = [&](std::size_t limit) {
+				return instruction.operand >= 0 && static_cast<std::size_t>(instruction.operand) < limit;
+			};
+			auto calls = [&](std::uint32_t arity) {
+				return below(program.call_sites.size()) && program.call_sites[instruction.operand].argument_count == arity;
+			};
+			bool valid = true;
+			switch (instruction.op) {
+				case OpCode::CONSTANT:
+					valid = below(program.constants.size());
+					break;
+				case OpCode::LOAD_LOCAL:
+				case OpCode::STORE_LOCAL:
+				case OpCode::APPEND_LOCAL:
+				case OpCode::INCREMENT_LOCAL:
+				case OpCode::DECREMENT_LOCAL:
+					valid = below(function.frame_size);
+					break;
+				case OpCode::LOAD_GLOBAL:
+				case OpCode::STORE_GLOBAL:
+					valid = below(program.global_count);
+					break;
+				case OpCode::CONVERT:
+					valid = below(static_cast<std::size_t>(ValueType::BOOL_ARRAY) + 1);
+					break;
+				case OpCode::NEW_ARRAY:
+				case OpCode::NEW_FIXED_ARRAY:
+					valid = below(static_cast<std::size_t>(ValueType::BOOL_ARRAY) + 1) && is_array(static_cast<ValueType>(instruction.operand));
+					break;
+				case OpCode::JUMP:
+				case OpCode::JUMP_IF_FALSE:
+				case OpCode::LOOP:
+				case OpCode::JUMP_UNLESS_EQUAL:
+				case OpCode::JUMP_UNLESS_NOT_EQUAL:
+				case OpCode::JUMP_UNLESS_LESS:
+				case OpCode::JUMP_UNLESS_LESS_EQUAL:
+				case OpCode::JUMP_UNLESS_GREATER:
+				case OpCode::JUMP_UNLESS_GREATER_EQUAL:
+					valid = below(code.size());
+					break;
+				case OpCode::CALL:
+				case OpCode::TAIL_CALL:
+					valid = below(program.call_sites.size());
+					break;
+				case OpCode::CALL_0: valid = calls(0); break;
+				case OpCode::CALL_1: valid = calls(1); break;
+				case OpCode::CALL_2: valid = calls(2); break;
+				case OpCode::CALL_3: valid = calls(3); break;
+				default:
+					break;
+			}
+			if (!valid) {
+				return false;
+			}
+		}
+		if (!code.empty() && !balanced(program, code)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ProgramCache::ProgramCache(
+	const std::string& directory,
+	std::string_view source,
+	bool optimized
+	) : directory(directory), source_hash(hash(source)), source_size(source.size()), optimized(optimized) {
+	static const char digits[] = "0123456789abcdef";
+	std::string name;
+	auto key = source_hash ^ (build_version * 0x9e3779b97f4a7c15ull) ^ optimized;
+	for (int shift = 60; shift >= 0; shift -= 4) {
+		name += digits[(key >> shift) & 0xf];
+	}
+	path = directory + "/" + name + ".bc";
+}
+
+std::optional<Program> ProgramCache::load() const {
+	if (::access(path.c_str(), R_OK) != 0) {
+		return std::nullopt;
+	}
+	try {
+		SourceBuffer file(path);
+		Reader reader{file.view()};
+		if (reader.take(sizeof(magic)) != std::string_view(magic, sizeof(magic))
+			|| reader.get<std::uint64_t>() != build_version
+			|| reader.get<std::uint64_t>() != source_hash
+			|| reader.get<std::uint64_t>() != source_size
+			|| reader.get_flag() != optimized) {
+			return std::nullopt;
+		}
+		auto checksum = reader.get<std::uint64_t>();
+		if (checksum != hash(reader.bytes)) {
+			return std::nullopt;
+		}
+
+		Program program;
+		program.global_count = reader.get<std::uint64_t>();
+		program.initializer = reader.get<std::uint64_t>();
+		program.functions.resize(reader.get<std::uint32_t>());
+		for (auto& function : program.functions) {
+			function.name = reader.get_string();
+			function.return_type = reader.get_type();
+			function.parameter_types.resize(reader.get<std::uint32_t>());
+			for (auto& type : function.parameter_types) {
+				type = reader.get_type();
+			}
+			function.frame_size = reader.get<std::uint64_t>();
+			function.defined = reader.get_flag();
+			function.code.resize(reader.get<std::uint32_t>());
+			for (auto& instruction : function.code) {
+				instruction.op = reader.get_opcode();
+				instruction.operand = reader.get<std::int32_t>();
+			}
+			function.locations.resize(reader.get<std::uint32_t>());
+			for (auto& location : function.locations) {
+				location = reader.get<Location>();
+			}
+		}
+		program.constants.resize(reader.get<std::uint32_t>());
+		for (auto& constant : program.constants) {
+			switch (reader.get_type()) {
+				case ValueType::NONE: constant = Value(); break;
+				case ValueType::INT: constant = reader.get<int>(); break;
+				case ValueType::DOUBLE: constant = reader.get<double>(); break;
+				case ValueType::CHAR: constant = reader.get<char>(); break;
+				case ValueType::BOOL: constant = reader.get_flag(); break;
+				case ValueType::STRING: constant = Value(reader.take(reader.get<std::uint32_t>())); break;
+				default: return std::nullopt;
+			}
+		}
+		program.call_sites.resize(reader.get<std::uint32_t>());
+		for (auto& site : program.call_sites) {
+			site.name = reader.get_string();
+			site.argument_count = reader.get<std::uint32_t>();
+		}
+		if (!reader.bytes.empty() || !verify(program)) {
+			return std::nullopt;
+		}
+		return program;
+	} catch (const std::exception&) {
+		return std::nullopt;
+	}
+}
+
+void ProgramCache::store(const Program& program) const {
+	Writer writer;
+	writer.put<std::uint64_t>(program.global_count);
+	writer.put<std::uint64_t>(program.initializer);
+	writer.put<std::uint32_t>(program.functions.size());
+	for (auto& function : program.functions) {
+		writer.put_string(function.name);
+		writer.put(function.return_type);
+		writer.put<std::uint32_t>(function.parameter_types.size());
+		for (auto type : function.parameter_types) {
+			writer.put(type);
+		}
+		writer.put<std::uint64_t>(function.frame_size);
+		writer.put<bool>(function.defined);
+		writer.put<std::uint32_t>(function.code.size());
+		for (auto& instruction : function.code) {
+			writer.put(instruction.op);
+			writer.put(instruction.operand);
+		}
+		writer.put<std::uint32_t>(function.locations.size());
+		for (auto& location : function.locations) {
+			writer.put(location);
+		}
+	}
+	writer.put<std::uint32_t>(program.constants.size());
+	for (auto& constant : program.constants) {
+		writer.put(type_of(constant));
+		switch (type_of(constant)) {
+			case ValueType::INT: writer.put(constant.as_int()); break;
+			case ValueType::DOUBLE: writer.put(constant.as_double()); break;
+			case ValueType::CHAR: writer.put(constant.as_char()); break;
+			case ValueType::BOOL: writer.put(constant.as_bool()); break;
+			case ValueType::STRING: writer.put_string(constant.as_string()); break;
+			default: break;
+		}
+	}
+	writer.put<std::uint32_t>(program.call_sites.size());
+	for (auto& site : program.call_sites) {
+		writer.put_string(site.name);
+		writer.put(site.argument_count);
+	}
+
+	// The header ends with a hash of the body, so a file damaged after it
+	// was written reads as a miss
+	Writer header;
+	header.bytes.append(magic, sizeof(magic));
+	header.put<std::uint64_t>(build_version);
+	header.put<std::uint64_t>(source_hash);
+	header.put<std::uint64_t>(source_size);
+	header.put<bool>(optimized);
+	header.put<std::uint64_t>(hash(writer.bytes));
+	writer.bytes.insert(0, header.bytes);
+
+	// Written under a unique name and renamed into place, so concurrent runs
+	// of the same script, in other processes or batch workers, never see a
+	// partial entry.
+	::mkdir(directory.c_str(), 0777);
+	auto temporary = path + "." + std::to_string(::getpid()) + "." + std::to_string(store_count++) + ".tmp";
+	int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to write cache entry " + temporary + " (" + std::strerror(errno) + ")");
+	}
+	std::string_view remaining = writer.bytes;
+	while (!remaining.empty()) {
+		auto count = ::write(fd, remaining.data(), remaining.size());
+		if (count < 0 && errno == EINTR) {
+			continue;
+		} else if (count < 0) {
+			auto error = std::string(std::strerror(errno));
+			::close(fd);
+			::unlink(temporary.c_str());
+			throw std::runtime_error("Failed to write cache entry " + temporary + " (" + error + ")");
+		}
+		remaining.remove_prefix(count);
+	}
+	::close(fd);
+	if (::rename(temporary.c_str(), path.c_str()) != 0) {
+		::unlink(temporary.c_str());
+		throw std::runtime_error("Failed to write cache entry " + path + " (" + std::strerror(errno) + ")");
+	}
+}
+
+// 64-bit multiplicative hash over eight bytes at a time; the cache is local
+// to one machine, so only speed and spread matter, not portability.
+std::uint64_t ProgramCache::hash(std::string_view text) {
+	std::uint64_t hash = 0xcbf29ce484222325ull ^ text.size();
+	std::size_t offset = 0;
+	for (; offset + 8 <= text.size(); offset += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, text.data() + offset, 8);
+		hash = (hash ^ word) * 0x100000001b3ull;
+		hash ^= hash >> 29;
+	}
+	for (; offset < text.size(); ++offset) {
+		hash = (hash ^ static_cast<unsigned char>(text[offset])) * 0x100000001b3ull;
+	}
+	return hash ^ (hash >> 32);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryCache::MemoryCache(std::size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<const Program> MemoryCache::find(std::string_view source, bool optimized) const {
+	std::shared_lock lock(mutex);
+	auto [begin, end] = entries.equal_range(ProgramCache::hash(source));
+	for (auto entry = begin; entry != end; ++entry) {
+		if (entry->second.optimized == optimized && entry->second.source == source) {
+			return entry->second.program;
+		}
+	}
+	return nullptr;
+}
+
+std::shared_ptr<const Program> MemoryCache::insert(std::string_view source, bool optimized, Program&& program) {
+	auto shared = std::make_shared<const Program>(std::move(program));
+	auto key = ProgramCache::hash(source);
+	std::unique_lock lock(mutex);
+	auto [begin, end] = entries.equal_range(key);
+	for (auto entry = begin; entry != end; ++entry) {
+		if (entry->second.optimized == optimized && entry->second.source == source) {
+			return entry->second.program;
+		}
+	}
+	if (!entries.empty() && entries.size() >= capacity) {
+		entries.erase(entries.begin());
+	}
+	entries.emplace(key, Entry{std::string(source), optimized, shared});
+	return shared;
+}
@@ -0,0 +1,536 @@
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "compiler.hpp"
+
+static constexpr auto binary_opcodes = [] {
+	std::array<std::pair<bool, OpCode>, Token::type_count> table{};
+	table[Token::PLUS] = {true, OpCode::ADD};
+	table[Token::MINUS] = {true, OpCode::SUBTRACT};
+	table[Token::MULTIPLY] = {true, OpCode::MULTIPLY};
+	table[Token::DIVIDE] = {true, OpCode::DIVIDE};
+	table[Token::MODULO] = {true, OpCode::MODULO};
+	table[Token::POWER] = {true, OpCode::POWER};
+	table[Token::SHIFT_LEFT] = {true, OpCode::SHIFT_LEFT};
+	table[Token::SHIFT_RIGHT] = {true, OpCode::SHIFT_RIGHT};
+	table[Token::EQUAL] = {true, OpCode::EQUAL};
+	table[Token::NOT_EQUAL] = {true, OpCode::NOT_EQUAL};
+	table[Token::LESS] = {true, OpCode::LESS};
+	table[Token::LESS_EQUAL] = {true, OpCode::LESS_EQUAL};
+	table[Token::GREATER] = {true, OpCode::GREATER};
+	table[Token::GREATER_EQUAL] = {true, OpCode::GREATER_EQUAL};
+	return table;
+}();
+
+// Superinstructions the hot paths are folded into; see OPCODES.
+#ifdef VM_NO_FUSION
+static constexpr bool fusion = false;
+#else
+static constexpr bool fusion = true;
+#endif
+
+static constexpr auto jump_unless_opcodes = [] {
+	std::array<std::pair<bool, OpCode>, Token::type_count> table{};
+	table[Token::EQUAL] = {true, OpCode::JUMP_UNLESS_EQUAL};
+	table[Token::NOT_EQUAL] = {true, OpCode::JUMP_UNLESS_NOT_EQUAL};
+	table[Token::LESS] = {true, OpCode::JUMP_UNLESS_LESS};
+	table[Token::LESS_EQUAL] = {true, OpCode::JUMP_UNLESS_LESS_EQUAL};
+	table[Token::GREATER] = {true, OpCode::JUMP_UNLESS_GREATER};
+	table[Token::GREATER_EQUAL] = {true, OpCode::JUMP_UNLESS_GREATER_EQUAL};
+	return table;
+}();
+
+static constexpr OpCode call_opcodes[] = {OpCode::CALL_0, OpCode::CALL_1, OpCode::CALL_2, OpCode::CALL_3};
+
+static Expression* strip_parentheses(Expression* expression) {
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	return expression;
+}
+
+Program Compiler::compile(TranslationUnit& unit) {
+	program = Program();
+	functions.clear();
+	strings.clear();
+	unit.accept(*this);
+	return std::move(program);
+}
+
+void Compiler::visit(TranslationUnit& node) {
+	program.functions.push_back(Function{"<globals>", ValueType::NONE, {}, 0, true, {}});
+	program.initializer = 0;
+	program.global_count = node.global_count;
+	for (auto& decl : node.declarations) {
+		if (auto func = dynamic_cast<FuncDeclaration*>(decl)) {
+			declare_function(*func);
+		}
+	}
+
+	function = &program.functions[program.initializer];
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<VarDeclaration*>(decl)) {
+			origin = decl->offset;
+			locate(0);
+			decl->accept(*this);
+		}
+	}
+	emit_constant(Value());
+	emit(OpCode::RETURN);
+
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<FuncDeclaration*>(decl)) {
+			decl->accept(*this);
+		}
+	}
+	function = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Compiler::visit(Declaration::NoPtrDeclarator&) {
+	// Declarators were bound to their slots by the Resolver.
+}
+
+void Compiler::visit(Declaration::PtrDeclarator& node) {
+	throw std::runtime_error("Pointer declarator *" + std::string(node.name) + " is not supported yet");
+}
+
+void Compiler::visit(Declaration::ArrayDeclarator&) {}
+
+void Compiler::visit(Declaration::InitDeclarator& node) {
+	node.declarator->accept(*this);
+}
+
+void Compiler::visit(VarDeclaration& node) {
+	for (auto& declarator : node.declarator_list) {
+		declare_variable(*declarator);
+	}
+}
+
+void Compiler::visit(ParameterDeclaration& node) {
+	auto& declarator = *node.init_declarator;
+	declarator.accept(*this);
+	if (declarator.initializer) {
+		throw std::runtime_error("Default argument for " + std::string(declarator.declarator->name) + " is not supported");
+	}
+}
+
+void Compiler::visit(FuncDeclaration& node) {
+	if (!node.body) {
+		return;
+	}
+	function = &program.functions[functions.at(node.declarator->name)];
+	function->frame_size = node.frame_size;
+	origin = node.offset;
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	node.body->accept(*this);
+	emit_constant(default_value(function->return_type));
+	emit(OpCode::RETURN);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Compiler::visit(CompoundStatement& node) {
+	for (auto& statement : node.statements) {
+		statement->accept(*this);
+	}
+}
+
+void Compiler::visit(DeclarationStatement& node) {
+	locate(node.offset);
+	node.declaration->accept(*this);
+}
+
+void Compiler::visit(ExpressionStatement& node) {
+	locate(node.offset);
+	// A counter bumped for its side effect alone never needs its old value on the stack.
+	if (fusion) {
+		Expression* target = nullptr;
+		OpCode op{};
+		if (auto increment = dynamic_cast<PostfixIncrementExpression*>(node.expression)) {
+			target = increment->base;
+			op = OpCode::INCREMENT_LOCAL;
+		} else if (auto decrement = dynamic_cast<PostfixDecrementExpression*>(node.expression)) {
+			target = decrement->base;
+			op = OpCode::DECREMENT_LOCAL;
+		} else if (auto prefix = dynamic_cast<PrefixExpression*>(node.expression);
+			prefix && (prefix->op == Token::INCREMENT || prefix->op == Token::DECREMENT)) {
+			target = prefix->base;
+			op = prefix->op == Token::INCREMENT ? OpCode::INCREMENT_LOCAL : OpCode::DECREMENT_LOCAL;
+		}
+		if (auto variable = target ? dynamic_cast<IdentifierExpression*>(strip_parentheses(target)) : nullptr) {
+			if (!variable->symbol.global()) {
+				emit(op, variable->symbol.slot);
+				return;
+			}
+		}
+		if (auto operation = dynamic_cast<BinaryOperation*>(node.expression); operation && operation->appended()) {
+			operation->appended()->accept(*this);
+			emit(OpCode::APPEND_LOCAL, assignable(operation->lhs).symbol.slot);
+			return;
+		}
+	}
+	node.expression->accept(*this);
+	emit(OpCode::POP);
+}
+
+void Compiler::visit(ConditionalStatement& node) {
+	locate(node.offset);
+	std::vector<std::size_t> exits;
+	auto branch = [&](const ConditionalStatement::Branch& branch) {
+		auto skip = jump_unless(branch.first);
+		branch.second->accept(*this);
+		exits.push_back(emit(OpCode::JUMP));
+		patch(skip);
+	};
+	branch(node.if_branch);
+	for (auto& elif_branch : node.elif_branches) {
+		branch(elif_branch);
+	}
+	if (node.else_branch) {
+		node.else_branch->accept(*this);
+	}
+	for (auto exit : exits) {
+		patch(exit);
+	}
+}
+
+void Compiler::visit(WhileStatement& node) {
+	locate(node.offset);
+	auto start = here();
+	auto exit = jump_unless(node.condition);
+	loops.push_back(Loop{start, {}});
+	node.statement->accept(*this);
+	emit(OpCode::LOOP, start);
+	patch(exit);
+	for (auto brk : loops.back().breaks) {
+		patch(brk);
+	}
+	loops.pop_back();
+}
+
+void Compiler::visit(RepeatStatement& node) {
+	locate(node.offset);
+	auto start = here();
+	loops.push_back(Loop{start, {}});
+	node.statement->accept(*this);
+	emit(OpCode::LOOP, start);
+	for (auto brk : loops.back().breaks) {
+		patch(brk);
+	}
+	loops.pop_back();
+}
+
+void Compiler::visit(ForStatement&) {
+	throw std::runtime_error("for statements are not supported yet");
+}
+
+void Compiler::visit(ReturnStatement& node) {
+	locate(node.offset);
+	if (auto call = node.tail_call) {
+		for (auto& arg : call->args) {
+			arg->accept(*this);
+		}
+		program.call_sites.push_back(CallSite{std::string(static_cast<IdentifierExpression*>(call->base)->name), static_cast<std::uint32_t>(call->args.size())});
+		emit(OpCode::TAIL_CALL, program.call_sites.size() - 1);
+	} else if (node.expression) {
+		node.expression->accept(*this);
+	} else {
+		emit_constant(Value());
+	}
+	emit(OpCode::CONVERT, static_cast<std::int32_t>(function->return_type));
+	emit(OpCode::RETURN);
+}
+
+void Compiler::visit(BreakStatement& node) {
+	locate(node.offset);
+	if (loops.empty()) {
+		throw std::runtime_error("break statement outside of a loop");
+	}
+	loops.back().breaks.push_back(emit(OpCode::JUMP));
+}
+
+void Compiler::visit(ContinueStatement& node) {
+	locate(node.offset);
+	if (loops.empty()) {
+		throw std::runtime_error("continue statement outside of a loop");
+	}
+	emit(OpCode::LOOP, loops.back().continue_target);
+}
+
+///////////////////////////////////////////////////////////////////
+
+void Compiler::visit(BinaryOperation& node) {
+	auto subscript = dynamic_cast<SubscriptExpression*>(strip_parentheses(node.lhs));
+	if (subscript && node.op == Token::ASSIGNMENT) {
+		subscript->base->accept(*this);
+		subscript->index->accept(*this);
+		node.rhs->accept(*this);
+		emit(OpCode::STORE_ELEMENT, subscript->checked);
+	} else if (auto suffix = node.appended()) {
+		auto& variable = assignable(node.lhs).symbol;
+		suffix->accept(*this);
+		emit(OpCode::APPEND_LOCAL, variable.slot);
+		load(variable);
+	} else if (auto op = Token::compound_operator(node.op); subscript && op != Token::INVALID) {
+		subscript->base->accept(*this);
+		subscript->index->accept(*this);
+		emit(OpCode::DUP2);
+		emit(OpCode::LOAD_ELEMENT, subscript->checked);
+		node.rhs->accept(*this);
+		emit(binary_opcodes[op].second);
+		emit(OpCode::STORE_ELEMENT, subscript->checked);
+	} else if (node.op == Token::ASSIGNMENT) {
+		auto& variable = assignable(node.lhs).symbol;
+		node.rhs->accept(*this);
+		emit(OpCode::CONVERT, static_cast<std::int32_t>(variable.type->value_type));
+		emit(OpCode::DUP);
+		store(variable);
+	} else if (auto op = Token::compound_operator(node.op); op != Token::INVALID) {
+		auto& variable = assignable(node.lhs).symbol;
+		load(variable);
+		node.rhs->accept(*this);
+		emit(binary_opcodes[op].second);
+		emit(OpCode::CONVERT, static_cast<std::int32_t>(variable.type->value_type));
+		emit(OpCode::DUP);
+		store(variable);
+	} else if (node.op == Token::AND || node.op == Token::OR) {
+		node.lhs->accept(*this);
+		if (node.op == Token::OR) {
+			emit(OpCode::NOT);
+		}
+		auto short_circuit = emit(OpCode::JUMP_IF_FALSE);
+		node.rhs->accept(*this);
+		emit(OpCode::CONVERT, static_cast<std::int32_t>(ValueType::BOOL));
+		auto exit = emit(OpCode::JUMP);
+		patch(short_circuit);
+		emit_constant(node.op == Token::OR);
+		patch(exit);
+	} else if (binary_opcodes[node.op].first) {
+		node.lhs->accept(*this);
+		node.rhs->accept(*this);
+		emit(binary_opcodes[node.op].second);
+	} else {
+		throw std::runtime_error("Unsupported binary operator " + std::string(Token::spelling(node.op)));
+	}
+}
+
+void Compiler::visit(PrefixExpression& node) {
+	switch (node.op) {
+		case Token::INCREMENT:
+			update(node.base, OpCode::ADD, false);
+			break;
+		case Token::DECREMENT:
+			update(node.base, OpCode::SUBTRACT, false);
+			break;
+		case Token::MINUS:
+			node.base->accept(*this);
+			emit(OpCode::NEGATE);
+			break;
+		case Token::PLUS:
+			node.base->accept(*this);
+			emit(OpCode::PLUS);
+			break;
+		case Token::NOT:
+			node.base->accept(*this);
+			emit(OpCode::NOT);
+			break;
+		default:
+			throw std::runtime_error("Prefix operator " + std::string(Token::spelling(node.op)) + " is not supported yet");
+	}
+}
+
+void Compiler::visit(PostfixIncrementExpression& node) {
+	update(node.base, OpCode::ADD, true);
+}
+
+void Compiler::visit(PostfixDecrementExpression& node) {
+	update(node.base, OpCode::SUBTRACT, true);
+}
+
+void Compiler::visit(SubscriptExpression& node) {
+	node.base->accept(*this);
+	node.index->accept(*this);
+	emit(OpCode::LOAD_ELEMENT, node.checked);
+}
+
+void Compiler::visit(FunctionCallExpression& node) {
+	auto callee = dynamic_cast<IdentifierExpression*>(node.base);
+	if (!callee) {
+		throw std::runtime_error("Called object is not a function name");
+	}
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	program.call_sites.push_back(CallSite{std::string(callee->name), static_cast<std::uint32_t>(node.args.size())});
+	auto op = fusion && node.args.size() < std::size(call_opcodes) ? call_opcodes[node.args.size()] : OpCode::CALL;
+	emit(op, program.call_sites.size() - 1);
+}
+
+void Compiler::visit(IdentifierExpression& node) {
+	load(node.symbol);
+}
+
+void Compiler::visit(IntLiteral& node) {
+	emit_constant(node.value);
+}
+
+void Compiler::visit(FloatLiteral& node) {
+	emit_constant(static_cast<double>(node.value));
+}
+
+void Compiler::visit(CharLiteral& node) {
+	emit_constant(node.value);
+}
+
+// Each distinct literal is one constant, shared by every use of it
+void Compiler::visit(StringLiteral& node) {
+	auto [string, inserted] = strings.try_emplace(node.value, program.constants.size());
+	if (inserted) {
+		program.constants.emplace_back(node.value);
+	}
+	emit(OpCode::CONSTANT, string->second);
+}
+
+void Compiler::visit(BoolLiteral& node) {
+	emit_constant(node.value);
+}
+
+void Compiler::visit(ParenthesizedExpression& node) {
+	node.expression->accept(*this);
+}
+
+///////////////////////////////////////////////////////////////////
+
+void Compiler::declare_function(FuncDeclaration& node) {
+	auto name = node.declarator->name;
+	if (dynamic_cast<Declaration::PtrDeclarator*>(node.declarator)) {
+		throw std::runtime_error("Function " + std::string(name) + " returning a pointer is not supported yet");
+	}
+	auto [entry, inserted] = functions.emplace(name, program.functions.size());
+	if (inserted) {
+		Function function;
+		function.name = name;
+		function.return_type = node.signature->base->value_type;
+		for (auto parameter : node.signature->parameters) {
+			function.parameter_types.push_back(parameter->value_type);
+		}
+		program.functions.push_back(std::move(function));
+	}
+	auto& function = program.functions[entry->second];
+	if (node.body) {
+		if (function.defined) {
+			throw std::runtime_error("Redefinition of function " + std::string(name));
+		}
+		function.defined = true;
+	}
+}
+
+void Compiler::declare_variable(Declaration::InitDeclarator& node) {
+	node.accept(*this);
+	auto type = node.declarator->symbol.type->value_type;
+	// Never a constant: every execution of the declaration makes a new array
+	auto array = dynamic_cast<Declaration::ArrayDeclarator*>(node.declarator);
+	if (array && array->size) {
+		array->size->accept(*this);
+		emit(OpCode::NEW_FIXED_ARRAY, static_cast<std::int32_t>(type));
+	} else if (array && !node.initializer) {
+		emit(OpCode::NEW_ARRAY, static_cast<std::int32_t>(type));
+	} else if (node.initializer) {
+		node.initializer->accept(*this);
+		emit(OpCode::CONVERT, static_cast<std::int32_t>(type));
+	} else {
+		emit_constant(default_value(type));
+	}
+	store(node.declarator->symbol);
+}
+
+IdentifierExpression& Compiler::assignable(Expression* expression) const {
+	auto identifier = dynamic_cast<IdentifierExpression*>(strip_parentheses(expression));
+	if (!identifier) {
+		throw std::runtime_error("Expression is not assignable");
+	}
+	return *identifier;
+}
+
+void Compiler::load(const Symbol& variable) {
+	emit(variable.global() ? OpCode::LOAD_GLOBAL : OpCode::LOAD_LOCAL, variable.slot);
+}
+
+void Compiler::store(const Symbol& variable) {
+	emit(variable.global() ? OpCode::STORE_GLOBAL : OpCode::STORE_LOCAL, variable.slot);
+}
+
+void Compiler::update(Expression* target, OpCode op, bool postfix) {
+	if (auto subscript = dynamic_cast<SubscriptExpression*>(strip_parentheses(target))) {
+		subscript->base->accept(*this);
+		subscript->index->accept(*this);
+		if (postfix) {
+			emit(OpCode::INCREMENT_ELEMENT, op == OpCode::ADD ? 1 : -1);
+			return;
+		}
+		emit(OpCode::DUP2);
+		emit(OpCode::LOAD_ELEMENT, 1);
+		emit_constant(1);
+		emit(op);
+		emit(OpCode::STORE_ELEMENT, 1);
+		return;
+	}
+	auto& variable = assignable(target).symbol;
+	load(variable);
+	if (postfix) {
+		emit(OpCode::DUP);
+	}
+	emit_constant(1);
+	emit(op);
+	emit(OpCode::CONVERT, static_cast<std::int32_t>(variable.type->value_type));
+	if (!postfix) {
+		emit(OpCode::DUP);
+	}
+	store(variable);
+}
+
+std::size_t Compiler::jump_unless(Expression* condition) {
+	auto comparison = dynamic_cast<BinaryOperation*>(strip_parentheses(condition));
+	if (fusion && comparison && jump_unless_opcodes[comparison->op].first) {
+		comparison->lhs->accept(*this);
+		comparison->rhs->accept(*this);
+		return emit(jump_unless_opcodes[comparison->op].second);
+	}
+	condition->accept(*this);
+	return emit(OpCode::JUMP_IF_FALSE);
+}
+
+// Statements that emit no code of their own share the entry of the next one.
+void Compiler::locate(std::uint32_t offset) {
+	auto& locations = function->locations;
+	auto instruction = static_cast<std::uint32_t>(here());
+	if (!locations.empty() && locations.back().instruction == instruction) {
+		locations.back().offset = origin + offset;
+	} else {
+		locations.push_back(Location{instruction, origin + offset});
+	}
+}
+
+std::size_t Compiler::emit(OpCode op, std::int32_t operand) {
+	function->code.push_back(Instruction{op, operand});
+	return function->code.size() - 1;
+}
+
+void Compiler::emit_constant(Value value) {
+	program.constants.push_back(std::move(value));
+	emit(OpCode::CONSTANT, program.constants.size() - 1);
+}
+
+void Compiler::patch(std::size_t at) {
+	function->code[at].operand = here();
+}
+
+std::size_t Compiler::here() const {
+	return function->code.size();
+}
@@ -0,0 +1,190 @@
+#include "counter.hpp"
+
+std::size_t NodeCounter::count(ASTNode& node) {
+	nodes = 0;
+	node.accept(*this);
+	return nodes;
+}
+
+void NodeCounter::visit(TranslationUnit& node) {
+	++nodes;
+	for (auto& decl : node.declarations) {
+		decl->accept(*this);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NodeCounter::visit(Declaration::NoPtrDeclarator&) {
+	++nodes;
+}
+
+void NodeCounter::visit(Declaration::PtrDeclarator&) {
+	++nodes;
+}
+
+void NodeCounter::visit(Declaration::ArrayDeclarator& node) {
+	++nodes;
+	if (node.size) {
+		node.size->accept(*this);
+	}
+}
+
+void NodeCounter::visit(Declaration::InitDeclarator& node) {
+	++nodes;
+	node.declarator->accept(*this);
+	if (node.initializer) {
+		node.initializer->accept(*this);
+	}
+}
+
+void NodeCounter::visit(VarDeclaration& node) {
+	++nodes;
+	for (auto& declarator : node.declarator_list) {
+		declarator->accept(*this);
+	}
+}
+
+void NodeCounter::visit(ParameterDeclaration& node) {
+	++nodes;
+	node.init_declarator->accept(*this);
+}
+
+void NodeCounter::visit(FuncDeclaration& node) {
+	++nodes;
+	node.declarator->accept(*this);
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	if (node.body) {
+		node.body->accept(*this);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void NodeCounter::visit(CompoundStatement& node) {
+	++nodes;
+	for (auto& statement : node.statements) {
+		statement->accept(*this);
+	}
+}
+
+void NodeCounter::visit(DeclarationStatement& node) {
+	++nodes;
+	node.declaration->accept(*this);
+}
+
+void NodeCounter::visit(ExpressionStatement& node) {
+	++nodes;
+	node.expression->accept(*this);
+}
+
+void NodeCounter::visit(ConditionalStatement& node) {
+	++nodes;
+	node.if_branch.first->accept(*this);
+	node.if_branch.second->accept(*this);
+	for (auto& branch : node.elif_branches) {
+		branch.first->accept(*this);
+		branch.second->accept(*this);
+	}
+	if (node.else_branch) {
+		node.else_branch->accept(*this);
+	}
+}
+
+void NodeCounter::visit(WhileStatement& node) {
+	++nodes;
+	node.condition->accept(*this);
+	node.statement->accept(*this);
+}
+
+void NodeCounter::visit(RepeatStatement& node) {
+	++nodes;
+	node.statement->accept(*this);
+}
+
+void NodeCounter::visit(ForStatement&) {
+	++nodes;
+}
+
+void NodeCounter::visit(ReturnStatement& node) {
+	++nodes;
+	if (node.expression) {
+		node.expression->accept(*this);
+	}
+}
+
+void NodeCounter::visit(BreakStatement&) {
+	++nodes;
+}
+
+void NodeCounter::visit(ContinueStatement&) {
+	++nodes;
+}
+
+///////////////////////////////////////////////////////////////////
+
+void NodeCounter::visit(BinaryOperation& node) {
+	++nodes;
+	node.lhs->accept(*this);
+	node.rhs->accept(*this);
+}
+
+void NodeCounter::visit(PrefixExpression& node) {
+	++nodes;
+	node.base->accept(*this);
+}
+
+void NodeCounter::visit(PostfixIncrementExpression& node) {
+	++nodes;
+	node.base->accept(*this);
+}
+
+void NodeCounter::visit(PostfixDecrementExpression& node) {
+	++nodes;
+	node.base->accept(*this);
+}
+
+void NodeCounter::visit(FunctionCallExpression& node) {
+	++nodes;
+	node.base->accept(*this);
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+}
+
+void NodeCounter::visit(SubscriptExpression& node) {
+	++nodes;
+	node.base->accept(*this);
+	node.index->accept(*this);
+}
+
+void NodeCounter::visit(IntLiteral&) {
+	++nodes;
+}
+
+void NodeCounter::visit(FloatLiteral&) {
+	++nodes;
+}
+
+void NodeCounter::visit(CharLiteral&) {
+	++nodes;
+}
+
+void NodeCounter::visit(StringLiteral&) {
+	++nodes;
+}
+
+void NodeCounter::visit(BoolLiteral&) {
+	++nodes;
+}
+
+void NodeCounter::visit(IdentifierExpression&) {
+	++nodes;
+}
+
+void NodeCounter::visit(ParenthesizedExpression& node) {
+	++nodes;
+	node.expression->accept(*this);
+}
@@ -1,7 +1,7 @@
 #include "visitor.hpp"
 
 Declaration::Declarator::Declarator(
-	const std::string& name
+	std::string_view name
 	) : name(name) {}
 
 void Declaration::NoPtrDeclarator::accept(Visitor& visitor) {
@@ -12,9 +12,18 @@ void Declaration::PtrDeclarator::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
+Declaration::ArrayDeclarator::ArrayDeclarator(
+	std::string_view name,
+	Expression* size
+	) : Declarator(name), size(size) {}
+
+void Declaration::ArrayDeclarator::accept(Visitor& visitor) {
+	visitor.visit(*this);
+}
+
 Declaration::InitDeclarator::InitDeclarator(
-	const std::shared_ptr<Declarator>& declarator,
-	const std::shared_ptr<Expression>& initializer
+	Declarator* declarator,
+	Expression* initializer
 	) : declarator(declarator), initializer(initializer) {}
 
 void Declaration::InitDeclarator::accept(Visitor& visitor) {
@@ -22,8 +31,8 @@ void Declaration::InitDeclarator::accept(Visitor& visitor) {
 }
 
 VarDeclaration::VarDeclaration(
-	const std::string& type,
-	const std::vector<std::shared_ptr<InitDeclarator>>& declarator_list
+	std::string_view type,
+	std::span<InitDeclarator*> declarator_list
 	) : type(type), declarator_list(declarator_list) {}
 
 void VarDeclaration::accept(Visitor& visitor) {
@@ -31,10 +40,10 @@ void VarDeclaration::accept(Visitor& visitor) {
 }
 
 FuncDeclaration::FuncDeclaration(
-	const std::string& type,
-	const std::shared_ptr<Declarator>& declarator,
-	const std::vector<std::shared_ptr<ParameterDeclaration>>& args,
-	const std::shared_ptr<CompoundStatement>& body
+	std::string_view type,
+	Declarator* declarator,
+	std::span<ParameterDeclaration*> args,
+	CompoundStatement* body
 	) : type(type), declarator(declarator), args(args), body(body) {}
 
 void FuncDeclaration::accept(Visitor& visitor) {
@@ -42,8 +51,8 @@ void FuncDeclaration::accept(Visitor& visitor) {
 }
 
 ParameterDeclaration::ParameterDeclaration(
-	const std::string& type,
-	const std::shared_ptr<InitDeclarator>& init_declarator
+	std::string_view type,
+	InitDeclarator* init_declarator
 	) : type(type), init_declarator(init_declarator) {}
 
 void ParameterDeclaration::accept(Visitor& visitor) {
@@ -0,0 +1,502 @@
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+
+#include "evaluator.hpp"
+#include "builtins.hpp"
+#include "array.hpp"
+
+static SubscriptExpression* subscript_of(Expression* expression) {
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	return dynamic_cast<SubscriptExpression*>(expression);
+}
+
+Evaluator::Evaluator(
+	std::ostream& output,
+	Profiler* profiler,
+	std::size_t recursion_limit,
+	std::size_t nursery_size,
+	const StopRequest* stop
+	) : heap(nursery_size), output(output), profiler(profiler), recursion_limit(recursion_limit), stop(stop) {}
+
+int Evaluator::run(TranslationUnit& unit) {
+	pthread_attr_t attributes;
+	if (::pthread_getattr_np(::pthread_self(), &attributes) == 0) {
+		void* address;
+		std::size_t size;
+		::pthread_attr_getstack(&attributes, &address, &size);
+		::pthread_attr_destroy(&attributes);
+		stack_floor = reinterpret_cast<std::uintptr_t>(address) + size / 4;
+	}
+	Heap::Scope scope(heap);
+	unit.accept(*this);
+	auto main = functions.find("main");
+	if (main == functions.end()) {
+		throw std::runtime_error("No main function defined");
+	} else if (!main->second->args.empty()) {
+		throw std::runtime_error("main must not take parameters");
+	}
+	auto value = call(*main->second, stack.size());
+	return type_of(value) == ValueType::INT ? value.as_int() : 0;
+}
+
+void Evaluator::visit(TranslationUnit& node) {
+	globals.assign(node.global_count, Value());
+	call_caches.assign(node.call_site_count, CallCache());
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<FuncDeclaration*>(decl)) {
+			decl->accept(*this);
+		}
+	}
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<VarDeclaration*>(decl)) {
+			decl->accept(*this);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Evaluator::visit(Declaration::NoPtrDeclarator&) {}
+
+void Evaluator::visit(Declaration::PtrDeclarator& node) {
+	throw std::runtime_error("Pointer declarator *" + std::string(node.name) + " is not supported yet");
+}
+
+void Evaluator::visit(Declaration::ArrayDeclarator&) {}
+
+void Evaluator::visit(Declaration::InitDeclarator& node) {
+	node.declarator->accept(*this);
+}
+
+void Evaluator::visit(VarDeclaration& node) {
+	for (auto& declarator : node.declarator_list) {
+		declarator->accept(*this);
+		auto type = declarator->declarator->symbol.type->value_type;
+		auto array = dynamic_cast<Declaration::ArrayDeclarator*>(declarator->declarator);
+		auto value = array && array->size ? Array::make(element_of(type), array_size(evaluate(array->size)), true)
+			: declarator->initializer ? convert(evaluate(declarator->initializer), type) : default_value(type);
+		lookup(declarator->declarator->symbol) = std::move(value);
+		if (heap.due()) {
+			collect();
+		}
+	}
+}
+
+void Evaluator::visit(ParameterDeclaration& node) {
+	node.init_declarator->accept(*this);
+	if (node.init_declarator->initializer) {
+		throw std::runtime_error("Default argument for " + std::string(node.init_declarator->declarator->name) + " is not supported");
+	}
+}
+
+void Evaluator::visit(FuncDeclaration& node) {
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	if (!node.body) {
+		return;
+	}
+	if (!functions.emplace(node.declarator->name, &node).second) {
+		throw std::runtime_error("Redefinition of function " + std::string(node.declarator->name));
+	}
+	++generation;
+	if (profiler) {
+		profile_ids.emplace(&node, profiler->function(node.declarator->name));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Evaluator::visit(CompoundStatement& node) {
+	for (auto& statement : node.statements) {
+		execute(statement);
+		if (flow != Flow::NORMAL) {
+			break;
+		}
+	}
+}
+
+void Evaluator::visit(DeclarationStatement& node) {
+	node.declaration->accept(*this);
+}
+
+void Evaluator::visit(ExpressionStatement& node) {
+	evaluate(node.expression);
+}
+
+void Evaluator::visit(ConditionalStatement& node) {
+	if (truthy(evaluate(node.if_branch.first))) {
+		execute(node.if_branch.second);
+		return;
+	}
+	for (auto& branch : node.elif_branches) {
+		if (truthy(evaluate(branch.first))) {
+			execute(branch.second);
+			return;
+		}
+	}
+	if (node.else_branch) {
+		execute(node.else_branch);
+	}
+}
+
+void Evaluator::visit(WhileStatement& node) {
+	while (truthy(evaluate(node.condition))) {
+		execute(node.statement);
+		if (!loop_step()) {
+			break;
+		}
+	}
+}
+
+void Evaluator::visit(RepeatStatement& node) {
+	while (true) {
+		execute(node.statement);
+		if (!loop_step()) {
+			break;
+		}
+	}
+}
+
+void Evaluator::visit(ForStatement&) {
+	throw std::runtime_error("for statements are not supported yet");
+}
+
+void Evaluator::visit(ReturnStatement& node) {
+	auto type = calls.back().function->signature->base->value_type;
+	if (auto call = node.tail_call) {
+		auto arguments = stack.size();
+		for (auto& arg : call->args) {
+			stack.push_back(evaluate(arg));
+		}
+		auto& cache = resolve(*call);
+		if (cache.function) {
+			auto base = calls.back().base;
+			for (std::size_t i = 0; i < call->args.size(); ++i) {
+				stack[base + i] = std::move(stack[arguments + i]);
+			}
+			stack.resize(base + call->args.size());
+			tail_target = cache.function;
+			flow = Flow::TAIL;
+			return;
+		}
+		result = convert(cache.builtin->call(std::span<const Value>(stack.data() + arguments, call->args.size()), output), type);
+		stack.resize(arguments);
+	} else {
+		result = convert(node.expression ? evaluate(node.expression) : Value(), type);
+	}
+	flow = Flow::RETURN;
+}
+
+void Evaluator::visit(BreakStatement&) {
+	flow = Flow::BREAK;
+}
+
+void Evaluator::visit(ContinueStatement&) {
+	flow = Flow::CONTINUE;
+}
+
+///////////////////////////////////////////////////////////////////
+
+// An element is assigned after the array, the index and then the value are
+// evaluated, in the order the VM finds them on its stack.
+void Evaluator::visit(BinaryOperation& node) {
+	auto subscript = subscript_of(node.lhs);
+	if (subscript && node.op == Token::ASSIGNMENT) {
+		auto base = evaluate(subscript->base);
+		Pin pin(pinned, base);
+		auto index = evaluate(subscript->index);
+		result = store_element(base, index, evaluate(node.rhs), subscript->checked);
+	} else if (auto suffix = node.appended()) {
+		auto value = evaluate(suffix);
+		auto& variable = lookup(assignable(node.lhs).symbol);
+		add_to(variable, value);
+		result = variable;
+	} else if (auto op = Token::compound_operator(node.op); subscript && op != Token::INVALID) {
+		auto base = evaluate(subscript->base);
+		Pin pin(pinned, base);
+		auto index = evaluate(subscript->index);
+		auto current = load_element(base, index, subscript->checked);
+		result = store_element(base, index, binary_operation(op, current, evaluate(node.rhs)), subscript->checked);
+	} else if (node.op == Token::ASSIGNMENT) {
+		auto value = evaluate(node.rhs);
+		auto& symbol = assignable(node.lhs).symbol;
+		auto& variable = lookup(symbol);
+		variable = convert(value, symbol.type->value_type);
+		result = variable;
+	} else if (auto op = Token::compound_operator(node.op); op != Token::INVALID) {
+		auto& symbol = assignable(node.lhs).symbol;
+		auto current = lookup(symbol);
+		Pin pin(pinned, current);
+		auto value = binary_operation(op, current, evaluate(node.rhs));
+		auto& variable = lookup(symbol);
+		variable = convert(value, symbol.type->value_type);
+		result = variable;
+	} else if (node.op == Token::AND) {
+		result = truthy(evaluate(node.lhs)) && truthy(evaluate(node.rhs));
+	} else if (node.op == Token::OR) {
+		result = truthy(evaluate(node.lhs)) || truthy(evaluate(node.rhs));
+	} else {
+		auto lhs = evaluate(node.lhs);
+		Pin pin(pinned, lhs);
+		auto rhs = evaluate(node.rhs);
+		if (node.op == Token::PLUS) {
+			add_to(lhs, rhs);
+			result = std::move(lhs);
+		} else {
+			result = binary_operation(node.op, lhs, rhs);
+		}
+	}
+}
+
+void Evaluator::visit(PrefixExpression& node) {
+	switch (node.op) {
+		case Token::INCREMENT:
+			update(node.base, Token::PLUS, false);
+			break;
+		case Token::DECREMENT:
+			update(node.base, Token::MINUS, false);
+			break;
+		case Token::MINUS:
+		case Token::PLUS:
+		case Token::NOT:
+			result = unary_operation(node.op, evaluate(node.base));
+			break;
+		default:
+			throw std::runtime_error("Prefix operator " + std::string(Token::spelling(node.op)) + " is not supported yet");
+	}
+}
+
+void Evaluator::visit(PostfixIncrementExpression& node) {
+	update(node.base, Token::PLUS, true);
+}
+
+void Evaluator::visit(PostfixDecrementExpression& node) {
+	update(node.base, Token::MINUS, true);
+}
+
+void Evaluator::visit(SubscriptExpression& node) {
+	auto base = evaluate(node.base);
+	Pin pin(pinned, base);
+	auto index = evaluate(node.index);
+	result = load_element(base, index, node.checked);
+}
+
+void Evaluator::visit(FunctionCallExpression& node) {
+	auto base = stack.size();
+	for (auto& arg : node.args) {
+		stack.push_back(evaluate(arg));
+	}
+	auto& cache = resolve(node);
+	if (cache.function) {
+		result = call(*cache.function, base);
+	} else {
+		result = cache.builtin->call(std::span<const Value>(stack.data() + base, node.args.size()), output);
+		stack.resize(base);
+	}
+}
+
+void Evaluator::visit(IdentifierExpression& node) {
+	result = lookup(node.symbol);
+}
+
+void Evaluator::visit(IntLiteral& node) {
+	result = node.value;
+}
+
+void Evaluator::visit(FloatLiteral& node) {
+	result = static_cast<double>(node.value);
+}
+
+void Evaluator::visit(CharLiteral& node) {
+	result = node.value;
+}
+
+void Evaluator::visit(StringLiteral& node) {
+	if (node.value.size() <= Value::inline_capacity) {
+		result = Value(node.value);
+		return;
+	}
+	auto string = strings.find(node.value);
+	if (string == strings.end()) {
+		Value value(node.value);
+		string = strings.emplace(value.as_string(), value).first;
+	}
+	result = string->second;
+}
+
+void Evaluator::visit(BoolLiteral& node) {
+	result = node.value;
+}
+
+void Evaluator::visit(ParenthesizedExpression& node) {
+	node.expression->accept(*this);
+}
+
+///////////////////////////////////////////////////////////////////
+
+Value Evaluator::evaluate(Expression* expression) {
+	expression->accept(*this);
+	return std::move(result);
+}
+
+void Evaluator::execute(Statement* statement) {
+	if (profiler && Profiler::pending()) {
+		sample(statement);
+	}
+	statement->accept(*this);
+}
+
+// The arguments are already on the stack from base on and become the first
+// locals of the frame; parameters take the first slots.
+Value Evaluator::call(FuncDeclaration& function, std::size_t base) {
+	char marker;
+	if (calls.size() >= recursion_limit) {
+		throw std::runtime_error("Recursion limit of " + std::to_string(recursion_limit) + " calls exceeded in "
+			+ std::string(function.declarator->name));
+	} else if (reinterpret_cast<std::uintptr_t>(&marker) < stack_floor) {
+		throw std::runtime_error("Native stack exhausted after " + std::to_string(calls.size()) + " calls in "
+			+ std::string(function.declarator->name) + "; the VM engine has no such bound");
+	}
+	calls.push_back(Call{&function, base});
+	auto current = &function;
+	while (true) {
+		check_stop();
+		auto argument_count = stack.size() - base;
+		if (profiler) {
+			profiler->enter(profile_ids.at(current));
+		}
+		for (std::size_t i = 0; i < argument_count; ++i) {
+			auto type = current->args[i]->init_declarator->declarator->symbol.type->value_type;
+			if (type_of(stack[base + i]) != type) {
+				stack[base + i] = convert(stack[base + i], type);
+			}
+		}
+		stack.resize(base + current->frame_size);
+		calls.back().function = current;
+		execute(current->body);
+		if (flow != Flow::TAIL) {
+			break;
+		}
+		flow = Flow::NORMAL;
+		current = tail_target;
+	}
+
+	auto return_type = current->signature->base->value_type;
+	Value value = flow == Flow::RETURN ? std::move(result) : default_value(return_type);
+	if (flow == Flow::BREAK || flow == Flow::CONTINUE) {
+		throw std::runtime_error("break or continue statement outside of a loop in " + std::string(current->declarator->name));
+	}
+	flow = Flow::NORMAL;
+	calls.pop_back();
+	stack.resize(base);
+	return value;
+}
+
+// Looks the callee up and checks the argument count, which is fixed per
+// site, only when the site's cache is empty or from an older generation.
+const Evaluator::CallCache& Evaluator::resolve(FunctionCallExpression& node) {
+	auto& cache = call_caches[node.site];
+	if (cache.generation == generation) {
+		++cache_hits;
+		return cache;
+	}
+	++cache_misses;
+	auto name = static_cast<IdentifierExpression*>(node.base)->name;
+	if (auto function = functions.find(name); function != functions.end()) {
+		if (function->second->args.size() != node.args.size()) {
+			throw std::runtime_error("Function " + std::string(name) + " expects " + std::to_string(function->second->args.size())
+				+ " arguments, got " + std::to_string(node.args.size()));
+		}
+		cache = CallCache{function->second, nullptr, generation};
+	} else if (auto builtin = find_builtin(name)) {
+		cache = CallCache{nullptr, builtin, generation};
+	} else {
+		throw std::runtime_error("Call to undefined function " + std::string(name));
+	}
+	return cache;
+}
+
+Value& Evaluator::lookup(const Symbol& symbol) {
+	return symbol.global() ? globals[symbol.slot] : stack[calls.back().base + symbol.slot];
+}
+
+IdentifierExpression& Evaluator::assignable(Expression* expression) {
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	auto identifier = dynamic_cast<IdentifierExpression*>(expression);
+	if (!identifier) {
+		throw std::runtime_error("Expression is not assignable");
+	}
+	return *identifier;
+}
+
+void Evaluator::update(Expression* target, Token::Type op, bool postfix) {
+	if (auto subscript = subscript_of(target)) {
+		auto base = evaluate(subscript->base);
+		Pin pin(pinned, base);
+		auto index = evaluate(subscript->index);
+		auto previous = load_element(base, index, true);
+		auto stored = store_element(base, index, binary_operation(op, previous, 1), true);
+		result = postfix ? previous : stored;
+		return;
+	}
+	auto& symbol = assignable(target).symbol;
+	auto& variable = lookup(symbol);
+	auto previous = variable;
+	variable = convert(binary_operation(op, previous, 1), symbol.type->value_type);
+	result = postfix ? previous : variable;
+}
+
+bool Evaluator::loop_step() {
+	check_stop();
+	switch (flow) {
+		case Flow::BREAK:
+			flow = Flow::NORMAL;
+			return false;
+		case Flow::CONTINUE:
+			flow = Flow::NORMAL;
+			return true;
+		case Flow::RETURN:
+		case Flow::TAIL:
+			return false;
+		default:
+			return true;
+	}
+}
+
+void Evaluator::sample(Statement* statement) {
+	std::vector<std::uint32_t> stack;
+	stack.reserve(calls.size());
+	for (auto& call : calls) {
+		stack.push_back(profile_ids.at(call.function));
+	}
+	profiler->sample(stack, calls.empty() ? Profiler::no_offset : calls.back().function->offset + statement->offset);
+}
+
+// Every value a caller further up may still read is in a variable, the last
+// result or pinned
+void Evaluator::collect() {
+	heap.collect([this] {
+		heap.mark(globals);
+		heap.mark(stack);
+		heap.mark(result);
+		for (auto value : pinned) {
+			heap.mark(*value);
+		}
+	});
+}
+
+void Evaluator::check_stop() const {
+	if (stop) {
+		if (auto reason = stop->load(std::memory_order_relaxed)) {
+			throw std::runtime_error(reason);
+		}
+	}
+}
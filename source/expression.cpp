@@ -1,18 +1,43 @@
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
 #include "visitor.hpp"
 
+template<typename T>
+static T parse_number(std::string_view text) {
+	T number{};
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+	if (error != std::errc() || end != text.data() + text.size()) {
+		throw std::runtime_error("Invalid numeric literal " + std::string(text));
+	}
+	return number;
+}
+
 BinaryOperation::BinaryOperation(
-	const std::string& op, 
-	const std::shared_ptr<BinaryExpression>& lhs,
-	const std::shared_ptr<BinaryExpression>& rhs
+	Token::Type op, 
+	BinaryExpression* lhs,
+	BinaryExpression* rhs
 	) : op(op), lhs(lhs), rhs(rhs) {}
 
 void BinaryOperation::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
+BinaryExpression* BinaryOperation::appended() const {
+	if (!appends) {
+		return nullptr;
+	}
+	if (op == Token::PLUS_ASSIGNMENT) {
+		return rhs;
+	}
+	auto sum = dynamic_cast<BinaryOperation*>(rhs);
+	return sum ? sum->rhs : nullptr;
+}
+
 PrefixExpression::PrefixExpression(
-	const std::string& op,
-	const std::shared_ptr<UnaryExpression>& base
+	Token::Type op,
+	UnaryExpression* base
 	) : op(op), base(base) {}
 
 void PrefixExpression::accept(Visitor& visitor) {
@@ -20,8 +45,8 @@ void PrefixExpression::accept(Visitor& visitor) {
 }
 
 FunctionCallExpression::FunctionCallExpression(
-	const std::shared_ptr<PostfixExpression>& base,
-	const std::vector<std::shared_ptr<Expression>>& args
+	PostfixExpression* base,
+	std::span<Expression*> args
 	) : base(base), args(args) {}
 
 void FunctionCallExpression::accept(Visitor& visitor) {
@@ -29,8 +54,8 @@ void FunctionCallExpression::accept(Visitor& visitor) {
 }
 
 SubscriptExpression::SubscriptExpression(
-	const std::shared_ptr<PostfixExpression>& base,
-	const std::shared_ptr<Expression>& index
+	PostfixExpression* base,
+	Expression* index
 	) : base(base), index(index) {}
 
 void SubscriptExpression::accept(Visitor& visitor) {
@@ -38,7 +63,7 @@ void SubscriptExpression::accept(Visitor& visitor) {
 }
 
 PostfixIncrementExpression::PostfixIncrementExpression(
-	const std::shared_ptr<PostfixExpression>& base
+	PostfixExpression* base
 	) : base(base) {}
 
 void PostfixIncrementExpression::accept(Visitor& visitor) {
@@ -46,7 +71,7 @@ void PostfixIncrementExpression::accept(Visitor& visitor) {
 }
 
 PostfixDecrementExpression::PostfixDecrementExpression(
-	const std::shared_ptr<PostfixExpression>& base
+	PostfixExpression* base
 	) : base(base) {}
 
 void PostfixDecrementExpression::accept(Visitor& visitor) {
@@ -54,7 +79,7 @@ void PostfixDecrementExpression::accept(Visitor& visitor) {
 }
 
 IdentifierExpression::IdentifierExpression(
-	const std::string& name
+	std::string_view name
 	) : name(name) {}
 
 void IdentifierExpression::accept(Visitor& visitor) {
@@ -62,31 +87,96 @@ void IdentifierExpression::accept(Visitor& visitor) {
 }
 
 IntLiteral::IntLiteral(
-	const std::string& value
-	) : value(std::stoi(value)) {}
+	std::string_view value
+	) : value(parse_number<int>(value)) {}
+
+IntLiteral::IntLiteral(
+	int value
+	) : value(value) {}
 
 void IntLiteral::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
 FloatLiteral::FloatLiteral(
-	const std::string& value
-	) : value(std::stof(value)) {}
+	std::string_view value
+	) : value(parse_number<float>(value)) {}
+
+FloatLiteral::FloatLiteral(
+	float value
+	) : value(value) {}
 
 void FloatLiteral::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
+// The character an escape stands for, given what follows the backslash
+static char unescape(char escaped) {
+	switch (escaped) {
+		case 'n': return '\n';
+		case 't': return '\t';
+		case 'r': return '\r';
+		case '0': return '\0';
+		default: return escaped;
+	}
+}
+
+static char unescape(std::string_view text) {
+	if (text.size() < 2 || text[0] != '\\') {
+		return text[0];
+	}
+	return unescape(text[1]);
+}
+
+// The lexer never ends a literal's text on a lone backslash
+static std::string_view unescape(Arena& arena, std::string_view text) {
+	if (text.find('\\') == std::string_view::npos) {
+		return arena.copy(text);
+	}
+	std::string value;
+	value.reserve(text.size());
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		value += text[i] == '\\' ? unescape(text[++i]) : text[i];
+	}
+	return arena.copy(value);
+}
+
+std::string escape(std::string_view value) {
+	std::string text;
+	text.reserve(value.size());
+	for (auto c : value) {
+		switch (c) {
+			case '\n': text += "\\n"; break;
+			case '\t': text += "\\t"; break;
+			case '\r': text += "\\r"; break;
+			case '\0': text += "\\0"; break;
+			case '"': text += "\\\""; break;
+			case '\\': text += "\\\\"; break;
+			default: text += c; break;
+		}
+	}
+	return text;
+}
+
 CharLiteral::CharLiteral(
-	const std::string& value
-	) : value(value[0]) {}
+	std::string_view value
+	) : value(unescape(value)) {}
+
+CharLiteral::CharLiteral(
+	char value
+	) : value(value) {}
 
 void CharLiteral::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
 StringLiteral::StringLiteral(
-	const std::string& value
+	Arena& arena,
+	std::string_view text
+	) : value(unescape(arena, text)) {}
+
+StringLiteral::StringLiteral(
+	std::string_view value
 	) : value(value) {}
 
 void StringLiteral::accept(Visitor& visitor) {
@@ -94,15 +184,19 @@ void StringLiteral::accept(Visitor& visitor) {
 }
 
 BoolLiteral::BoolLiteral(
-	const std::string& value
+	std::string_view value
 	) : value(value == "true" ? true : false) {}
 
+BoolLiteral::BoolLiteral(
+	bool value
+	) : value(value) {}
+
 void BoolLiteral::accept(Visitor& visitor) {
 	visitor.visit(*this);
 }
 
 ParenthesizedExpression::ParenthesizedExpression(
-	const std::shared_ptr<Expression>& expression
+	Expression* expression
 	) : expression(expression) {}
 
 void ParenthesizedExpression::accept(Visitor& visitor) {
@@ -0,0 +1,544 @@
+#include "flat_ast.hpp"
+#include "output.hpp"
+#include "visitor.hpp"
+
+// Builds the flat encoding from the node classes. Each node takes its index
+// before its children are flattened, which gives the preorder layout; lists
+// are collected on a scratch stack and copied to extra once complete.
+class Flattener : public Visitor {
+public:
+	using Index = FlatTree::Index;
+	using Kind = FlatTree::Kind;
+
+	Flattener(FlatTree&);
+
+	template<typename Node>
+	Index flatten(Node& node) {
+		node.accept(*this);
+		return result;
+	}
+
+	template<typename Node>
+	Index flatten_optional(Node* node) {
+		return node ? flatten(*node) : FlatTree::none;
+	}
+public:
+	void visit(TranslationUnit&) override;
+public:
+	void visit(Declaration::PtrDeclarator&) override;
+	void visit(Declaration::NoPtrDeclarator&) override;
+	void visit(Declaration::ArrayDeclarator&) override;
+	void visit(Declaration::InitDeclarator&) override;
+	void visit(VarDeclaration&) override;
+	void visit(ParameterDeclaration&) override;
+	void visit(FuncDeclaration&) override;
+public:
+	void visit(CompoundStatement&) override;
+	void visit(DeclarationStatement&) override;
+	void visit(ExpressionStatement&) override;
+	void visit(ConditionalStatement&) override;
+	void visit(WhileStatement&) override;
+	void visit(RepeatStatement&) override;
+	void visit(ForStatement&) override;
+	void visit(ReturnStatement&) override;
+	void visit(BreakStatement&) override;
+	void visit(ContinueStatement&) override;
+public:
+	void visit(BinaryOperation&) override;
+	void visit(PrefixExpression&) override;
+	void visit(PostfixIncrementExpression&) override;
+	void visit(PostfixDecrementExpression&) override;
+	void visit(FunctionCallExpression&) override;
+	void visit(SubscriptExpression&) override;
+	void visit(IntLiteral&) override;
+	void visit(FloatLiteral&) override;
+	void visit(CharLiteral&) override;
+	void visit(StringLiteral&) override;
+	void visit(BoolLiteral&) override;
+	void visit(IdentifierExpression&) override;
+	void visit(ParenthesizedExpression&) override;
+
+private:
+	Index add(Kind, Token::Type = Token::END);
+	void set(Index, Index, Index = FlatTree::none);
+	Index string(std::string_view);
+	Index append_list(std::size_t);
+
+	template<typename Node>
+	Index flatten_list(std::span<Node*> nodes) {
+		auto start = scratch.size();
+		for (auto node : nodes) {
+			auto index = flatten(*node);
+			scratch.push_back(index);
+		}
+		return append_list(start);
+	}
+
+	FlatTree& tree;
+	std::vector<Index> scratch;
+	Index result = FlatTree::none;
+};
+
+Flattener::Flattener(FlatTree& tree) : tree(tree) {}
+
+Flattener::Index Flattener::add(Kind kind, Token::Type op) {
+	result = static_cast<Index>(tree.kinds.size());
+	tree.kinds.push_back(kind);
+	tree.operators.push_back(static_cast<std::uint8_t>(op));
+	tree.fields.push_back({FlatTree::none, FlatTree::none});
+	tree.ends.push_back(result + 1);
+	return result;
+}
+
+void Flattener::set(Index node, Index lhs, Index rhs) {
+	tree.fields[node] = {lhs, rhs};
+	tree.ends[node] = static_cast<Index>(tree.kinds.size());
+	result = node;
+}
+
+Flattener::Index Flattener::string(std::string_view text) {
+	tree.strings.push_back(text);
+	return static_cast<Index>(tree.strings.size() - 1);
+}
+
+Flattener::Index Flattener::append_list(std::size_t start) {
+	auto at = static_cast<Index>(tree.extra.size());
+	tree.extra.push_back(static_cast<Index>(scratch.size() - start));
+	tree.extra.insert(tree.extra.end(), scratch.begin() + start, scratch.end());
+	scratch.resize(start);
+	return at;
+}
+
+void Flattener::visit(TranslationUnit& node) {
+	for (auto& decl : node.declarations) {
+		tree.roots.push_back(flatten(*decl));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Flattener::visit(Declaration::NoPtrDeclarator& node) {
+	set(add(Kind::NAME_DECLARATOR), string(node.name));
+}
+
+void Flattener::visit(Declaration::PtrDeclarator& node) {
+	set(add(Kind::POINTER_DECLARATOR), string(node.name));
+}
+
+void Flattener::visit(Declaration::ArrayDeclarator& node) {
+	auto index = add(Kind::ARRAY_DECLARATOR);
+	auto name = string(node.name);
+	set(index, name, flatten_optional(node.size));
+}
+
+void Flattener::visit(Declaration::InitDeclarator& node) {
+	auto index = add(Kind::INIT_DECLARATOR);
+	auto declarator = flatten(*node.declarator);
+	set(index, declarator, flatten_optional(node.initializer));
+}
+
+void Flattener::visit(VarDeclaration& node) {
+	auto index = add(Kind::VAR_DECLARATION);
+	auto type = string(node.type);
+	set(index, type, flatten_list(node.declarator_list));
+}
+
+void Flattener::visit(ParameterDeclaration& node) {
+	auto index = add(Kind::PARAMETER_DECLARATION);
+	auto type = string(node.type);
+	set(index, type, flatten(*node.init_declarator));
+}
+
+void Flattener::visit(FuncDeclaration& node) {
+	auto index = add(Kind::FUNC_DECLARATION);
+	auto type = string(node.type);
+	auto declarator = flatten(*node.declarator);
+	auto start = scratch.size();
+	for (auto arg : node.args) {
+		auto parameter = flatten(*arg);
+		scratch.push_back(parameter);
+	}
+	auto body = flatten_optional(node.body);
+	auto at = static_cast<Index>(tree.extra.size());
+	tree.extra.push_back(declarator);
+	tree.extra.push_back(body);
+	append_list(start);
+	set(index, type, at);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Flattener::visit(CompoundStatement& node) {
+	auto index = add(Kind::COMPOUND);
+	set(index, flatten_list(node.statements));
+}
+
+void Flattener::visit(DeclarationStatement& node) {
+	auto index = add(Kind::DECLARATION_STATEMENT);
+	set(index, flatten(*node.declaration));
+}
+
+void Flattener::visit(ExpressionStatement& node) {
+	auto index = add(Kind::EXPRESSION_STATEMENT);
+	set(index, flatten(*node.expression));
+}
+
+void Flattener::visit(ConditionalStatement& node) {
+	auto index = add(Kind::CONDITIONAL);
+	auto start = scratch.size();
+	auto branch = [&](const ConditionalStatement::Branch& branch) {
+		auto condition = flatten(*branch.first);
+		scratch.push_back(condition);
+		auto statement = flatten(*branch.second);
+		scratch.push_back(statement);
+	};
+	branch(node.if_branch);
+	for (auto& elif_branch : node.elif_branches) {
+		branch(elif_branch);
+	}
+	auto else_branch = flatten_optional(node.else_branch);
+	set(index, append_list(start), else_branch);
+}
+
+void Flattener::visit(WhileStatement& node) {
+	auto index = add(Kind::WHILE);
+	auto condition = flatten(*node.condition);
+	set(index, condition, flatten(*node.statement));
+}
+
+void Flattener::visit(RepeatStatement& node) {
+	auto index = add(Kind::REPEAT);
+	set(index, flatten(*node.statement));
+}
+
+void Flattener::visit(ForStatement&) {
+	add(Kind::FOR);
+}
+
+void Flattener::visit(ReturnStatement& node) {
+	auto index = add(Kind::RETURN);
+	set(index, flatten_optional(node.expression));
+}
+
+void Flattener::visit(BreakStatement&) {
+	add(Kind::BREAK);
+}
+
+void Flattener::visit(ContinueStatement&) {
+	add(Kind::CONTINUE);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Flattener::visit(BinaryOperation& node) {
+	auto index = add(Kind::BINARY, node.op);
+	auto lhs = flatten(*node.lhs);
+	set(index, lhs, flatten(*node.rhs));
+}
+
+void Flattener::visit(PrefixExpression& node) {
+	auto index = add(Kind::PREFIX, node.op);
+	set(index, flatten(*node.base));
+}
+
+void Flattener::visit(PostfixIncrementExpression& node) {
+	auto index = add(Kind::POSTFIX_INCREMENT);
+	set(index, flatten(*node.base));
+}
+
+void Flattener::visit(PostfixDecrementExpression& node) {
+	auto index = add(Kind::POSTFIX_DECREMENT);
+	set(index, flatten(*node.base));
+}
+
+void Flattener::visit(FunctionCallExpression& node) {
+	auto index = add(Kind::CALL);
+	auto base = flatten(*node.base);
+	set(index, base, flatten_list(node.args));
+}
+
+void Flattener::visit(SubscriptExpression& node) {
+	auto index = add(Kind::SUBSCRIPT);
+	auto base = flatten(*node.base);
+	set(index, base, flatten(*node.index));
+}
+
+void Flattener::visit(IntLiteral& node) {
+	set(add(Kind::INT_LITERAL), static_cast<Index>(node.value));
+}
+
+void Flattener::visit(FloatLiteral& node) {
+	set(add(Kind::FLOAT_LITERAL), std::bit_cast<Index>(node.value));
+}
+
+void Flattener::visit(CharLiteral& node) {
+	set(add(Kind::CHAR_LITERAL), static_cast<unsigned char>(node.value));
+}
+
+void Flattener::visit(StringLiteral& node) {
+	set(add(Kind::STRING_LITERAL), string(node.value));
+}
+
+void Flattener::visit(BoolLiteral& node) {
+	set(add(Kind::BOOL_LITERAL), node.value);
+}
+
+void Flattener::visit(IdentifierExpression& node) {
+	set(add(Kind::IDENTIFIER), string(node.name));
+}
+
+void Flattener::visit(ParenthesizedExpression& node) {
+	auto index = add(Kind::PARENTHESIZED);
+	set(index, flatten(*node.expression));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct FlatPrinter {
+	using Index = FlatTree::Index;
+	using Kind = FlatTree::Kind;
+
+	const FlatTree& tree;
+	OutputBuffer out;
+
+	void print_list(std::span<const Index> nodes) {
+		for (std::size_t i = 0, size = nodes.size(); i < size; ++i) {
+			print(nodes[i]);
+			if (i != size - 1) {
+				out << ", ";
+			}
+		}
+	}
+
+	void print(Index node) {
+		auto [lhs, rhs] = tree.data(node);
+		switch (tree.kind(node)) {
+			case Kind::VAR_DECLARATION:
+				out << tree.string(lhs) << " ";
+				print_list(tree.list(rhs));
+				out << ";";
+				break;
+			case Kind::PARAMETER_DECLARATION:
+				out << tree.string(lhs) << " ";
+				print(rhs);
+				break;
+			case Kind::FUNC_DECLARATION: {
+				out << tree.string(lhs) << " ";
+				print(tree.extra_at(rhs));
+				out << "(";
+				print_list(tree.list(rhs + 2));
+				out << ")";
+				auto body = tree.extra_at(rhs + 1);
+				if (body != FlatTree::none) {
+					print(body);
+				} else {
+					out << ";";
+				}
+				break;
+			}
+			case Kind::POINTER_DECLARATOR:
+				out << "*" << tree.string(lhs);
+				break;
+			case Kind::NAME_DECLARATOR:
+				out << tree.string(lhs);
+				break;
+			case Kind::ARRAY_DECLARATOR:
+				out << tree.string(lhs) << "[";
+				if (rhs != FlatTree::none) {
+					print(rhs);
+				}
+				out << "]";
+				break;
+			case Kind::INIT_DECLARATOR:
+				print(lhs);
+				if (rhs != FlatTree::none) {
+					out << " = ";
+					print(rhs);
+				}
+				break;
+			case Kind::COMPOUND:
+				out << " {\n";
+				for (auto statement : tree.list(lhs)) {
+					print(statement);
+					out << '\n';
+				}
+				out << "}";
+				break;
+			case Kind::CONDITIONAL: {
+				auto branches = tree.list(lhs);
+				for (std::size_t i = 0; i < branches.size(); i += 2) {
+					out << (i == 0 ? "if (" : "elif (");
+					print(branches[i]);
+					out << ")";
+					print(branches[i + 1]);
+				}
+				if (rhs != FlatTree::none) {
+					out << "else";
+					print(rhs);
+				}
+				break;
+			}
+			case Kind::WHILE:
+				out << "while (";
+				print(lhs);
+				out << ")";
+				print(rhs);
+				break;
+			case Kind::REPEAT:
+				out << "repeat";
+				print(lhs);
+				break;
+			case Kind::FOR:
+				break;
+			case Kind::RETURN:
+				out << "return";
+				if (lhs != FlatTree::none) {
+					out << " ";
+					print(lhs);
+				}
+				out << ";";
+				break;
+			case Kind::BREAK:
+				out << "break;";
+				break;
+			case Kind::CONTINUE:
+				out << "continue;";
+				break;
+			case Kind::DECLARATION_STATEMENT:
+				print(lhs);
+				break;
+			case Kind::EXPRESSION_STATEMENT:
+				print(lhs);
+				out << ";";
+				break;
+			case Kind::BINARY:
+				print(lhs);
+				out << " " << Token::spelling(tree.op(node)) << " ";
+				print(rhs);
+				break;
+			case Kind::PREFIX:
+				out << Token::spelling(tree.op(node));
+				print(lhs);
+				break;
+			case Kind::POSTFIX_INCREMENT:
+				print(lhs);
+				out << "++";
+				break;
+			case Kind::POSTFIX_DECREMENT:
+				print(lhs);
+				out << "--";
+				break;
+			case Kind::CALL:
+				print(lhs);
+				out << "(";
+				print_list(tree.list(rhs));
+				out << ")";
+				break;
+			case Kind::SUBSCRIPT:
+				print(lhs);
+				out << "[";
+				print(rhs);
+				out << "]";
+				break;
+			case Kind::INT_LITERAL:
+				out << static_cast<int>(lhs);
+				break;
+			case Kind::FLOAT_LITERAL:
+				out << tree.float_value(node);
+				break;
+			case Kind::CHAR_LITERAL:
+				out << static_cast<char>(lhs);
+				break;
+			case Kind::BOOL_LITERAL:
+				out << (lhs ? "true" : "false");
+				break;
+			case Kind::STRING_LITERAL:
+				out << escape(tree.string(lhs));
+				break;
+			case Kind::IDENTIFIER:
+				out << tree.string(lhs);
+				break;
+			case Kind::PARENTHESIZED:
+				out << "(";
+				print(lhs);
+				out << ")";
+				break;
+		}
+	}
+};
+
+constexpr std::string_view kind_names[] = {
+#define FLAT_KIND_NAME(name) #name,
+	FLAT_KINDS(FLAT_KIND_NAME)
+#undef FLAT_KIND_NAME
+};
+
+}
+
+FlatTree::FlatTree(TranslationUnit& unit) {
+	// Every node is an arena object, so this never falls short
+	auto objects = unit.arena.stats().objects;
+	kinds.reserve(objects);
+	operators.reserve(objects);
+	fields.reserve(objects);
+	ends.reserve(objects);
+	Flattener(*this).flatten(unit);
+}
+
+std::size_t FlatTree::bytes() const {
+	return kinds.size() * (sizeof(Kind) + sizeof(std::uint8_t) + sizeof(Data) + sizeof(Index))
+		+ (extra.size() + roots.size()) * sizeof(Index) + strings.size() * sizeof(std::string_view);
+}
+
+std::string_view FlatTree::name(Kind kind) {
+	return kind_names[static_cast<std::size_t>(kind)];
+}
+
+void FlatTree::print(std::ostream& sink) const {
+	FlatPrinter printer{*this, OutputBuffer(sink)};
+	for (auto declaration : roots) {
+		printer.print(declaration);
+	}
+	printer.out << '\n';
+	printer.out.flush();
+}
+
+void FlatTree::dump(std::ostream& sink) const {
+	OutputBuffer out(sink);
+	for (Index node = 0; node < size(); ++node) {
+		auto lhs = fields[node].lhs;
+		out << static_cast<std::size_t>(node) << " " << name(kinds[node]);
+		switch (kinds[node]) {
+			case Kind::VAR_DECLARATION: case Kind::PARAMETER_DECLARATION: case Kind::FUNC_DECLARATION:
+			case Kind::POINTER_DECLARATOR: case Kind::NAME_DECLARATOR: case Kind::ARRAY_DECLARATOR:
+			case Kind::IDENTIFIER:
+				out << " " << strings[lhs];
+				break;
+			case Kind::STRING_LITERAL:
+				out << " " << escape(strings[lhs]);
+				break;
+			case Kind::BINARY: case Kind::PREFIX:
+				out << " " << Token::spelling(op(node));
+				break;
+			case Kind::INT_LITERAL:
+				out << " " << static_cast<int>(lhs);
+				break;
+			case Kind::FLOAT_LITERAL:
+				out << " " << float_value(node);
+				break;
+			case Kind::CHAR_LITERAL:
+				out << " " << static_cast<int>(lhs);
+				break;
+			case Kind::BOOL_LITERAL:
+				out << (lhs ? " true" : " false");
+				break;
+			default:
+				break;
+		}
+		for_each_child(node, [&](Index child) { out << " " << static_cast<std::size_t>(child); });
+		out << '\n';
+	}
+	out.flush();
+}
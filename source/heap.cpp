@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "heap.hpp"
+#include "array.hpp"
+
+static thread_local Heap* current_heap = nullptr;
+
+Heap::Scope::Scope(Heap& heap) : previous(current_heap) {
+	current_heap = &heap;
+}
+
+Heap::Scope::~Scope() {
+	current_heap = previous;
+}
+
+Heap::Heap(std::size_t nursery_size) : nursery_size(nursery_size), old_limit(2 * nursery_size) {}
+
+Heap::~Heap() {
+	for (auto array : young) {
+		delete array;
+	}
+	for (auto array : old) {
+		delete array;
+	}
+}
+
+Heap& Heap::current() {
+	if (!current_heap) {
+		throw std::runtime_error("Arrays can only be made while a program runs");
+	}
+	return *current_heap;
+}
+
+void Heap::adopt(Array* array) {
+	young.push_back(array);
+	resized(*array, sizeof(Array));
+}
+
+void Heap::resized(const Array& array, std::ptrdiff_t bytes) {
+	(array.old ? old_bytes : young_bytes) += bytes;
+	if (bytes > 0) {
+		statistics.allocated_bytes += bytes;
+	}
+	statistics.peak_bytes = std::max(statistics.peak_bytes, young_bytes + old_bytes);
+}
+
+// The old generation goes first, so arrays promoted now are not swept as
+// unmarked before their next collection.
+void Heap::sweep(std::chrono::steady_clock::time_point start) {
+	std::size_t freed = 0;
+	if (major) {
+		old_bytes = 0;
+		std::erase_if(old, [&](Array* array) {
+			auto bytes = array->bytes();
+			if (!array->marked) {
+				freed += bytes;
+				delete array;
+				return true;
+			}
+			array->marked = false;
+			old_bytes += bytes;
+			return false;
+		});
+	}
+	for (auto array : young) {
+		auto bytes = array->bytes();
+		if (array->marked) {
+			array->marked = false;
+			array->old = true;
+			old.push_back(array);
+			old_bytes += bytes;
+			statistics.promoted_bytes += bytes;
+		} else {
+			freed += bytes;
+			delete array;
+		}
+	}
+	young.clear();
+	young_bytes = 0;
+	statistics.freed_bytes += freed;
+
+	if (major) {
+		old_limit = std::max(2 * old_bytes, 2 * nursery_size);
+		++statistics.major_collections;
+	} else {
+		++statistics.minor_collections;
+	}
+	auto pause = std::chrono::steady_clock::now() - start;
+	statistics.pause += pause;
+	statistics.longest_pause = std::max<std::chrono::nanoseconds>(statistics.longest_pause, pause);
+}
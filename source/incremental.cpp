@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "incremental.hpp"
+#include "parallel_parser.hpp"
+#include "parser.hpp"
+#include "lexer.hpp"
+
+std::unique_ptr<TranslationUnit> IncrementalParser::parse(std::string_view source) {
+	auto unit = std::make_unique<TranslationUnit>();
+	std::vector<Declaration*> declarations;
+	std::vector<std::size_t> extents;
+	std::size_t begin = 0;
+	for (auto end = ParallelParser::boundary(source, 0); end != std::string_view::npos; end = ParallelParser::boundary(source, end)) {
+		declarations.push_back(parse_chunk(*unit, source, begin, end).front());
+		extents.push_back(end);
+		begin = end;
+	}
+	parse_chunk(*unit, source, begin, std::string_view::npos);
+	unit->declarations = unit->arena.copy(declarations);
+	unit->extents = unit->arena.copy(extents);
+	return unit;
+}
+
+std::size_t IncrementalParser::reparse(TranslationUnit& unit, std::string_view source, const Edit& edit) {
+	auto old_extents = unit.extents;
+	if (edit.offset + edit.inserted > source.size()) {
+		throw std::runtime_error("Edit is outside of the source");
+	}
+	auto delta = static_cast<std::ptrdiff_t>(edit.inserted) - static_cast<std::ptrdiff_t>(edit.removed);
+	auto edit_end = edit.offset + edit.inserted;
+
+	// Declarations before `first` end before the edit and are kept as they are.
+	std::size_t first = std::upper_bound(old_extents.begin(), old_extents.end(), edit.offset) - old_extents.begin();
+	std::size_t begin = first > 0 ? old_extents[first - 1] : 0;
+
+	// Rescan until a boundary past the edit lands on an old boundary: from
+	// there on the text, and so the split, is the same as before.
+	std::vector<Declaration*> declarations;
+	std::vector<std::size_t> extents;
+	std::size_t last = old_extents.size();
+	std::size_t old = first;
+	for (auto end = ParallelParser::boundary(source, begin); ; end = ParallelParser::boundary(source, end)) {
+		if (end == std::string_view::npos) {
+			parse_chunk(unit, source, begin, std::string_view::npos);
+			break;
+		}
+		declarations.push_back(parse_chunk(unit, source, begin, end).front());
+		extents.push_back(end);
+		begin = end;
+		if (end < edit_end) {
+			continue;
+		}
+		auto old_end = static_cast<std::size_t>(end - delta);
+		while (old < old_extents.size() && old_extents[old] < old_end) {
+			++old;
+		}
+		if (old < old_extents.size() && old_extents[old] == old_end) {
+			last = old + 1;
+			break;
+		}
+	}
+
+	auto reparsed = declarations.size();
+	if (reparsed == last - first) {
+		std::copy(declarations.begin(), declarations.end(), unit.declarations.begin() + first);
+		std::copy(extents.begin(), extents.end(), unit.extents.begin() + first);
+		for (auto i = last; i < unit.extents.size(); ++i) {
+			unit.extents[i] += delta;
+			unit.declarations[i]->offset += delta;
+		}
+		return reparsed;
+	}
+
+	std::vector<Declaration*> all_declarations(unit.declarations.begin(), unit.declarations.begin() + first);
+	std::vector<std::size_t> all_extents(unit.extents.begin(), unit.extents.begin() + first);
+	all_declarations.insert(all_declarations.end(), declarations.begin(), declarations.end());
+	all_extents.insert(all_extents.end(), extents.begin(), extents.end());
+	for (auto i = last; i < unit.extents.size(); ++i) {
+		unit.declarations[i]->offset += delta;
+		all_declarations.push_back(unit.declarations[i]);
+		all_extents.push_back(unit.extents[i] + delta);
+	}
+	unit.declarations = unit.arena.copy(all_declarations);
+	unit.extents = unit.arena.copy(all_extents);
+	return reparsed;
+}
+
+// A chunk between two boundaries holds exactly one declaration; the text
+// after the last boundary (end is npos) may only hold whitespace and comments.
+std::vector<Declaration*> IncrementalParser::parse_chunk(TranslationUnit& unit, std::string_view source, std::size_t begin, std::size_t end) {
+	bool tail = end == std::string_view::npos;
+	auto chunk = source.substr(begin, tail ? end : end - begin);
+	auto declarations = Parser(TokenStream(Lexer(chunk, begin))).parse_declarations(unit.arena);
+	if (declarations.size() != (tail ? 0 : 1)) {
+		throw std::runtime_error(tail ? "Unterminated declaration at end of input" : "Expected one declaration per top-level statement");
+	}
+	return declarations;
+}
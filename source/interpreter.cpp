@@ -1,41 +1,252 @@
-#include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
-#include <sstream>
+#include <optional>
+#include <utility>
 
 #include "interpreter.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "parallel_parser.hpp"
+#include "counter.hpp"
 #include "printer.hpp"
+#include "sexp_printer.hpp"
+#include "flat_ast.hpp"
+#include "source.hpp"
+#include "resolver.hpp"
+#include "optimizer.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "cache.hpp"
+#include "evaluator.hpp"
 
-void Interpreter::interpret(const std::string& source_code) {
+Interpreter::Interpreter() : Interpreter(Options()) {}
+
+Interpreter::Interpreter(
+	const Options& options,
+	std::ostream& output,
+	std::ostream& errors
+	) : options(options), output(output), errors(errors), statistics(options.stats) {}
+
+int Interpreter::interpret(std::string_view source_code) {
+	source = source_code;
+	AllocationLimit limit(options.memory_limit);
+	if (options.check) {
+		return finish(check(source_code));
+	}
+	try {
+		std::optional<ProgramCache> cache;
+		if (options.engine == Engine::VM && options.dump_ast == DumpFormat::NONE) {
+			if (options.memory_cache) {
+				if (auto program = options.memory_cache->find(source_code, options.optimize)) {
+					statistics.note("cache", "memory");
+					return execute(*program);
+				}
+			}
+			if (!options.cache_directory.empty()) {
+				cache.emplace(options.cache_directory, source_code, options.optimize);
+				if (auto program = statistics.measure("cache_load", [&] { return cache->load(); })) {
+					statistics.note("cache", "hit");
+					if (options.memory_cache) {
+						return execute(*options.memory_cache->insert(source_code, options.optimize, std::move(*program)));
+					}
+					return execute(*program);
+				}
+				statistics.note("cache", "miss");
+			}
+		}
+
+		if (statistics.active()) {
+			// Measured on its own, since the Parser pulls tokens lazily: the
+			// parse phase below includes lexing the source again
+			statistics.count("tokens", statistics.measure("lex", [&] {
+				Lexer lexer(source_code);
+				long long tokens = 0;
+				while (lexer.next().type != Token::END) {
+					++tokens;
+				}
+				return tokens;
+			}));
+		}
+		auto root = statistics.measure("parse", [&] { return parse(source_code); });
+		if (statistics.active()) {
+			statistics.count("nodes", NodeCounter().count(*root));
+			statistics.count("arena_bytes", root->arena.stats().bytes_used);
+		}
+		if (options.optimize) {
+			statistics.measure("optimize", [&] { optimize(*root); });
+		}
+		if (options.dump_ast == DumpFormat::SOURCE) {
+			statistics.measure("dump", [&] {
+				Printer printer(output);
+				root->accept(printer);
+			});
+			return finish(0);
+		} else if (options.dump_ast == DumpFormat::SEXP) {
+			statistics.measure("dump", [&] {
+				SexpPrinter printer(output);
+				root->accept(printer);
+			});
+			return finish(0);
+		} else if (options.dump_ast == DumpFormat::FLAT) {
+			statistics.measure("dump", [&] { FlatTree(*root).dump(output); });
+			return finish(0);
+		}
+		statistics.measure("resolve", [&] { Resolver().resolve(*root); });
+		if (options.engine == Engine::AST) {
+			Evaluator evaluator(output, start_profiler(), options.recursion_limit ? options.recursion_limit : SIZE_MAX, options.nursery_size, options.stop);
+			auto status = run([&] { return evaluator.run(*root); });
+			count_calls(evaluator);
+			count_collections(evaluator.heap_stats());
+			return finish(status);
+		}
+		auto program = statistics.measure("compile", [&] { return Compiler().compile(*root); });
+		if (statistics.active()) {
+			long long instructions = 0;
+			for (auto& function : program.functions) {
+				instructions += function.code.size();
+			}
+			statistics.count("instructions", instructions);
+		}
+		if (cache) {
+			statistics.measure("cache_store", [&] {
+				try {
+					cache->store(program);
+				} catch (const std::exception& e) {
+					errors << "Warning: " << e.what() << std::endl;
+				}
+			});
+		}
+		if (options.memory_cache) {
+			return execute(*options.memory_cache->insert(source_code, options.optimize, std::move(program)));
+		}
+		return execute(program);
+	} catch (const std::exception& e) {
+		fail(e);
+		return finish(1);
+	}
+}
+
+int Interpreter::interpret_file(const std::string& filepath) {
+	std::optional<SourceBuffer> source;
 	try {
-		auto tokens = tokenize(source_code);
-		auto root = parse(tokens);
-		Printer printer;
-		root->accept(printer);
+		statistics.measure("read", [&] { source.emplace(filepath); });
 	} catch (const std::exception& e) {
-		std::cerr << "Error: " << e.what() << std::endl;
+		errors << e.what() << std::endl;
+		statistics.note("error", e.what());
+		return finish(1);
 	}
+	statistics.count("bytes", source->view().size());
+	name = filepath;
+	return interpret(source->view());
+}
+
+std::unique_ptr<TranslationUnit> Interpreter::parse(std::string_view sourceCode) {
+    // Top-level declarations are lexed and parsed on parse_threads threads,
+    // or on this one alone under a memory limit, which counts only this
+    // thread's allocations
+    return ParallelParser(sourceCode, options.memory_limit ? 1 : options.parse_threads).parse();
 }
 
-void Interpreter::interpret_file(const std::string& filepath) {
-	std::ifstream file(filepath);
-	if (!file.is_open()) {
-		std::cerr << "Failed to open file: " << filepath << std::endl;
-		return;
+// One sequential pass that throws nothing: the ParallelParser would only
+// add threads to a pool that batch mode already keeps busy.
+int Interpreter::check(std::string_view source_code) {
+	std::vector<Diagnostic> diagnostics;
+	statistics.measure("parse", [&] { Parser(TokenStream(Lexer(source_code, 0, &diagnostics)), &diagnostics).parse(); });
+	// Lexer diagnostics are recorded as the Parser looks ahead, so a few may
+	// come before those of earlier tokens
+	std::stable_sort(diagnostics.begin(), diagnostics.end(), [](auto& lhs, auto& rhs) { return lhs.offset < rhs.offset; });
+	LineTable lines(source_code);
+	for (auto& diagnostic : diagnostics) {
+		errors << name << ':' << lines.line(diagnostic.offset) << ':' << lines.column(diagnostic.offset) << ": " << diagnostic.message << '\n';
 	}
+	statistics.count("diagnostics", diagnostics.size());
+	return diagnostics.empty() ? 0 : 1;
+}
 
-	std::stringstream input;
-	input << file.rdbuf();
-	interpret(input.str());
+void Interpreter::optimize(TranslationUnit& unit) {
+	Resolver().resolve(unit);
+	auto eliminated = Optimizer().optimize(unit);
+	statistics.count("eliminated_nodes", eliminated);
+	errors << "Optimizer: eliminated " << eliminated << " nodes" << std::endl;
 }
 
-std::vector<Token> Interpreter::tokenize(const std::string& sourceCode) {
-    // Delegate to the Lexer to generate tokens from the source code
-    return Lexer(sourceCode).tokenize();
+int Interpreter::execute(const Program& program) {
+	VirtualMachine machine(program, output, start_profiler(), options.recursion_limit ? options.recursion_limit : SIZE_MAX, options.jit, options.nursery_size, options.stop);
+	auto status = run([&] { return machine.run(); });
+	count_calls(machine);
+	count_collections(machine.heap_stats());
+	if (options.jit_stats) {
+		output.flush();
+		machine.write_jit_report(errors);
+	}
+	return finish(status);
 }
 
-std::shared_ptr<TranslationUnit> Interpreter::parse(const std::vector<Token>& tokens) {
-    // Use the Parser to generate an AST from the tokens
-    return Parser(tokens).parse();
-}
\ No newline at end of file
+// A run that fails still has its counters and JIT report written, so the
+// error is reported here rather than by interpret()
+template<typename Function>
+int Interpreter::run(Function&& function) {
+	try {
+		return statistics.measure("run", function);
+	} catch (const std::exception& e) {
+		fail(e);
+		return 1;
+	}
+}
+
+void Interpreter::fail(const std::exception& e) {
+	errors << "Error: " << e.what() << std::endl;
+	statistics.note("error", e.what());
+}
+
+template<typename Machine>
+void Interpreter::count_calls(const Machine& engine) {
+	statistics.count("call_cache_hits", engine.call_cache_hits());
+	statistics.count("call_cache_misses", engine.call_cache_misses());
+}
+
+void Interpreter::count_collections(const Heap::Stats& heap) {
+	using std::chrono::microseconds, std::chrono::duration_cast;
+	statistics.count("gc_minor_collections", heap.minor_collections);
+	statistics.count("gc_major_collections", heap.major_collections);
+	statistics.count("gc_pause_us", duration_cast<microseconds>(heap.pause).count());
+	statistics.count("gc_longest_pause_us", duration_cast<microseconds>(heap.longest_pause).count());
+	statistics.count("heap_allocated_bytes", heap.allocated_bytes);
+	statistics.count("heap_promoted_bytes", heap.promoted_bytes);
+	statistics.count("heap_freed_bytes", heap.freed_bytes);
+	statistics.count("heap_peak_bytes", heap.peak_bytes);
+}
+
+Profiler* Interpreter::start_profiler() {
+	if (options.profile) {
+		profiler = std::make_unique<Profiler>();
+	}
+	return profiler.get();
+}
+
+int Interpreter::finish(int status) {
+	if (profiler) {
+		output.flush();
+		profiler->write_report(errors, LineTable(source));
+		if (std::ofstream file(options.profile_path); file) {
+			profiler->write_folded(file);
+		} else {
+			errors << "Warning: Failed to write profile to " << options.profile_path << std::endl;
+		}
+		profiler.reset();
+	}
+	if (!statistics.active()) {
+		return status;
+	}
+	statistics.count("exit_status", status);
+	if (options.stats_path.empty()) {
+		output.flush();
+		statistics.write(errors);
+	} else if (std::ofstream file(options.stats_path); file) {
+		statistics.write(file);
+	} else {
+		errors << "Warning: Failed to write statistics to " << options.stats_path << std::endl;
+	}
+	return status;
+}
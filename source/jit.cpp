@@ -0,0 +1,841 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.hpp"
+
+static constexpr const char* opcode_names[] = {
+#define OPCODE_NAME(name) #name,
+	OPCODES(OPCODE_NAME)
+#undef OPCODE_NAME
+};
+
+namespace {
+
+// A local whose type depends on the path that reached an instruction
+constexpr auto CONFLICT = static_cast<ValueType>(0xff);
+
+bool numeric(ValueType type) {
+	return type == ValueType::INT || type == ValueType::DOUBLE || type == ValueType::CHAR || type == ValueType::BOOL;
+}
+
+// int, char and bool operands are computed with as ints, as in value.cpp
+ValueType arithmetic_type(ValueType lhs, ValueType rhs) {
+	return lhs == ValueType::DOUBLE || rhs == ValueType::DOUBLE ? ValueType::DOUBLE : ValueType::INT;
+}
+
+struct State {
+	bool reached = false;
+	std::vector<ValueType> locals;
+	std::vector<ValueType> operands;
+};
+
+// The types at the start of every instruction reachable from the function's
+// entry. Throws with the reason when some instruction cannot be compiled.
+std::vector<State> analyze(const Function& function, const Program& program) {
+	auto& code = function.code;
+	std::vector<State> states(code.size());
+	if (code.empty() || function.parameter_types.size() > function.frame_size) {
+		throw std::runtime_error("malformed function");
+	}
+	states[0].reached = true;
+	states[0].locals.assign(function.frame_size, ValueType::NONE);
+	std::copy(function.parameter_types.begin(), function.parameter_types.end(), states[0].locals.begin());
+
+	std::vector<std::size_t> work{0};
+	while (!work.empty()) {
+		auto at = work.back();
+		work.pop_back();
+		auto state = states[at];
+		auto& instruction = code[at];
+		auto& operands = state.operands;
+
+		auto reject = [&](const std::string& what) {
+			throw std::runtime_error(std::string(opcode_names[static_cast<std::size_t>(instruction.op)]) + " at " + std::to_string(at) + " " + what);
+		};
+		auto pop = [&] {
+			if (operands.empty()) {
+				reject("underflows the operand stack");
+			}
+			auto type = operands.back();
+			operands.pop_back();
+			return type;
+		};
+		auto pop_numeric = [&] {
+			auto type = pop();
+			if (!numeric(type)) {
+				reject("takes a " + std::string(type_name(type)) + " operand");
+			}
+			return type;
+		};
+		auto local = [&]() -> ValueType& {
+			if (instruction.operand < 0 || static_cast<std::size_t>(instruction.operand) >= state.locals.size()) {
+				reject("addresses no local");
+			}
+			return state.locals[instruction.operand];
+		};
+		auto target = [&] {
+			if (instruction.operand < 0 || static_cast<std::size_t>(instruction.operand) >= code.size()) {
+				reject("jumps out of the function");
+			}
+			return static_cast<std::size_t>(instruction.operand);
+		};
+
+		bool falls_through = true;
+		std::size_t branch = SIZE_MAX;
+		switch (instruction.op) {
+			case OpCode::CONSTANT: {
+				auto type = type_of(program.constants.at(instruction.operand));
+				if (type == ValueType::STRING) {
+					reject("loads a string");
+				}
+				operands.push_back(type);
+				break;
+			}
+			case OpCode::POP:
+				pop();
+				break;
+			case OpCode::DUP: {
+				auto type = pop();
+				operands.push_back(type);
+				operands.push_back(type);
+				break;
+			}
+			case OpCode::LOAD_LOCAL: {
+				auto type = local();
+				if (!numeric(type)) {
+					reject("reads a local that is " + std::string(type_name(type)) + " here");
+				}
+				operands.push_back(type);
+				break;
+			}
+			case OpCode::STORE_LOCAL: {
+				auto type = pop();
+				local() = type;
+				break;
+			}
+			case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::DIVIDE: case OpCode::MODULO: {
+				auto rhs = pop_numeric();
+				auto lhs = pop_numeric();
+				operands.push_back(arithmetic_type(lhs, rhs));
+				break;
+			}
+			case OpCode::POWER: {
+				auto rhs = pop_numeric();
+				auto lhs = pop_numeric();
+				if (arithmetic_type(lhs, rhs) == ValueType::INT) {
+					reject("of two ints has a type that depends on the exponent");
+				}
+				operands.push_back(ValueType::DOUBLE);
+				break;
+			}
+			case OpCode::SHIFT_LEFT: case OpCode::SHIFT_RIGHT: {
+				auto rhs = pop_numeric();
+				auto lhs = pop_numeric();
+				if (arithmetic_type(lhs, rhs) == ValueType::DOUBLE) {
+					reject("takes a double operand");
+				}
+				operands.push_back(ValueType::INT);
+				break;
+			}
+			case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::LESS:
+			case OpCode::LESS_EQUAL: case OpCode::GREATER: case OpCode::GREATER_EQUAL:
+				pop_numeric();
+				pop_numeric();
+				operands.push_back(ValueType::BOOL);
+				break;
+			case OpCode::NEGATE: case OpCode::PLUS:
+				operands.push_back(pop_numeric() == ValueType::DOUBLE ? ValueType::DOUBLE : ValueType::INT);
+				break;
+			case OpCode::NOT:
+				pop_numeric();
+				operands.push_back(ValueType::BOOL);
+				break;
+			case OpCode::CONVERT: {
+				auto to = static_cast<ValueType>(instruction.operand);
+				auto from = pop();
+				if (to != ValueType::NONE && to != from && (!numeric(from) || !numeric(to))) {
+					reject("from " + std::string(type_name(from)) + " to " + std::string(type_name(to)));
+				}
+				operands.push_back(to);
+				break;
+			}
+			case OpCode::JUMP: case OpCode::LOOP:
+				branch = target();
+				falls_through = false;
+				break;
+			case OpCode::JUMP_IF_FALSE:
+				pop_numeric();
+				branch = target();
+				break;
+			case OpCode::JUMP_UNLESS_EQUAL: case OpCode::JUMP_UNLESS_NOT_EQUAL: case OpCode::JUMP_UNLESS_LESS:
+			case OpCode::JUMP_UNLESS_LESS_EQUAL: case OpCode::JUMP_UNLESS_GREATER: case OpCode::JUMP_UNLESS_GREATER_EQUAL:
+				pop_numeric();
+				pop_numeric();
+				branch = target();
+				break;
+			case OpCode::RETURN:
+				pop();
+				falls_through = false;
+				break;
+			case OpCode::INCREMENT_LOCAL: case OpCode::DECREMENT_LOCAL: {
+				auto type = local();
+				if (type != ValueType::INT && type != ValueType::DOUBLE && type != ValueType::CHAR) {
+					reject("updates a local that is " + std::string(type_name(type)) + " here");
+				}
+				break;
+			}
+			default:
+				reject("is not supported");
+		}
+
+		auto flow = [&](std::size_t successor) {
+			auto& next = states[successor];
+			if (!next.reached) {
+				next = state;
+				work.push_back(successor);
+				return;
+			}
+			if (next.operands != operands) {
+				reject("meets another path with different operand types at " + std::to_string(successor));
+			}
+			bool changed = false;
+			for (std::size_t i = 0; i < next.locals.size(); ++i) {
+				if (next.locals[i] != state.locals[i] && next.locals[i] != CONFLICT) {
+					next.locals[i] = CONFLICT;
+					changed = true;
+				}
+			}
+			if (changed) {
+				work.push_back(successor);
+			}
+		};
+		if (falls_through) {
+			if (at + 1 == code.size()) {
+				reject("runs off the end of the function");
+			}
+			flow(at + 1);
+		}
+		if (branch != SIZE_MAX) {
+			flow(branch);
+		}
+	}
+	return states;
+}
+
+#if defined(__x86_64__)
+#define JIT_NATIVE 1
+
+enum Register : std::uint8_t {
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7, R12 = 12
+};
+
+enum Condition : std::uint8_t {
+	BELOW_OR_EQUAL = 0x6, ABOVE = 0x7, EQUAL = 0x4, NOT_EQUAL = 0x5, PARITY = 0xA, NO_PARITY = 0xB,
+	LESS = 0xC, GREATER_OR_EQUAL = 0xD, LESS_OR_EQUAL = 0xE, GREATER = 0xF
+};
+
+struct Memory {
+	Register base;
+	std::int32_t displacement;
+};
+
+// Just the x86-64 encodings the generator needs. Memory operands always
+// take a 32-bit displacement; XMM registers are passed by number.
+class Assembler {
+public:
+	std::vector<std::uint8_t> bytes;
+
+	std::size_t label() {
+		labels.push_back(SIZE_MAX);
+		return labels.size() - 1;
+	}
+
+	void bind(std::size_t label) {
+		labels[label] = bytes.size();
+	}
+
+	void resolve() {
+		for (auto [at, label] : fixups) {
+			auto displacement = static_cast<std::int32_t>(labels[label] - (at + 4));
+			std::memcpy(&bytes[at], &displacement, sizeof(displacement));
+		}
+	}
+
+	void byte(std::uint8_t value) {
+		bytes.push_back(value);
+	}
+
+	void dword(std::uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			byte(value >> (8 * i));
+		}
+	}
+
+	// prefix, REX, opcode, then a ModRM byte naming a register or memory
+	void emit(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode, int reg, int rm) {
+		header(prefix, wide, opcode, reg, rm);
+		byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+	}
+
+	void emit(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode, int reg, Memory memory) {
+		header(prefix, wide, opcode, reg, memory.base);
+		byte(0x80 | (reg & 7) << 3 | (memory.base & 7));
+		if ((memory.base & 7) == RSP) {
+			byte(0x24);
+		}
+		dword(memory.displacement);
+	}
+
+	void load(Register to, Memory from, bool wide = false) { emit(0, wide, {0x8B}, to, from); }
+	void store(Memory to, Register from, bool wide = false) { emit(0, wide, {0x89}, from, to); }
+	void load_signed_byte(Register to, Memory from) { emit(0, false, {0x0F, 0xBE}, to, from); }
+	void load_unsigned_byte(Register to, Memory from) { emit(0, false, {0x0F, 0xB6}, to, from); }
+	void store_byte(Memory to, std::uint8_t value) { emit(0, false, {0xC6}, 0, to); byte(value); }
+	void store_immediate(Memory to, std::int32_t value, bool wide = false) { emit(0, wide, {0xC7}, 0, to); dword(value); }
+	void move(Register to, Register from) { emit(0, true, {0x89}, from, to); }
+
+	void move(Register to, std::uint64_t value) {
+		header(0, value > UINT32_MAX, {}, 0, to);
+		byte(0xB8 | (to & 7));
+		dword(value);
+		if (value > UINT32_MAX) {
+			dword(value >> 32);
+		}
+	}
+
+	void set(Condition condition, Register to) {
+		emit(0, false, {0x0F, static_cast<std::uint8_t>(0x90 | condition)}, 0, to);
+	}
+
+	void jump(std::size_t label) {
+		byte(0xE9);
+		reference(label);
+	}
+
+	void jump_if(Condition condition, std::size_t label) {
+		byte(0x0F);
+		byte(0x80 | condition);
+		reference(label);
+	}
+
+	void call(const void* function) {
+		move(RAX, reinterpret_cast<std::uint64_t>(function));
+		emit(0, false, {0xFF}, 2, RAX);
+	}
+
+	void load_double(int to, Memory from) { emit(0xF2, false, {0x0F, 0x10}, to, from); }
+	void store_double(Memory to, int from) { emit(0xF2, false, {0x0F, 0x11}, from, to); }
+	void convert_to_double(int to, Memory from) { emit(0xF2, false, {0x0F, 0x2A}, to, from); }
+	void compare_doubles(int lhs, int rhs) { emit(0x66, false, {0x0F, 0x2E}, lhs, rhs); }
+
+private:
+	void header(std::uint8_t prefix, bool wide, std::initializer_list<std::uint8_t> opcode, int reg, int rm) {
+		if (prefix) {
+			byte(prefix);
+		}
+		std::uint8_t rex = 0x40 | wide << 3 | (reg >> 3 & 1) << 2 | (rm >> 3 & 1);
+		if (rex != 0x40) {
+			byte(rex);
+		}
+		for (auto code : opcode) {
+			byte(code);
+		}
+	}
+
+	void reference(std::size_t label) {
+		fixups.emplace_back(bytes.size(), label);
+		dword(0);
+	}
+
+	std::vector<std::size_t> labels;
+	std::vector<std::pair<std::size_t, std::size_t>> fixups;
+};
+
+// Out-of-line operations, reusing the VM's semantics; none of them throw
+// for the doubles they are given.
+double floating_modulo(double lhs, double rhs) {
+	return modulo(lhs, rhs).as_double();
+}
+
+double floating_power(double lhs, double rhs) {
+	return power(lhs, rhs).as_double();
+}
+
+int truncate_double(double number) {
+	return convert(number, ValueType::INT).as_int();
+}
+
+// Native calling convention: locals in rdi, the entry instruction in esi
+// and the result in rdx, kept in rbx and r12. Operand i lives at [rsp+8i],
+// ints, chars and bools normalized to a 32-bit int, doubles as their bits.
+class Generator {
+public:
+	Generator(const Function& function, const Program& program, const std::vector<State>& states, const StopRequest* stop)
+		: function(function), program(program), states(states), stop(stop) {}
+
+	std::vector<std::uint8_t> generate(std::vector<std::uint32_t>& loop_entries) {
+		std::size_t depth = 0;
+		for (std::size_t at = 0; at < states.size(); ++at) {
+			depth = std::max(depth, states[at].operands.size() + 1);
+			auto& instruction = function.code[at];
+			if (states[at].reached && instruction.op == OpCode::LOOP && states[instruction.operand].operands.empty()
+				&& instruction.operand != 0 && std::find(loop_entries.begin(), loop_entries.end(), instruction.operand) == loop_entries.end()) {
+				loop_entries.push_back(instruction.operand);
+			}
+		}
+		// Keeps rsp 16-byte aligned for the out-of-line calls
+		auto frame = static_cast<std::int32_t>(depth * 8 % 16 ? depth * 8 : depth * 8 + 8);
+
+		for (std::size_t at = 0; at < states.size(); ++at) {
+			a.label();
+		}
+		epilogue = a.label();
+		division_by_zero = a.label();
+		shift_out_of_range = a.label();
+		stopped = a.label();
+
+		a.byte(0x53);
+		a.byte(0x41);
+		a.byte(0x54);
+		a.emit(0, true, {0x81}, 5, RSP);
+		a.dword(frame);
+		a.move(RBX, RDI);
+		a.move(R12, RDX);
+		for (auto entry : loop_entries) {
+			a.emit(0, false, {0x81}, 7, RSI);
+			a.dword(entry);
+			a.jump_if(EQUAL, entry);
+		}
+		loop_entries.push_back(0);
+		for (std::size_t at = 0; at < states.size(); ++at) {
+			a.bind(at);
+			if (states[at].reached) {
+				instruction(at);
+			}
+		}
+
+		a.bind(division_by_zero);
+		a.move(RAX, static_cast<std::uint64_t>(Jit::Status::DIVISION_BY_ZERO));
+		a.jump(epilogue);
+		a.bind(shift_out_of_range);
+		a.store_byte(result_tag(), static_cast<std::uint8_t>(ValueType::INT));
+		a.store(result_payload(), RCX, true);
+		a.move(RAX, static_cast<std::uint64_t>(Jit::Status::SHIFT_OUT_OF_RANGE));
+		a.jump(epilogue);
+		a.bind(stopped);
+		a.move(RAX, static_cast<std::uint64_t>(Jit::Status::STOPPED));
+		a.jump(epilogue);
+		a.bind(epilogue);
+		a.emit(0, true, {0x81}, 0, RSP);
+		a.dword(frame);
+		a.byte(0x41);
+		a.byte(0x5C);
+		a.byte(0x5B);
+		a.byte(0xC3);
+		a.resolve();
+		return std::move(a.bytes);
+	}
+
+private:
+	static Memory operand(std::size_t index) {
+		return {RSP, static_cast<std::int32_t>(8 * index)};
+	}
+
+	static Memory payload(std::size_t slot) {
+		return {RBX, static_cast<std::int32_t>(sizeof(Value) * slot + Jit::payload_offset)};
+	}
+
+	static Memory tag(std::size_t slot) {
+		return {RBX, static_cast<std::int32_t>(sizeof(Value) * slot + Jit::tag_offset)};
+	}
+
+	static Memory result_payload() {
+		return {R12, static_cast<std::int32_t>(Jit::payload_offset)};
+	}
+
+	static Memory result_tag() {
+		return {R12, static_cast<std::int32_t>(Jit::tag_offset)};
+	}
+
+	void instruction(std::size_t at) {
+		auto& state = states[at];
+		auto& instruction = function.code[at];
+		auto depth = state.operands.size();
+		auto top = depth - 1;
+		auto type = [&](std::size_t index) { return state.operands[index]; };
+
+		switch (instruction.op) {
+			case OpCode::CONSTANT: {
+				auto& value = program.constants[instruction.operand];
+				switch (type_of(value)) {
+					case ValueType::INT: a.store_immediate(operand(depth), value.as_int()); break;
+					case ValueType::CHAR: a.store_immediate(operand(depth), value.as_char()); break;
+					case ValueType::BOOL: a.store_immediate(operand(depth), value.as_bool()); break;
+					case ValueType::DOUBLE:
+						a.move(RAX, std::bit_cast<std::uint64_t>(value.as_double()));
+						a.store(operand(depth), RAX, true);
+						break;
+					default: break;
+				}
+				break;
+			}
+			case OpCode::POP:
+				break;
+			case OpCode::DUP:
+				a.load(RAX, operand(top), true);
+				a.store(operand(depth), RAX, true);
+				break;
+			case OpCode::LOAD_LOCAL: {
+				auto slot = instruction.operand;
+				switch (state.locals[slot]) {
+					case ValueType::DOUBLE: a.load(RAX, payload(slot), true); break;
+					case ValueType::CHAR: a.load_signed_byte(RAX, payload(slot)); break;
+					case ValueType::BOOL: a.load_unsigned_byte(RAX, payload(slot)); break;
+					default: a.load(RAX, payload(slot)); break;
+				}
+				a.store(operand(depth), RAX, true);
+				break;
+			}
+			case OpCode::STORE_LOCAL: {
+				auto slot = instruction.operand;
+				if (state.locals[slot] != type(top)) {
+					a.store_byte(tag(slot), static_cast<std::uint8_t>(type(top)));
+				}
+				store_value(payload(slot), top, type(top));
+				break;
+			}
+			case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::DIVIDE:
+			case OpCode::MODULO: case OpCode::POWER: case OpCode::SHIFT_LEFT: case OpCode::SHIFT_RIGHT:
+				arithmetic(instruction.op, depth - 2, type(depth - 2), type(top));
+				break;
+			case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::LESS:
+			case OpCode::LESS_EQUAL: case OpCode::GREATER: case OpCode::GREATER_EQUAL:
+				compare(instruction.op, depth - 2, type(depth - 2), type(top));
+				a.store(operand(depth - 2), RAX);
+				break;
+			case OpCode::NEGATE:
+				if (type(top) == ValueType::DOUBLE) {
+					a.load(RAX, operand(top), true);
+					// btc rax, 63
+					a.emit(0, true, {0x0F, 0xBA}, 7, RAX);
+					a.byte(63);
+					a.store(operand(top), RAX, true);
+				} else {
+					a.load(RAX, operand(top));
+					a.emit(0, false, {0xF7}, 3, RAX);
+					a.store(operand(top), RAX);
+				}
+				break;
+			case OpCode::PLUS:
+				break;
+			case OpCode::NOT:
+				truthy(top, type(top));
+				a.emit(0, false, {0x83}, 6, RAX);
+				a.byte(1);
+				a.store(operand(top), RAX);
+				break;
+			case OpCode::CONVERT:
+				convert(top, type(top), static_cast<ValueType>(instruction.operand));
+				break;
+			case OpCode::LOOP:
+				if (stop) {
+					// cmp qword [rax], 0
+					a.move(RAX, reinterpret_cast<std::uint64_t>(stop));
+					a.emit(0, true, {0x83}, 7, Memory{RAX, 0});
+					a.byte(0);
+					a.jump_if(NOT_EQUAL, stopped);
+				}
+				a.jump(instruction.operand);
+				break;
+			case OpCode::JUMP:
+				a.jump(instruction.operand);
+				break;
+			case OpCode::JUMP_IF_FALSE:
+				if (type(top) == ValueType::DOUBLE) {
+					truthy(top, type(top));
+				} else {
+					a.load(RAX, operand(top));
+				}
+				a.emit(0, false, {0x85}, RAX, RAX);
+				a.jump_if(EQUAL, instruction.operand);
+				break;
+			case OpCode::JUMP_UNLESS_EQUAL: case OpCode::JUMP_UNLESS_NOT_EQUAL: case OpCode::JUMP_UNLESS_LESS:
+			case OpCode::JUMP_UNLESS_LESS_EQUAL: case OpCode::JUMP_UNLESS_GREATER: case OpCode::JUMP_UNLESS_GREATER_EQUAL: {
+				static constexpr OpCode comparisons[] = {
+					OpCode::EQUAL, OpCode::NOT_EQUAL, OpCode::LESS, OpCode::LESS_EQUAL, OpCode::GREATER, OpCode::GREATER_EQUAL
+				};
+				auto comparison = comparisons[static_cast<std::size_t>(instruction.op) - static_cast<std::size_t>(OpCode::JUMP_UNLESS_EQUAL)];
+				compare(comparison, depth - 2, type(depth - 2), type(top));
+				a.emit(0, false, {0x85}, RAX, RAX);
+				a.jump_if(EQUAL, instruction.operand);
+				break;
+			}
+			case OpCode::RETURN:
+				a.store_byte(result_tag(), static_cast<std::uint8_t>(type(top)));
+				store_value(result_payload(), top, type(top));
+				a.emit(0, false, {0x31}, RAX, RAX);
+				a.jump(epilogue);
+				break;
+			case OpCode::INCREMENT_LOCAL: case OpCode::DECREMENT_LOCAL: {
+				auto slot = instruction.operand;
+				bool increment = instruction.op == OpCode::INCREMENT_LOCAL;
+				if (state.locals[slot] == ValueType::DOUBLE) {
+					a.load_double(0, payload(slot));
+					a.move(RAX, std::bit_cast<std::uint64_t>(1.0));
+					a.emit(0x66, true, {0x0F, 0x6E}, 1, RAX);
+					a.emit(0xF2, false, {0x0F, static_cast<std::uint8_t>(increment ? 0x58 : 0x5C)}, 0, 1);
+					a.store_double(payload(slot), 0);
+					break;
+				}
+				bool character = state.locals[slot] == ValueType::CHAR;
+				if (character) {
+					a.load_signed_byte(RAX, payload(slot));
+				} else {
+					a.load(RAX, payload(slot));
+				}
+				a.emit(0, false, {0x83}, increment ? 0 : 5, RAX);
+				a.byte(1);
+				if (character) {
+					a.emit(0, false, {0x0F, 0xB6}, RAX, RAX);
+				}
+				a.store(payload(slot), RAX, true);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	// Writes the operand as a Value's payload: ints and chars zero-extended
+	// like the payloads the Value constructors leave.
+	void store_value(Memory to, std::size_t index, ValueType type) {
+		switch (type) {
+			case ValueType::DOUBLE: a.load(RAX, operand(index), true); break;
+			case ValueType::CHAR: case ValueType::BOOL: a.load_unsigned_byte(RAX, operand(index)); break;
+			case ValueType::INT: a.load(RAX, operand(index)); break;
+			default: a.emit(0, false, {0x31}, RAX, RAX); break;
+		}
+		a.store(to, RAX, true);
+	}
+
+	void load_double(int to, std::size_t index, ValueType type) {
+		if (type == ValueType::DOUBLE) {
+			a.load_double(to, operand(index));
+		} else {
+			a.convert_to_double(to, operand(index));
+		}
+	}
+
+	// Result in the lower operand's place
+	void arithmetic(OpCode op, std::size_t lhs, ValueType lhs_type, ValueType rhs_type) {
+		if (arithmetic_type(lhs_type, rhs_type) == ValueType::DOUBLE) {
+			load_double(0, lhs, lhs_type);
+			load_double(1, lhs + 1, rhs_type);
+			switch (op) {
+				case OpCode::ADD: a.emit(0xF2, false, {0x0F, 0x58}, 0, 1); break;
+				case OpCode::MULTIPLY: a.emit(0xF2, false, {0x0F, 0x59}, 0, 1); break;
+				case OpCode::SUBTRACT: a.emit(0xF2, false, {0x0F, 0x5C}, 0, 1); break;
+				case OpCode::DIVIDE: a.emit(0xF2, false, {0x0F, 0x5E}, 0, 1); break;
+				case OpCode::MODULO: a.call(reinterpret_cast<const void*>(&floating_modulo)); break;
+				default: a.call(reinterpret_cast<const void*>(&floating_power)); break;
+			}
+			a.store_double(operand(lhs), 0);
+			return;
+		}
+		a.load(RAX, operand(lhs));
+		a.load(RCX, operand(lhs + 1));
+		switch (op) {
+			case OpCode::ADD: a.emit(0, false, {0x01}, RCX, RAX); break;
+			case OpCode::SUBTRACT: a.emit(0, false, {0x29}, RCX, RAX); break;
+			case OpCode::MULTIPLY: a.emit(0, false, {0x0F, 0xAF}, RAX, RCX); break;
+			case OpCode::DIVIDE: case OpCode::MODULO:
+				// In 64 bits, so INT_MIN / -1 wraps instead of trapping
+				a.emit(0, false, {0x85}, RCX, RCX);
+				a.jump_if(EQUAL, division_by_zero);
+				a.emit(0, true, {0x63}, RAX, RAX);
+				a.emit(0, true, {0x63}, RCX, RCX);
+				a.byte(0x48);
+				a.byte(0x99);
+				a.emit(0, true, {0xF7}, 7, RCX);
+				if (op == OpCode::MODULO) {
+					a.emit(0, false, {0x89}, RDX, RAX);
+				}
+				break;
+			default:
+				a.emit(0, false, {0x81}, 7, RCX);
+				a.dword(31);
+				a.jump_if(ABOVE, shift_out_of_range);
+				a.emit(0, false, {0xD3}, op == OpCode::SHIFT_LEFT ? 4 : 7, RAX);
+				break;
+		}
+		a.store(operand(lhs), RAX);
+	}
+
+	// Leaves the comparison's result, 0 or 1, in eax. Doubles follow
+	// equal() and less() exactly: <= and >= are the negations of > and <,
+	// so they hold for NaN.
+	void compare(OpCode op, std::size_t lhs, ValueType lhs_type, ValueType rhs_type) {
+		if (arithmetic_type(lhs_type, rhs_type) == ValueType::INT) {
+			a.load(RAX, operand(lhs));
+			a.load(RCX, operand(lhs + 1));
+			a.emit(0, false, {0x39}, RCX, RAX);
+			switch (op) {
+				case OpCode::EQUAL: a.set(EQUAL, RAX); break;
+				case OpCode::NOT_EQUAL: a.set(NOT_EQUAL, RAX); break;
+				case OpCode::LESS: a.set(LESS, RAX); break;
+				case OpCode::LESS_EQUAL: a.set(LESS_OR_EQUAL, RAX); break;
+				case OpCode::GREATER: a.set(GREATER, RAX); break;
+				default: a.set(GREATER_OR_EQUAL, RAX); break;
+			}
+		} else {
+			load_double(0, lhs, lhs_type);
+			load_double(1, lhs + 1, rhs_type);
+			switch (op) {
+				case OpCode::EQUAL:
+					a.compare_doubles(0, 1);
+					a.set(EQUAL, RAX);
+					a.set(NO_PARITY, RCX);
+					a.emit(0, false, {0x20}, RCX, RAX);
+					break;
+				case OpCode::NOT_EQUAL:
+					a.compare_doubles(0, 1);
+					a.set(NOT_EQUAL, RAX);
+					a.set(PARITY, RCX);
+					a.emit(0, false, {0x08}, RCX, RAX);
+					break;
+				case OpCode::LESS:
+					a.compare_doubles(1, 0);
+					a.set(ABOVE, RAX);
+					break;
+				case OpCode::LESS_EQUAL:
+					a.compare_doubles(0, 1);
+					a.set(BELOW_OR_EQUAL, RAX);
+					break;
+				case OpCode::GREATER:
+					a.compare_doubles(0, 1);
+					a.set(ABOVE, RAX);
+					break;
+				default:
+					a.compare_doubles(1, 0);
+					a.set(BELOW_OR_EQUAL, RAX);
+					break;
+			}
+		}
+		a.emit(0, false, {0x0F, 0xB6}, RAX, RAX);
+	}
+
+	// truthy() of the operand, 0 or 1, in eax
+	void truthy(std::size_t index, ValueType type) {
+		if (type == ValueType::DOUBLE) {
+			a.load_double(0, operand(index));
+			a.emit(0x66, false, {0x0F, 0x57}, 1, 1);
+			a.compare_doubles(0, 1);
+			a.set(NOT_EQUAL, RAX);
+			a.set(PARITY, RCX);
+			a.emit(0, false, {0x08}, RCX, RAX);
+		} else {
+			a.load(RAX, operand(index));
+			a.emit(0, false, {0x85}, RAX, RAX);
+			a.set(NOT_EQUAL, RAX);
+		}
+		a.emit(0, false, {0x0F, 0xB6}, RAX, RAX);
+	}
+
+	void convert(std::size_t index, ValueType from, ValueType to) {
+		if (from == to || to == ValueType::NONE || (to == ValueType::INT && from != ValueType::DOUBLE)) {
+			return;
+		}
+		switch (to) {
+			case ValueType::DOUBLE:
+				a.convert_to_double(0, operand(index));
+				a.store_double(operand(index), 0);
+				return;
+			case ValueType::BOOL:
+				truthy(index, from);
+				break;
+			default:
+				if (from == ValueType::DOUBLE) {
+					a.load_double(0, operand(index));
+					a.call(reinterpret_cast<const void*>(&truncate_double));
+				} else {
+					a.load(RAX, operand(index));
+				}
+				if (to == ValueType::CHAR) {
+					a.emit(0, false, {0x0F, 0xBE}, RAX, RAX);
+				}
+				break;
+		}
+		a.store(operand(index), RAX);
+	}
+
+	const Function& function;
+	const Program& program;
+	const std::vector<State>& states;
+	const StopRequest* stop;
+	Assembler a;
+	std::size_t epilogue = 0;
+	std::size_t division_by_zero = 0;
+	std::size_t shift_out_of_range = 0;
+	std::size_t stopped = 0;
+};
+
+#else
+#define JIT_NATIVE 0
+#endif
+
+}
+
+bool Jit::Code::enters(std::uint32_t instruction) const {
+	return std::find(loop_entries.begin(), loop_entries.end(), instruction) != loop_entries.end();
+}
+
+Jit::Jit(const StopRequest* stop) : stop(stop) {}
+
+Jit::~Jit() {
+	for (auto& region : regions) {
+		::munmap(region.memory, region.size);
+	}
+}
+
+const Jit::Code* Jit::compile(const Function& function, const Program& program, std::string& reason) {
+	std::vector<State> states;
+	try {
+		states = analyze(function, program);
+	} catch (const std::exception& e) {
+		reason = e.what();
+		return nullptr;
+	}
+#if JIT_NATIVE
+	auto code = std::make_unique<Code>();
+	auto bytes = Generator(function, program, states, stop).generate(code->loop_entries);
+
+	auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	auto size = (bytes.size() + page - 1) / page * page;
+	auto memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		reason = "no memory could be mapped for the code";
+		return nullptr;
+	}
+	std::memcpy(memory, bytes.data(), bytes.size());
+	if (::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		::munmap(memory, size);
+		reason = "the code cannot be made executable";
+		return nullptr;
+	}
+	regions.push_back(Region{memory, size});
+	code->entry = reinterpret_cast<Entry>(memory);
+	code->size = bytes.size();
+	codes.push_back(std::move(code));
+	return codes.back().get();
+#else
+	reason = "there is no code generator for this architecture";
+	return nullptr;
+#endif
+}
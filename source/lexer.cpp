@@ -1,129 +1,291 @@
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <cctype>
+#include <utility>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 
 #include "lexer.hpp"
+#include "scan.hpp"
 
-Lexer::Lexer(const std::string& input) : input(input) {}
+Lexer::Lexer(std::string_view input, std::size_t base, std::vector<Diagnostic>* diagnostics) : input(input), base(base), diagnostics(diagnostics) {}
 
-std::vector<Token> Lexer::tokenize() {
-	std::vector<Token> tokens;
-
-	for (; input[offset];) {
-		if (std::isspace(input[offset])) {
-			++offset;
-		} else if (std::isalpha(input[offset]) || input[offset] == '_') {
-			tokens.push_back(extract_identifier());
-		} else if (std::isdigit(input[offset]) || input[offset] == '.') {
-			tokens.push_back(extract_number());
-		} else if (input[offset] == '\'') {
-			tokens.push_back(extract_char());
-		} else if (input[offset] == '"') {
-			tokens.push_back(extract_string());
-		} else if (metachars.contains(input[offset])) {
-			tokens.push_back(extract_operator());
-		}  else if (input.substr(offset, 2) == "//") {
+Token Lexer::next() {
+	while (offset < input.size()) {
+		unsigned char current = input[offset];
+		if (std::isspace(current)) {
+			offset = scan_whitespace(input, offset);
+		} else if (std::isalpha(current) || current == '_') {
+			return extract_identifier();
+		} else if (std::isdigit(current) || (current == '.' && std::isdigit(static_cast<unsigned char>(peek(1))))) {
+			return extract_number();
+		} else if (current == '\'') {
+			return extract_char();
+		} else if (current == '"') {
+			return extract_string();
+		} else if (current == '/' && peek(1) == '/') {
 			skip_line_comment();
-		} else if (input.substr(offset, 2) == "/*") {
-			skip_multiline_comment();
+		} else if (current == '/' && peek(1) == '*') {
+			if (!skip_multiline_comment()) {
+				return fail("Unclosed multiline comment", input.size());
+			}
+		} else if (metachars.contains(current)) {
+			return extract_operator();
 		} else {
-			throw std::runtime_error("Unknown character " + input[offset]);
+			return fail(std::string("Unknown character ") + input[offset], offset + 1);
 		}
 	}
-	tokens.push_back(Token{Token::END, ""});
+	return token(Token::END, "", offset);
+}
+
+std::vector<Token> Lexer::tokenize() {
+	std::vector<Token> tokens;
+	tokens.reserve(input.size() / 8 + 1);
+	do {
+		tokens.push_back(next());
+	} while (tokens.back().type != Token::END);
 	return tokens;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Token Lexer::extract_identifier() {
-	std::size_t size;
-	for (size = 0; std::isalnum(input[offset + size]) || input[offset + size] == '_'; ++size);
-	std::string identifier(input, offset, size);
-	offset += size;
-	if (keywords.contains(identifier)) {
-		return Token{Token::KEYWORD, identifier};
-	} else if (types.contains(identifier)) {
-		return Token{Token::TYPE, identifier};
-	} else if (identifier == "true" || identifier == "false") {
-		return Token{Token::BOOL_LITERAL, identifier};
-	}
-	return Token{Token::IDENTIFIER, identifier};
+	auto end = scan_identifier(input, offset);
+	auto identifier = input.substr(offset, end - offset);
+	auto start = std::exchange(offset, end);
+	return token(classify(identifier), identifier, start);
 }
 
 Token Lexer::extract_number() {
-	std::size_t size;
-	for (size = 0; std::isdigit(input[offset + size]); ++size);
-	if (input[offset + size] == '.') {
-		++size;
-		for (; std::isdigit(input[offset + size]); ++size);
+	std::size_t size = scan_digits(input, offset) - offset;
+	if (peek(size) == '.') {
+		size = scan_digits(input, offset + size + 1) - offset;
 		if (size == 1) {
-			throw std::runtime_error("Invalid floating-point literal");
+			return fail("Invalid floating-point literal", offset + size);
 		}
+		auto num = input.substr(offset, size);
 		offset += size;
-		return Token{Token::FLOAT_LITERAL, std::string(input, offset, size)};
+		return token(Token::FLOAT_LITERAL, num, offset - size);
 	}
-	auto num = std::string(input, offset, size);
+	auto num = input.substr(offset, size);
 	offset += size;
-	return Token{Token::INTEGER_LITERAL, num};
+	return token(Token::INTEGER_LITERAL, num, offset - size);
 }
 
 Token Lexer::extract_char() {
-	//return Token{};
+	std::size_t size = 1;
+	if (peek(size) == '\\') {
+		++size;
+	}
+	if (peek(size) == '\0' || peek(size + 1) != '\'') {
+		auto end = input.find_first_of("'\n", offset + 1);
+		return fail("Invalid character literal", end == std::string_view::npos ? input.size() : end + (input[end] == '\''));
+	}
+	auto value = input.substr(offset + 1, size);
+	offset += size + 2;
+	return token(Token::CHAR_LITERAL, value, offset - size - 2);
 }
 
 Token Lexer::extract_string() {
-	//return Token{};
+	std::size_t size;
+	for (size = 1; peek(size) != '"'; ++size) {
+		if (peek(size) == '\\') {
+			++size;
+		}
+		if (peek(size) == '\0' || peek(size) == '\n') {
+			return fail("Unterminated string literal", std::min(offset + size, input.size()));
+		}
+	}
+	auto value = input.substr(offset + 1, size - 1);
+	offset += size + 1;
+	return token(Token::STRING_LITERAL, value, offset - size - 1);
 }
 
 Token Lexer::extract_operator() {
-	std::size_t size;
-	std::string op;
-	for (size = 0; metachars.contains(input[offset + size]); ++size) {
-		op.push_back(input[offset + size]);
-		if (!tokens_dictionary.contains(op)) {
-			if (size == 0) {
-				throw std::runtime_error("Invalid operator");
-			}
-			op.pop_back();
-			break;
-		}
+	auto [type, size] = match_operator();
+	if (type == Token::INVALID) {
+		return fail("Invalid operator", offset + 1);
 	}
+	auto op = input.substr(offset, size);
 	offset += size;
-	return Token{tokens_dictionary.at(op), op};
+	return token(type, op, offset - size);
+}
+
+std::pair<Token::Type, std::size_t> Lexer::match_operator() const {
+	char next = peek(1);
+	switch (peek()) {
+		case '+':
+			if (next == '+') return {Token::INCREMENT, 2};
+			if (next == '=') return {Token::PLUS_ASSIGNMENT, 2};
+			return {Token::PLUS, 1};
+		case '-':
+			if (next == '-') return {Token::DECREMENT, 2};
+			if (next == '=') return {Token::MINUS_ASSIGNMENT, 2};
+			return {Token::MINUS, 1};
+		case '*':
+			if (next == '*') return peek(2) == '=' ? std::pair{Token::POWER_ASSIGNMENT, 3} : std::pair{Token::POWER, 2};
+			if (next == '=') return {Token::MULTIPLY_ASSIGNMENT, 2};
+			return {Token::MULTIPLY, 1};
+		case '/':
+			if (next == '=') return {Token::DIVIDE_ASSIGNMENT, 2};
+			return {Token::DIVIDE, 1};
+		case '%':
+			if (next == '=') return {Token::MODULO_ASSIGNMENT, 2};
+			return {Token::MODULO, 1};
+		case '&':
+			if (next == '&') return {Token::AND, 2};
+			return {Token::AMPERSAND, 1};
+		case '|':
+			if (next == '|') return {Token::OR, 2};
+			break;
+		case '!':
+			if (next == '=') return {Token::NOT_EQUAL, 2};
+			return {Token::NOT, 1};
+		case '=':
+			if (next == '=') return {Token::EQUAL, 2};
+			return {Token::ASSIGNMENT, 1};
+		case '<':
+			if (next == '<') return {Token::SHIFT_LEFT, 2};
+			if (next == '=') return {Token::LESS_EQUAL, 2};
+			return {Token::LESS, 1};
+		case '>':
+			if (next == '>') return {Token::SHIFT_RIGHT, 2};
+			if (next == '=') return {Token::GREATER_EQUAL, 2};
+			return {Token::GREATER, 1};
+		case ',': return {Token::COMMA, 1};
+		case ';': return {Token::SEMICOLON, 1};
+		case '(': return {Token::LPAREN, 1};
+		case ')': return {Token::RPAREN, 1};
+		case '{': return {Token::LBRACE, 1};
+		case '}': return {Token::RBRACE, 1};
+		case '[': return {Token::LBRACKET, 1};
+		case ']': return {Token::RBRACKET, 1};
+	}
+	return {Token::INVALID, 0};
 }
 
 void Lexer::skip_line_comment() {
-	for(; input[offset] != '\n'; ++offset);
+	offset = scan_line_end(input, offset);
 }
 
-void Lexer::skip_multiline_comment() {
-	for(; input.substr(offset, 2) != "*/"; ++offset) {
-		if (input[offset] == '\0') {
-			throw std::runtime_error("Unclosed multiline comment");
-		}
+bool Lexer::skip_multiline_comment() {
+	auto end = scan_comment_end(input, offset + 2);
+	if (end == std::string_view::npos) {
+		return false;
+	}
+	offset = end + 2;
+	return true;
+}
+
+Token Lexer::fail(std::string message, std::size_t end) {
+	if (!diagnostics) {
+		throw std::runtime_error(message);
 	}
+	diagnostics->push_back(Diagnostic{static_cast<std::uint32_t>(base + offset), std::move(message)});
+	auto start = std::exchange(offset, end);
+	return token(Token::INVALID, input.substr(start, end - start), start);
+}
+
+char Lexer::peek(std::size_t ahead) const {
+	return offset + ahead < input.size() ? input[offset + ahead] : '\0';
+}
+
+Token Lexer::token(Token::Type type, std::string_view value, std::size_t start) const {
+	return Token(type, value, static_cast<std::uint32_t>(base + start));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-const std::string Lexer::metachars = "+-*/%^=<>&|!(){}[],;";
+const std::string_view Lexer::metachars = "+-*/%^=<>&|!(){}[],;";
+
+namespace {
+
+struct ReservedWord {
+	std::string_view spelling;
+	Token::Type type;
+};
 
-const std::unordered_set<std::string> Lexer::keywords = {
-	"if", "else", "while", "for", "return", "break", "continue"
+constexpr ReservedWord reserved_words[] = {
+	{"if", Token::IF}, {"elif", Token::ELIF}, {"else", Token::ELSE},
+	{"while", Token::WHILE}, {"for", Token::FOR}, {"repeat", Token::REPEAT},
+	{"return", Token::RETURN}, {"break", Token::BREAK}, {"continue", Token::CONTINUE},
+	{"int", Token::TYPE}, {"double", Token::TYPE}, {"char", Token::TYPE},
+	{"string", Token::TYPE}, {"bool", Token::TYPE}, {"void", Token::TYPE},
+	{"true", Token::BOOL_LITERAL}, {"false", Token::BOOL_LITERAL}
 };
 
-const std::unordered_set<std::string> Lexer::types = {
-	"int", "double", "char", "string", "bool", "void"
+// Perfect hash over the reserved words, mixing the length with the first and
+// last characters. The multipliers are searched for at compile time, so adding
+// a word either still compiles to a collision-free table or fails the build.
+struct ReservedTable {
+	static constexpr std::size_t size = 32;
+
+	unsigned first_multiplier = 0;
+	unsigned last_multiplier = 0;
+	std::size_t max_length = 0;
+	std::array<std::uint8_t, size> slots{};
+
+	constexpr std::size_t hash(std::string_view word) const {
+		return (static_cast<unsigned char>(word.front()) * first_multiplier
+			+ static_cast<unsigned char>(word.back()) * last_multiplier + word.size()) % size;
+	}
 };
 
-const std::unordered_set<std::string> Lexer::specials = {
-	"+", "-", "*", "/", "%", "**",
-	"++", "--",
-	"&",
-	"&&", "||", "!",
-	"==", "!=", ">", "<", ">=", "<=",
-	"=", "+=", "-=", "*=", "/=", "%=", "**=",
-	",", ".", ";", "(", ")", "{", "}", "[", "]"
-};
\ No newline at end of file
+constexpr ReservedTable reserved_table = [] {
+	ReservedTable table;
+	for (auto& word : reserved_words) {
+		table.max_length = std::max(table.max_length, word.spelling.size());
+	}
+	for (table.first_multiplier = 1; table.first_multiplier < 64; ++table.first_multiplier) {
+		for (table.last_multiplier = 1; table.last_multiplier < 64; ++table.last_multiplier) {
+			table.slots.fill(0);
+			bool perfect = true;
+			for (std::size_t i = 0; perfect && i < std::size(reserved_words); ++i) {
+				auto& slot = table.slots[table.hash(reserved_words[i].spelling)];
+				perfect = slot == 0;
+				slot = i + 1;
+			}
+			if (perfect) {
+				return table;
+			}
+		}
+	}
+	throw "no perfect hash for the reserved words";
+}();
+
+}
+
+Token::Type Lexer::classify(std::string_view identifier) {
+	if (identifier.size() > reserved_table.max_length) {
+		return Token::IDENTIFIER;
+	}
+	auto slot = reserved_table.slots[reserved_table.hash(identifier)];
+	if (slot != 0 && reserved_words[slot - 1].spelling == identifier) {
+		return reserved_words[slot - 1].type;
+	}
+	return Token::IDENTIFIER;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TokenStream::TokenStream(Lexer lexer) : lexer(std::move(lexer)) {}
+
+const Token& TokenStream::peek(std::size_t ahead) {
+	if (ahead >= lookahead) {
+		throw std::logic_error("Token lookahead exceeds the stream buffer");
+	}
+	while (size <= ahead) {
+		buffer[(head + size++) % lookahead] = lexer.next();
+	}
+	return buffer[(head + ahead) % lookahead];
+}
+
+Token TokenStream::advance() {
+	auto token = peek();
+	head = (head + 1) % lookahead;
+	--size;
+	return token;
+}
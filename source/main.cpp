@@ -1,17 +1,155 @@
+#include <charconv>
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "interpreter.hpp"
+#include "batch.hpp"
+#include "server.hpp"
+#include "source.hpp"
+
+static bool parse_count(std::string_view text, std::size_t& count, std::string_view what = "thread count") {
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+	if (error != std::errc() || end != text.data() + text.size()) {
+		std::cerr << "Error: Invalid " << what << " " << text << "\n";
+		return false;
+	}
+	return true;
+}
+
+static int connect(const std::string& socket, const std::vector<std::string>& files) {
+	int status = 0;
+	try {
+		Client client(socket);
+		for (auto& file : files) {
+			auto response = file == "-" ? client.run_source(SourceBuffer(file).view()) : client.run_file(file);
+			std::cout << response.output << std::flush;
+			std::cerr << response.errors;
+			if (status == 0) {
+				status = response.status;
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+	return status;
+}
 
 int main(int argc, char *argv[]) {
-	if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>\n";
-        return 1;
-	} else if (argc > 2) {
-        std::cerr << "Error: Too many arguments\n";
-        return 1;
-	}
-	
-    Interpreter().interpret_file(argv[1]);
+	Interpreter::Options options;
+	std::vector<std::string> files;
+	bool batch = false;
+	std::optional<std::size_t> jobs;
+	std::string serve;
+	std::string server;
+	std::optional<std::size_t> time_limit;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if (arg == "--dump-ast") {
+			options.dump_ast = Interpreter::DumpFormat::SOURCE;
+		} else if (arg == "--dump-ast=sexp") {
+			options.dump_ast = Interpreter::DumpFormat::SEXP;
+		} else if (arg == "--dump-ast=flat") {
+			options.dump_ast = Interpreter::DumpFormat::FLAT;
+		} else if (arg == "--check") {
+			options.check = true;
+		} else if (arg == "-O") {
+			options.optimize = true;
+		} else if (arg == "--engine=vm") {
+			options.engine = Interpreter::Engine::VM;
+		} else if (arg == "--engine=ast") {
+			options.engine = Interpreter::Engine::AST;
+		} else if (arg == "--no-jit") {
+			options.jit = false;
+		} else if (arg == "--jit-stats") {
+			options.jit_stats = true;
+		} else if (arg == "--profile") {
+			options.profile = true;
+		} else if (arg.starts_with("--profile=")) {
+			options.profile = true;
+			options.profile_path = arg.substr(std::string_view("--profile=").size());
+		} else if (arg == "--stats") {
+			options.stats = true;
+		} else if (arg.starts_with("--stats=")) {
+			options.stats = true;
+			options.stats_path = arg.substr(std::string_view("--stats=").size());
+		} else if (arg.starts_with("--cache-dir=")) {
+			options.cache_directory = arg.substr(std::string_view("--cache-dir=").size());
+		} else if (arg.starts_with("--parse-threads=")) {
+			if (!parse_count(arg.substr(std::string_view("--parse-threads=").size()), options.parse_threads)) {
+				return 1;
+			}
+		} else if (arg.starts_with("-j")) {
+			auto count = arg.size() > 2 ? arg.substr(2) : i + 1 < argc ? std::string_view(argv[++i]) : std::string_view();
+			if (!parse_count(count, jobs.emplace())) {
+				return 1;
+			}
+			batch = true;
+		} else if (arg.starts_with("--memory-limit=")) {
+			if (!parse_count(arg.substr(std::string_view("--memory-limit=").size()), options.memory_limit, "memory limit")) {
+				return 1;
+			}
+		} else if (arg.starts_with("--nursery-size=")) {
+			if (!parse_count(arg.substr(std::string_view("--nursery-size=").size()), options.nursery_size, "nursery size")) {
+				return 1;
+			}
+		} else if (arg.starts_with("--recursion-limit=")) {
+			if (!parse_count(arg.substr(std::string_view("--recursion-limit=").size()), options.recursion_limit, "recursion limit")) {
+				return 1;
+			}
+		} else if (arg.starts_with("--time-limit=")) {
+			if (!parse_count(arg.substr(std::string_view("--time-limit=").size()), time_limit.emplace(), "time limit")) {
+				return 1;
+			}
+		} else if (arg.starts_with("--serve=")) {
+			serve = arg.substr(std::string_view("--serve=").size());
+		} else if (arg.starts_with("--connect=")) {
+			server = arg.substr(std::string_view("--connect=").size());
+		} else if (arg.starts_with("--files-from=")) {
+			try {
+				auto listed = Batch::read_list(std::string(arg.substr(std::string_view("--files-from=").size())));
+				files.insert(files.end(), listed.begin(), listed.end());
+			} catch (const std::exception& e) {
+				std::cerr << "Error: " << e.what() << "\n";
+				return 1;
+			}
+			batch = true;
+		} else if (arg.size() > 1 && arg.starts_with("-")) {
+			std::cerr << "Error: Unknown option " << arg << "\n";
+			return 1;
+		} else {
+			files.emplace_back(arg);
+		}
+	}
+	if (!server.empty() && serve.empty() && !files.empty()) {
+		return connect(server, files);
+	}
+	if (!server.empty() || (serve.empty() ? (files.empty() && !batch) || time_limit : !files.empty())) {
+		std::cerr << "Usage: " << argv[0] << " [--check] [-O] [--dump-ast[=sexp|flat]] [--parse-threads=N] [--cache-dir=DIR] [--stats[=FILE]] [--profile[=FILE]] [--engine=vm|ast] [--no-jit] [--jit-stats] [--memory-limit=BYTES] [--nursery-size=BYTES] [--recursion-limit=N] [-j N] [--files-from=LIST] <filename | -> ...\n"
+			<< "       " << argv[0] << " [options] [-j N] [--time-limit=MS] --serve=SOCKET\n"
+			<< "       " << argv[0] << " --connect=SOCKET <filename | -> ...\n";
+		return 1;
+	}
 
-    return 0;
-}
\ No newline at end of file
+	if (files.size() == 1 && !batch && serve.empty()) {
+		return Interpreter(options).interpret_file(files.front());
+	}
+	// Allocation counts and the profiler's timer are process-wide
+	if (options.stats || options.profile) {
+		std::cerr << "Error: --stats and --profile take a single file\n";
+		return 1;
+	}
+	if (!serve.empty()) {
+		try {
+			return Server(options, serve, jobs.value_or(0), std::chrono::milliseconds(time_limit.value_or(0))).run();
+		} catch (const std::exception& e) {
+			std::cerr << "Error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+	return Batch(options, jobs.value_or(1)).run(files, std::cout, std::cerr);
+}
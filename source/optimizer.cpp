@@ -0,0 +1,374 @@
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "optimizer.hpp"
+#include "counter.hpp"
+
+static Expression* strip_parentheses(Expression* expression) {
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	return expression;
+}
+
+static std::optional<Value> constant(Expression* expression) {
+	expression = strip_parentheses(expression);
+	if (auto literal = dynamic_cast<IntLiteral*>(expression)) {
+		return literal->value;
+	} else if (auto literal = dynamic_cast<FloatLiteral*>(expression)) {
+		return static_cast<double>(literal->value);
+	} else if (auto literal = dynamic_cast<CharLiteral*>(expression)) {
+		return literal->value;
+	} else if (auto literal = dynamic_cast<BoolLiteral*>(expression)) {
+		return literal->value;
+	} else if (auto literal = dynamic_cast<StringLiteral*>(expression)) {
+		return Value(literal->value);
+	}
+	return std::nullopt;
+}
+
+// The type every evaluation of the expression produces, where it can be told
+// without running it.
+static std::optional<ValueType> static_type(Expression* expression) {
+	expression = strip_parentheses(expression);
+	if (auto value = constant(expression)) {
+		return type_of(*value);
+	} else if (auto identifier = dynamic_cast<IdentifierExpression*>(expression)) {
+		if (identifier->symbol.resolved() && identifier->symbol.type->is_basic()) {
+			return identifier->symbol.type->value_type;
+		}
+	} else if (auto prefix = dynamic_cast<PrefixExpression*>(expression)) {
+		auto base = static_type(prefix->base);
+		if (prefix->op == Token::NOT) {
+			return ValueType::BOOL;
+		} else if (base && (prefix->op == Token::MINUS || prefix->op == Token::PLUS)) {
+			if (*base == ValueType::DOUBLE) {
+				return ValueType::DOUBLE;
+			} else if (*base != ValueType::STRING && *base != ValueType::NONE) {
+				return ValueType::INT;
+			}
+		}
+	} else if (auto operation = dynamic_cast<BinaryOperation*>(expression)) {
+		switch (operation->op) {
+			case Token::EQUAL: case Token::NOT_EQUAL:
+			case Token::LESS: case Token::LESS_EQUAL: case Token::GREATER: case Token::GREATER_EQUAL:
+			case Token::AND: case Token::OR:
+				return ValueType::BOOL;
+			case Token::SHIFT_LEFT: case Token::SHIFT_RIGHT:
+				return ValueType::INT;
+			case Token::PLUS: case Token::MINUS: case Token::MULTIPLY: case Token::DIVIDE: case Token::MODULO: {
+				auto lhs = static_type(operation->lhs), rhs = static_type(operation->rhs);
+				auto numeric = [](std::optional<ValueType> type) {
+					return type && *type != ValueType::STRING && *type != ValueType::NONE;
+				};
+				if (!numeric(lhs) || !numeric(rhs)) {
+					return std::nullopt;
+				}
+				return *lhs == ValueType::DOUBLE || *rhs == ValueType::DOUBLE ? ValueType::DOUBLE : ValueType::INT;
+			}
+			default:
+				if (Token::compound_operator(operation->op) != Token::INVALID || operation->op == Token::ASSIGNMENT) {
+					return static_type(operation->lhs);
+				}
+		}
+	}
+	return std::nullopt;
+}
+
+std::size_t Optimizer::optimize(TranslationUnit& unit) {
+	arena = &unit.arena;
+	auto before = NodeCounter().count(unit);
+	unit.accept(*this);
+	arena = nullptr;
+	return before - NodeCounter().count(unit);
+}
+
+void Optimizer::visit(TranslationUnit& node) {
+	for (auto& decl : node.declarations) {
+		decl->accept(*this);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Optimizer::visit(Declaration::NoPtrDeclarator&) {}
+
+void Optimizer::visit(Declaration::PtrDeclarator&) {}
+
+void Optimizer::visit(Declaration::ArrayDeclarator& node) {
+	if (node.size) {
+		rewrite(node.size);
+	}
+}
+
+void Optimizer::visit(Declaration::InitDeclarator& node) {
+	if (node.initializer) {
+		rewrite(node.initializer);
+	}
+}
+
+void Optimizer::visit(VarDeclaration& node) {
+	for (auto& declarator : node.declarator_list) {
+		declarator->accept(*this);
+	}
+}
+
+void Optimizer::visit(ParameterDeclaration&) {}
+
+void Optimizer::visit(FuncDeclaration& node) {
+	if (node.body) {
+		rewrite(node.body);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Optimizer::visit(CompoundStatement& node) {
+	for (auto& statement : node.statements) {
+		rewrite(statement);
+	}
+}
+
+void Optimizer::visit(DeclarationStatement& node) {
+	node.declaration->accept(*this);
+}
+
+void Optimizer::visit(ExpressionStatement& node) {
+	rewrite(node.expression);
+}
+
+// Branches behind a constant false condition are dropped; a constant true
+// condition ends the chain and its statement becomes the else branch.
+void Optimizer::visit(ConditionalStatement& node) {
+	std::vector<ConditionalStatement::Branch> branches;
+	Statement* else_branch = node.else_branch;
+	auto consider = [&](ConditionalStatement::Branch branch) {
+		rewrite(branch.first);
+		rewrite(branch.second);
+		auto value = constant(branch.first);
+		if (!value) {
+			branches.push_back(branch);
+			return true;
+		} else if (truthy(*value)) {
+			else_branch = branch.second;
+			return false;
+		}
+		return true;
+	};
+
+	bool reachable = consider(node.if_branch);
+	for (std::size_t i = 0; reachable && i < node.elif_branches.size(); ++i) {
+		reachable = consider(node.elif_branches[i]);
+	}
+	if (reachable && else_branch) {
+		rewrite(else_branch);
+	}
+
+	if (branches.empty()) {
+		statement = else_branch ? scoped(else_branch) : make<CompoundStatement>(StatementSeq());
+		return;
+	}
+	node.if_branch = branches.front();
+	branches.erase(branches.begin());
+	node.elif_branches = arena->copy(branches);
+	node.else_branch = else_branch;
+}
+
+void Optimizer::visit(WhileStatement& node) {
+	rewrite(node.condition);
+	rewrite(node.statement);
+	if (auto value = constant(node.condition); value && !truthy(*value)) {
+		statement = make<CompoundStatement>(StatementSeq());
+	}
+}
+
+void Optimizer::visit(RepeatStatement& node) {
+	rewrite(node.statement);
+}
+
+void Optimizer::visit(ForStatement&) {}
+
+void Optimizer::visit(ReturnStatement& node) {
+	if (node.expression) {
+		rewrite(node.expression);
+	}
+}
+
+void Optimizer::visit(BreakStatement&) {}
+
+void Optimizer::visit(ContinueStatement&) {}
+
+///////////////////////////////////////////////////////////////////
+
+// Operations that would fail at runtime, such as a division by zero, are
+// left in place so that the error is still raised when they execute.
+void Optimizer::visit(BinaryOperation& node) {
+	rewrite(node.lhs);
+	rewrite(node.rhs);
+	if (node.op == Token::ASSIGNMENT || Token::compound_operator(node.op) != Token::INVALID) {
+		return;
+	}
+	auto lhs = constant(node.lhs);
+	if ((node.op == Token::AND || node.op == Token::OR) && lhs && truthy(*lhs) == (node.op == Token::OR)) {
+		expression = make<BoolLiteral>(node.op == Token::OR);
+		return;
+	}
+	if (auto rhs = constant(node.rhs); lhs && rhs) {
+		try {
+			if (auto folded = literal(binary_operation(node.op, *lhs, *rhs))) {
+				expression = folded;
+				return;
+			}
+		} catch (const std::runtime_error&) {}
+	}
+	expression = reduce(node);
+}
+
+void Optimizer::visit(PrefixExpression& node) {
+	rewrite(node.base);
+	if (node.op != Token::MINUS && node.op != Token::PLUS && node.op != Token::NOT) {
+		return;
+	}
+	if (auto value = constant(node.base)) {
+		try {
+			if (auto folded = literal(unary_operation(node.op, *value))) {
+				expression = folded;
+			}
+		} catch (const std::runtime_error&) {}
+	}
+}
+
+void Optimizer::visit(PostfixIncrementExpression& node) {
+	rewrite(node.base);
+}
+
+void Optimizer::visit(PostfixDecrementExpression& node) {
+	rewrite(node.base);
+}
+
+void Optimizer::visit(FunctionCallExpression& node) {
+	for (auto& arg : node.args) {
+		rewrite(arg);
+	}
+}
+
+void Optimizer::visit(SubscriptExpression& node) {
+	rewrite(node.base);
+	rewrite(node.index);
+}
+
+void Optimizer::visit(IntLiteral&) {}
+
+void Optimizer::visit(FloatLiteral&) {}
+
+void Optimizer::visit(CharLiteral&) {}
+
+void Optimizer::visit(StringLiteral&) {}
+
+void Optimizer::visit(BoolLiteral&) {}
+
+void Optimizer::visit(IdentifierExpression&) {}
+
+void Optimizer::visit(ParenthesizedExpression& node) {
+	rewrite(node.expression);
+	expression = node.expression;
+}
+
+///////////////////////////////////////////////////////////////////
+
+// Visits the node in the slot and stores the replacement it announced there,
+// as long as the replacement fits the slot's type; a parenthesized operation
+// in a unary position keeps its parentheses, for example. Visits announce a
+// replacement only after rewriting their children, whose own announcements
+// have been consumed by then.
+template<typename T>
+void Optimizer::rewrite(T*& slot) {
+	auto& replacement = [this]() -> auto& {
+		if constexpr (std::is_base_of_v<Expression, T>) {
+			return expression;
+		} else {
+			return statement;
+		}
+	}();
+	replacement = nullptr;
+	slot->accept(*this);
+	if (auto fitting = dynamic_cast<T*>(replacement)) {
+		if constexpr (std::is_base_of_v<Statement, T>) {
+			// Nested statements never start at offset 0; only synthesized ones do
+			if (fitting->offset == 0) {
+				fitting->offset = slot->offset;
+			}
+		}
+		slot = fitting;
+	}
+	replacement = nullptr;
+}
+
+Expression* Optimizer::literal(const Value& value) {
+	switch (type_of(value)) {
+		case ValueType::INT:
+			return make<IntLiteral>(value.as_int());
+		case ValueType::DOUBLE: {
+			auto number = value.as_double();
+			if (static_cast<double>(static_cast<float>(number)) != number) {
+				return nullptr;
+			}
+			return make<FloatLiteral>(static_cast<float>(number));
+		}
+		case ValueType::CHAR:
+			return make<CharLiteral>(value.as_char());
+		case ValueType::BOOL:
+			return make<BoolLiteral>(value.as_bool());
+		case ValueType::STRING:
+			return make<StringLiteral>(arena->copy(value.as_string()));
+		default:
+			return nullptr;
+	}
+}
+
+// int * 2^k becomes a left shift (both wrap modulo 2^32), * 1 and int / 1
+// disappear, and a division by a power-of-two float becomes a multiplication
+// by its reciprocal, which is exact. Integer division is kept: it truncates
+// towards zero where a shift would round down.
+Expression* Optimizer::reduce(BinaryOperation& node) {
+	if (node.op == Token::MULTIPLY) {
+		for (auto [factor, other] : {std::pair(node.rhs, node.lhs), std::pair(node.lhs, node.rhs)}) {
+			auto power = dynamic_cast<IntLiteral*>(factor);
+			if (!power || power->value <= 0 || !std::has_single_bit(static_cast<unsigned>(power->value))
+				|| static_type(other) != ValueType::INT) {
+				continue;
+			}
+			auto shift = std::countr_zero(static_cast<unsigned>(power->value));
+			if (shift == 0) {
+				return other;
+			}
+			return make<BinaryOperation>(Token::SHIFT_LEFT, other, make<IntLiteral>(shift));
+		}
+	} else if (node.op == Token::DIVIDE) {
+		auto type = static_type(node.lhs);
+		if (auto divisor = dynamic_cast<IntLiteral*>(node.rhs); divisor && divisor->value == 1 && type == ValueType::INT) {
+			return node.lhs;
+		}
+		auto divisor = dynamic_cast<FloatLiteral*>(node.rhs);
+		if (!divisor || !type || *type == ValueType::STRING || *type == ValueType::NONE) {
+			return &node;
+		}
+		int exponent;
+		auto reciprocal = 1.0f / divisor->value;
+		if (divisor->value > 0 && std::frexp(divisor->value, &exponent) == 0.5f && std::isnormal(reciprocal)) {
+			return make<BinaryOperation>(Token::MULTIPLY, node.lhs, make<FloatLiteral>(reciprocal));
+		}
+	}
+	return &node;
+}
+
+Statement* Optimizer::scoped(Statement* branch) {
+	if (!dynamic_cast<DeclarationStatement*>(branch)) {
+		return branch;
+	}
+	return make<CompoundStatement>(arena->copy(std::vector<Statement*>{branch}));
+}
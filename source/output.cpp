@@ -0,0 +1,71 @@
+#include <charconv>
+#include <cstring>
+
+#include "output.hpp"
+
+OutputBuffer::OutputBuffer(
+	std::ostream& sink,
+	std::size_t capacity
+	) : sink(sink), data(new char[capacity]), capacity(capacity) {}
+
+OutputBuffer::~OutputBuffer() {
+	flush();
+}
+
+OutputBuffer& OutputBuffer::operator<<(std::string_view text) {
+	if (text.size() > capacity) {
+		flush();
+		sink.write(text.data(), text.size());
+	} else {
+		std::memcpy(reserve(text.size()), text.data(), text.size());
+		size += text.size();
+	}
+	return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(const char* text) {
+	return *this << std::string_view(text);
+}
+
+OutputBuffer& OutputBuffer::operator<<(char c) {
+	*reserve(1) = c;
+	++size;
+	return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(int number) {
+	constexpr std::size_t digits = 16;
+	auto* begin = reserve(digits);
+	size += std::to_chars(begin, begin + digits, number).ptr - begin;
+	return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(std::size_t number) {
+	constexpr std::size_t digits = 24;
+	auto* begin = reserve(digits);
+	size += std::to_chars(begin, begin + digits, number).ptr - begin;
+	return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(float number) {
+	constexpr std::size_t digits = 32;
+	auto* begin = reserve(digits);
+	size += std::to_chars(begin, begin + digits, number, std::chars_format::general, 6).ptr - begin;
+	return *this;
+}
+
+void OutputBuffer::flush() {
+	if (size) {
+		sink.write(data.get(), size);
+		size = 0;
+	}
+	sink.flush();
+}
+
+char* OutputBuffer::reserve(std::size_t count) {
+	if (size + count > capacity) {
+		sink.write(data.get(), size);
+		size = 0;
+	}
+	return data.get() + size;
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <utility>
+
+#include "parallel_parser.hpp"
+#include "parser.hpp"
+#include "lexer.hpp"
+#include "scan.hpp"
+
+ParallelParser::ParallelParser(
+	std::string_view source,
+	std::size_t threads
+	) : source(source), threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+std::unique_ptr<TranslationUnit> ParallelParser::parse() {
+	auto chunks = split(source, std::max(min_chunk_size, source.size() / (threads * 4)));
+	auto workers = std::min(threads, chunks.size());
+	if (workers <= 1) {
+		return Parser(TokenStream(Lexer(source))).parse();
+	}
+
+	std::vector<std::vector<Declaration*>> results(chunks.size());
+	std::vector<std::exception_ptr> errors(chunks.size());
+	std::vector<Arena> arenas(workers);
+	std::atomic<std::size_t> next = 0;
+	auto work = [&](Arena& arena) {
+		for (auto chunk = next++; chunk < chunks.size(); chunk = next++) {
+			try {
+				results[chunk] = Parser(TokenStream(Lexer(chunks[chunk], chunks[chunk].data() - source.data()))).parse_declarations(arena);
+			} catch (...) {
+				errors[chunk] = std::current_exception();
+			}
+		}
+	};
+	std::vector<std::jthread> pool;
+	for (std::size_t i = 1; i < workers; ++i) {
+		pool.emplace_back(work, std::ref(arenas[i]));
+	}
+	work(arenas[0]);
+	pool.clear();
+
+	for (auto& error : errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+	auto unit = std::make_unique<TranslationUnit>();
+	std::vector<Declaration*> declarations;
+	for (auto& result : results) {
+		declarations.insert(declarations.end(), result.begin(), result.end());
+	}
+	for (auto& arena : arenas) {
+		unit->arena.adopt(arena);
+	}
+	unit->declarations = unit->arena.copy(declarations);
+	return unit;
+}
+
+std::vector<std::string_view> ParallelParser::split(std::string_view source, std::size_t chunk_size) {
+	std::vector<std::string_view> chunks;
+	std::size_t begin = 0;
+	for (auto end = boundary(source, 0); end != std::string_view::npos; end = boundary(source, end)) {
+		if (end - begin >= chunk_size) {
+			chunks.push_back(source.substr(begin, end - begin));
+			begin = end;
+		}
+	}
+	if (begin < source.size() || chunks.empty()) {
+		chunks.push_back(source.substr(begin));
+	}
+	return chunks;
+}
+
+// Only comments, string and character literals are recognized, so that braces
+// and semicolons inside them are not counted. Anything the scan cannot follow
+// (an unclosed comment or literal) is reported as no boundary and left whole
+// to the Parser, which reports it.
+std::size_t ParallelParser::boundary(std::string_view source, std::size_t offset) {
+	std::size_t depth = 0;
+	while (offset < source.size()) {
+		char current = source[offset];
+		char next = offset + 1 < source.size() ? source[offset + 1] : '\0';
+		if (current == '/' && next == '/') {
+			offset = scan_line_end(source, offset + 2);
+			continue;
+		} else if (current == '/' && next == '*') {
+			auto end = scan_comment_end(source, offset + 2);
+			if (end == std::string_view::npos) {
+				break;
+			}
+			offset = end + 2;
+			continue;
+		} else if (current == '"' || current == '\'') {
+			auto end = offset + 1;
+			while (end < source.size() && source[end] != current && source[end] != '\n') {
+				end += source[end] == '\\' ? 2 : 1;
+			}
+			if (end >= source.size() || source[end] != current) {
+				break;
+			}
+			offset = end + 1;
+			continue;
+		}
+
+		++offset;
+		if (current == '{') {
+			++depth;
+		} else if (current == '}' && depth > 0) {
+			--depth;
+		} else if (current != ';' && current != '}') {
+			continue;
+		}
+		if (depth == 0) {
+			return offset;
+		}
+	}
+	return std::string_view::npos;
+}
@@ -1,67 +1,96 @@
+#include <charconv>
 #include <string>
 #include <vector>
-#include <memory> 
+#include <memory>
+#include <utility>
+#include <stdexcept>
 
 #include "parser.hpp"
 
 Parser::Parser(
-	const std::vector<Token>& tokens
-	) : tokens(tokens), offset(0) {}
-
-
-std::shared_ptr<TranslationUnit> Parser::parse() {
-	std::vector<std::shared_ptr<Declaration>> declarations;
-	while (!match_token(Token::END)) {
-		declarations.push_back(parse_declaration());
+	TokenStream&& tokens,
+	std::vector<Diagnostic>* diagnostics
+	) : tokens(std::move(tokens)), arena(nullptr), diagnostics(diagnostics) {}
+
+
+std::unique_ptr<TranslationUnit> Parser::parse() {
+	auto unit = std::make_unique<TranslationUnit>();
+	auto declarations = parse_declarations(unit->arena);
+	unit->declarations = unit->arena.copy(declarations);
+	return unit;
+}
+
+std::vector<Declaration*> Parser::parse_declarations(Arena& target) {
+	arena = &target;
+	std::vector<Declaration*> declarations;
+	while (tokens.peek().type != Token::END) {
+		origin = tokens.peek().offset;
+		auto declaration = parse_declaration();
+		if (recovering) {
+			synchronize(false);
+			continue;
+		}
+		declaration->offset = origin;
+		declarations.push_back(declaration);
 	}
-	return std::make_shared<TranslationUnit>(declarations);
+	arena = nullptr;
+	recovering = false;
+	return declarations;
 }
 
-std::shared_ptr<Declaration> Parser::parse_declaration() {
+Declaration* Parser::parse_declaration() {
+	auto offset = tokens.peek().offset - origin;
+	Declaration* declaration;
 	if (match_pattern(Token::TYPE, Token::IDENTIFIER, Token::LPAREN) || match_pattern(Token::TYPE, Token::MULTIPLY, Token::IDENTIFIER, Token::LPAREN)) {
-		return parse_function_declaration();
+		declaration = parse_function_declaration();
 	} else if (match_pattern(Token::TYPE, Token::IDENTIFIER) || match_pattern(Token::TYPE, Token::MULTIPLY, Token::IDENTIFIER)) {
-		return parse_var_declaration();
+		declaration = parse_var_declaration();
 	} else {
-		throw std::runtime_error("Unexpected token " + tokens[offset].value);
+		unexpected();
+		return nullptr;
 	}
+	declaration->offset = offset;
+	return declaration;
 }
 
-std::shared_ptr<FuncDeclaration> Parser::parse_function_declaration() {
+FuncDeclaration* Parser::parse_function_declaration() {
 	auto type = extract_token(Token::TYPE);
 	auto declarator = parse_declarator();
 	extract_token(Token::LPAREN);
 
-	std::vector<std::shared_ptr<ParameterDeclaration>> args;
+	std::vector<ParameterDeclaration*> args;
 	if (!match_token(Token::RPAREN)) {
 		while (true) {
 			args.push_back(parse_parameter_declaration());
-			if (tokens[offset].value == ",") {
-				++offset;
-			} else if (tokens[offset].value == ")") {
-				++offset;
+			if (match_token(Token::COMMA)) {
+				continue;
+			} else if (match_token(Token::RPAREN)) {
 				break;
 			} else {
-				throw std::runtime_error("Missing closing parenthesis");
+				error(tokens.peek(), "Missing closing parenthesis");
+				break;
 			}
 		}
 	}
-	std::shared_ptr<CompoundStatement> body;
+	CompoundStatement* body = nullptr;
+	auto offset = tokens.peek().offset - origin;
 	if (match_token(Token::LBRACE)) {
 		body = parse_compound_statement();
+		body->offset = offset;
 	} else if (!match_token(Token::SEMICOLON)) {
-		throw std::runtime_error("Unexpected token");
+		unexpected();
 	}
-	return std::make_shared<FuncDeclaration>(type, declarator, args, body);
+	return make<FuncDeclaration>(arena->copy(type), declarator, arena->copy(args), body);
 }
 
-std::shared_ptr<ParameterDeclaration> Parser::parse_parameter_declaration() {
-	return std::make_shared<ParameterDeclaration>(extract_token(Token::TYPE), parse_init_declarator());
+ParameterDeclaration* Parser::parse_parameter_declaration() {
+	auto type = extract_token(Token::TYPE);
+	return make<ParameterDeclaration>(arena->copy(type), parse_init_declarator());
 }
 
-std::shared_ptr<VarDeclaration> Parser::parse_var_declaration() {
+VarDeclaration* Parser::parse_var_declaration() {
 	auto type = extract_token(Token::TYPE);
-	std::vector<std::shared_ptr<Declaration::InitDeclarator>> declarator_list;
+	std::vector<Declaration::InitDeclarator*> declarator_list;
     while (true) {
         declarator_list.push_back(parse_init_declarator());
         if (match_token(Token::COMMA)) {
@@ -69,65 +98,87 @@ std::shared_ptr<VarDeclaration> Parser::parse_var_declaration() {
         } else if (match_token(Token::SEMICOLON)) {
             break;
         } else {
-            throw std::runtime_error("Unexpected token " + tokens[offset].value);
+            unexpected();
+            break;
         }
     }
-    return std::make_shared<VarDeclaration>(type, declarator_list);
+    return make<VarDeclaration>(arena->copy(type), arena->copy(declarator_list));
 }
 
-std::shared_ptr<Declaration::InitDeclarator> Parser::parse_init_declarator() {
+Declaration::InitDeclarator* Parser::parse_init_declarator() {
 	auto declarator = parse_declarator();
-	std::shared_ptr<Expression> initializer;
+	Expression* initializer = nullptr;
 	if (match_token(Token::ASSIGNMENT)) {
 		initializer = parse_expression();
 	}
-	return std::make_shared<Declaration::InitDeclarator>(declarator, initializer);	
+	return make<Declaration::InitDeclarator>(declarator, initializer);	
 }
 
-std::shared_ptr<Declaration::Declarator> Parser::parse_declarator() {
+Declaration::Declarator* Parser::parse_declarator() {
 	if (match_pattern(Token::MULTIPLY, Token::IDENTIFIER)) {
 		extract_token(Token::MULTIPLY);
-		return std::make_shared<Declaration::PtrDeclarator>(extract_token(Token::IDENTIFIER));
+		return make<Declaration::PtrDeclarator>(arena->copy(extract_token(Token::IDENTIFIER)));
+	} else if (match_pattern(Token::IDENTIFIER, Token::LBRACKET)) {
+		auto name = arena->copy(extract_token(Token::IDENTIFIER));
+		extract_token(Token::LBRACKET);
+		Expression* size = nullptr;
+		if (!match_token(Token::RBRACKET)) {
+			size = parse_expression();
+			extract_token(Token::RBRACKET);
+		}
+		return make<Declaration::ArrayDeclarator>(name, size);
 	} else if (match_pattern(Token::IDENTIFIER)) {
-		return std::make_shared<Declaration::NoPtrDeclarator>(extract_token(Token::IDENTIFIER));
+		return make<Declaration::NoPtrDeclarator>(arena->copy(extract_token(Token::IDENTIFIER)));
 	} else {
-		throw std::runtime_error("Unexpected token " + tokens[offset].value);
+		unexpected();
+		return nullptr;
 	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::shared_ptr<Statement> Parser::parse_statement() {
+Statement* Parser::parse_statement() {
+	auto offset = tokens.peek().offset - origin;
+	Statement* statement;
 	if (match_token(Token::LBRACE)) {
-		return parse_compound_statement();
+		statement = parse_compound_statement();
 	} else if (match_token(Token::IF)) {
-		return parse_conditional_statement();
+		statement = parse_conditional_statement();
 	} else if (check_token(Token::WHILE, Token::FOR, Token::REPEAT)) {
-		return parse_loop_statement();
+		statement = parse_loop_statement();
 	} else if (check_token(Token::RETURN, Token::BREAK, Token::CONTINUE)) {
-		return parse_jump_statement();
+		statement = parse_jump_statement();
 	} else if (check_token(Token::TYPE)) {
-		return parse_declaration_statement();
+		statement = parse_declaration_statement();
 	} else {
-		return parse_expression_statement();
+		statement = parse_expression_statement();
 	}
+	statement->offset = offset;
+	return statement;
 }
 
-std::shared_ptr<CompoundStatement> Parser::parse_compound_statement() {
-	std::vector<std::shared_ptr<Statement>> statements;
+CompoundStatement* Parser::parse_compound_statement() {
+	std::vector<Statement*> statements;
 	while (!match_token(Token::RBRACE)) {
+		if (tokens.peek().type == Token::END) {
+			unexpected();
+			break;
+		}
 		statements.push_back(parse_statement());
+		if (recovering) {
+			synchronize(true);
+		}
 	}
-	return std::make_shared<CompoundStatement>(statements);
+	return make<CompoundStatement>(arena->copy(statements));
 }
 
-std::shared_ptr<ConditionalStatement> Parser::parse_conditional_statement() {
+ConditionalStatement* Parser::parse_conditional_statement() {
 	extract_token(Token::LPAREN);
 	auto if_condition = parse_expression();
 	extract_token(Token::RPAREN);
 	auto if_statement = parse_statement();
 	auto if_branch = std::make_pair(if_condition, if_statement);
-	std::vector<std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>> elif_branches;
+	std::vector<ConditionalStatement::Branch> elif_branches;
 	while (match_token(Token::ELIF)) {
 		extract_token(Token::LPAREN);
 		auto elif_condition = parse_expression();
@@ -136,14 +187,14 @@ std::shared_ptr<ConditionalStatement> Parser::parse_conditional_statement() {
 		auto elif_branch = std::make_pair(elif_condition, elif_statement);
 		elif_branches.push_back(elif_branch);
 	}
-	std::shared_ptr<Statement> else_branch;
+	Statement* else_branch = nullptr;
 	if (match_token(Token::ELSE)) {
 		else_branch = parse_statement();
 	}
-	return std::make_shared<ConditionalStatement>(if_branch, elif_branches, else_branch);
+	return make<ConditionalStatement>(if_branch, arena->copy(elif_branches), else_branch);
 }
 
-std::shared_ptr<LoopStatement> Parser::parse_loop_statement() {
+LoopStatement* Parser::parse_loop_statement() {
 	if (match_token(Token::WHILE)) {
 		return parse_while_statement();
 	} else if (match_token(Token::FOR)) {
@@ -154,23 +205,23 @@ std::shared_ptr<LoopStatement> Parser::parse_loop_statement() {
 	}
 }
 
-std::shared_ptr<WhileStatement> Parser::parse_while_statement() {
+WhileStatement* Parser::parse_while_statement() {
 	extract_token(Token::LPAREN);
 	auto condition = parse_expression();
 	extract_token(Token::RPAREN);
 	auto statement = parse_statement();
-	return std::make_shared<WhileStatement>(condition, statement);
+	return make<WhileStatement>(condition, statement);
 }
 
-std::shared_ptr<RepeatStatement> Parser::parse_repeat_statement() {
-	return std::make_shared<RepeatStatement>(parse_statement());
+RepeatStatement* Parser::parse_repeat_statement() {
+	return make<RepeatStatement>(parse_statement());
 }
 
-std::shared_ptr<ForStatement> Parser::parse_for_statement() {
-	return std::make_shared<ForStatement>();
+ForStatement* Parser::parse_for_statement() {
+	return make<ForStatement>();
 }
 
-std::shared_ptr<JumpStatement> Parser::parse_jump_statement() {
+JumpStatement* Parser::parse_jump_statement() {
 	if (match_token(Token::BREAK)) {
 		return parse_break_statement();
 	} else if (match_token(Token::CONTINUE)) {
@@ -181,68 +232,72 @@ std::shared_ptr<JumpStatement> Parser::parse_jump_statement() {
 	}
 }
 
-std::shared_ptr<BreakStatement> Parser::parse_break_statement() {
+BreakStatement* Parser::parse_break_statement() {
 	extract_token(Token::SEMICOLON);
-	return std::make_shared<BreakStatement>();
+	return make<BreakStatement>();
 }
 
-std::shared_ptr<ContinueStatement> Parser::parse_continue_statement() {
+ContinueStatement* Parser::parse_continue_statement() {
 	extract_token(Token::SEMICOLON);
-	return std::make_shared<ContinueStatement>();
+	return make<ContinueStatement>();
 }
 
-std::shared_ptr<ReturnStatement> Parser::parse_return_statement() {
-	auto expression = parse_expression();
+ReturnStatement* Parser::parse_return_statement() {
+	Expression* expression = nullptr;
+	if (!check_token(Token::SEMICOLON)) {
+		expression = parse_expression();
+	}
 	extract_token(Token::SEMICOLON);
-	return std::make_shared<ReturnStatement>(expression);
+	return make<ReturnStatement>(expression);
 }
 
-std::shared_ptr<DeclarationStatement> Parser::parse_declaration_statement() {
+DeclarationStatement* Parser::parse_declaration_statement() {
 	auto declaration = parse_var_declaration();
-	return std::make_shared<DeclarationStatement>(declaration);
+	return make<DeclarationStatement>(declaration);
 }
 
-std::shared_ptr<ExpressionStatement> Parser::parse_expression_statement() {
+ExpressionStatement* Parser::parse_expression_statement() {
 	auto expression = parse_expression();
 	extract_token(Token::SEMICOLON);
-	return std::make_shared<ExpressionStatement>(expression);
+	return make<ExpressionStatement>(expression);
 }
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::shared_ptr<Expression> Parser::parse_expression() {
+Expression* Parser::parse_expression() {
 	return parse_binary_expression(0);
 }
 
-std::shared_ptr<BinaryExpression> Parser::parse_binary_expression(int min_precedence) {
-	std::shared_ptr<BinaryExpression> lhs = parse_unary_expression();
-	for (auto op = tokens[offset].value; operator_precedences.contains(op) && operator_precedences.at(op) >= min_precedence; op = tokens[offset].value) {
-		++offset;
-		lhs = std::make_shared<BinaryOperation>(op, lhs, parse_binary_expression(operator_precedences.at(op)));
+BinaryExpression* Parser::parse_binary_expression(int min_precedence) {
+	BinaryExpression* lhs = parse_unary_expression();
+	for (auto op = next_type(); binary_operators[op].precedence >= min_precedence; op = next_type()) {
+		tokens.advance();
+		auto [precedence, right_associative] = binary_operators[op];
+		lhs = make<BinaryOperation>(op, lhs, parse_binary_expression(right_associative ? precedence : precedence + 1));
 	}
 	return lhs;
 }
 
-std::shared_ptr<UnaryExpression> Parser::parse_unary_expression() {
-	if (auto op = tokens[offset].value; unary_operators.contains(op)) {
-		++offset;
-		return std::make_shared<PrefixExpression>(op, parse_unary_expression());
+UnaryExpression* Parser::parse_unary_expression() {
+	if (auto op = next_type(); unary_operators[op]) {
+		tokens.advance();
+		return make<PrefixExpression>(op, parse_unary_expression());
 	}
 	return parse_postfix_expression();
 }
 
-std::shared_ptr<PostfixExpression> Parser::parse_postfix_expression() {
-	std::shared_ptr<PostfixExpression> base = parse_primary_expression();
+PostfixExpression* Parser::parse_postfix_expression() {
+	PostfixExpression* base = parse_primary_expression();
 	while (true) {
 		if (match_token(Token::INCREMENT)) {
-			base = std::make_shared<PostfixIncrementExpression>(base);
+			base = make<PostfixIncrementExpression>(base);
 		} else if (match_token(Token::DECREMENT)) {
-			base = std::make_shared<PostfixDecrementExpression>(base);
+			base = make<PostfixDecrementExpression>(base);
 		} else if (match_token(Token::LPAREN)) {
-			base = std::make_shared<FunctionCallExpression>(base, parse_function_call_expression());
+			base = make<FunctionCallExpression>(base, parse_function_call_expression());
 		} else if (match_token(Token::LBRACKET)) {
-			base = std::make_shared<SubscriptExpression>(base, parse_subscript_expression());
+			base = make<SubscriptExpression>(base, parse_subscript_expression());
 		} else {
 			break;
 		}
@@ -250,96 +305,144 @@ std::shared_ptr<PostfixExpression> Parser::parse_postfix_expression() {
 	return base;
 }
 
-std::vector<std::shared_ptr<Expression>> Parser::parse_function_call_expression() {
-	std::vector<std::shared_ptr<Expression>> args;
-	if (!match_token(Token::RPAREN)) {
+std::span<Expression*> Parser::parse_function_call_expression() {
+	std::vector<Expression*> args;
+	if (!check_token(Token::RPAREN)) {
 		while (true) {
 			args.push_back(parse_expression());
 			if (!match_token(Token::COMMA)) {
 				break;
 			}
-			extract_token(Token::COMMA);
 		}
 	}
 	extract_token(Token::RPAREN);
-	return args;
+	return arena->copy(args);
 }
 
-std::shared_ptr<Expression> Parser::parse_subscript_expression() {
+Expression* Parser::parse_subscript_expression() {
 	auto index = parse_expression();
 	extract_token(Token::RBRACKET);
 	return index;
 }
 
-std::shared_ptr<PrimaryExpression> Parser::parse_primary_expression() {
+PrimaryExpression* Parser::parse_primary_expression() {
 	if (check_token(Token::INTEGER_LITERAL)) {
-		return std::make_shared<IntLiteral>(extract_token(Token::INTEGER_LITERAL));
+		return make<IntLiteral>(number<int>(tokens.advance()));
 	} else if (check_token(Token::FLOAT_LITERAL)) {
-		return std::make_shared<FloatLiteral>(extract_token(Token::FLOAT_LITERAL));
+		return make<FloatLiteral>(number<float>(tokens.advance()));
 	} else if (check_token(Token::CHAR_LITERAL)) {
-		return std::make_shared<CharLiteral>(extract_token(Token::CHAR_LITERAL));
+		return make<CharLiteral>(extract_token(Token::CHAR_LITERAL));
 	} else if (check_token(Token::STRING_LITERAL)) {
-		return std::make_shared<StringLiteral>(extract_token(Token::STRING_LITERAL));
+		return make<StringLiteral>(*arena, extract_token(Token::STRING_LITERAL));
 	} else if (check_token(Token::BOOL_LITERAL)) {
-		return std::make_shared<BoolLiteral>(extract_token(Token::BOOL_LITERAL));
+		return make<BoolLiteral>(extract_token(Token::BOOL_LITERAL));
 	} else if (check_token(Token::IDENTIFIER)) {
-		return std::make_shared<IdentifierExpression>(extract_token(Token::IDENTIFIER));
+		return make<IdentifierExpression>(arena->copy(extract_token(Token::IDENTIFIER)));
 	} else if (match_token(Token::LPAREN)) {
 		return parse_parenthesized_expression();
 	} else {
-		throw std::runtime_error("Unexpected token " + tokens[offset].value);
+		unexpected();
+		return nullptr;
 	}
 }
 
-std::shared_ptr<ParenthesizedExpression> Parser::parse_parenthesized_expression() {
+ParenthesizedExpression* Parser::parse_parenthesized_expression() {
 	auto expression = parse_expression();
 	extract_token(Token::RPAREN);
-	return std::make_shared<ParenthesizedExpression>(expression);
+	return make<ParenthesizedExpression>(expression);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
 
+template<typename T, typename... Args>
+T* Parser::make(Args&&... args) {
+	return arena->make<T>(std::forward<Args>(args)...);
+}
+
 template<typename... Args>
 bool Parser::check_token(const Args&... expected) {
-	return ((tokens[offset].type == expected) || ...);
+	return !recovering && ((tokens.peek().type == expected) || ...);
 }
 
 template<typename... Args>
 bool Parser::match_token(const Args&... expected) {
 	bool match_found = check_token(expected...);
 	if (match_found) {
-		++offset;
+		tokens.advance();
 	}
 	return match_found;
 }
 
 template<typename... Args>
-std::string Parser::extract_token(const Args&... expected) {
-	if (!((tokens[offset].type == expected) || ...)) {
-		throw std::runtime_error("Unexpected token " + tokens[offset].value);
+std::string_view Parser::extract_token(const Args&... expected) {
+	if (!check_token(expected...)) {
+		unexpected();
+		return {};
 	}
-	return tokens[offset++].value;
+	return tokens.advance().value;
 }
 
 template<typename... Args>
 bool Parser::match_pattern(const Args&... expected) {
-	std::size_t i = offset;
-	return ((tokens[i++].type == expected) && ...);
-}
-
-//////////////////////////////////////////////////////////
-
-const std::unordered_map<std::string, int> Parser::operator_precedences = {
-	{"=", 0}, {"+=", 0}, {"-=", 0}, {"*=", 0}, {"/=", 0}, {"%=", 0}, {"**=", 0},
-	{"||", 1},
-	{"&&", 2},
-	{"==", 3}, {"!=", 3},
-	{"<", 4}, {"<=", 4}, {">", 4}, {">=", 4},
-	{"+", 5}, {"-", 5},
-	{"*", 6}, {"/", 6}, {"%", 6},
-	{"^", 7}
-};
-
-const std::unordered_set<std::string> Parser::unary_operators = {
-	"+", "-", "&", "*", "!", "++", "--"
-};
\ No newline at end of file
+	static_assert(sizeof...(Args) <= TokenStream::lookahead);
+	std::size_t i = 0;
+	return !recovering && ((tokens.peek(i++).type == expected) && ...);
+}
+
+Token::Type Parser::next_type() {
+	return recovering ? Token::INVALID : tokens.peek().type;
+}
+
+template<typename T>
+T Parser::number(const Token& token) {
+	T value{};
+	auto [end, failure] = std::from_chars(token.value.data(), token.value.data() + token.value.size(), value);
+	if (failure != std::errc() || end != token.value.data() + token.value.size()) {
+		error(token, "Invalid numeric literal " + std::string(token.value));
+	}
+	return value;
+}
+
+// An INVALID token was already reported by the Lexer, and an error while
+// recovering is most likely a consequence of the first one.
+void Parser::error(const Token& token, std::string message) {
+	if (!diagnostics) {
+		throw std::runtime_error(message);
+	}
+	if (!recovering && token.type != Token::INVALID) {
+		diagnostics->push_back(Diagnostic{token.offset, std::move(message)});
+	}
+	recovering = true;
+}
+
+void Parser::unexpected() {
+	auto& token = tokens.peek();
+	error(token, token.type == Token::END ? std::string("Unexpected end of input") : "Unexpected token " + std::string(token.value));
+}
+
+// Skips to the end of the construct an error was found in: past the next ';'
+// or block outside any block it opens, or, nested, up to the '}' closing the
+// enclosing block. At the end of the input there is nothing to resume on, so
+// recovering stays set and every enclosing loop stops.
+void Parser::synchronize(bool nested) {
+	for (int depth = 0;;) {
+		auto type = tokens.peek().type;
+		if (type == Token::END) {
+			return;
+		}
+		if (type == Token::RBRACE && depth == 0 && nested) {
+			break;
+		}
+		tokens.advance();
+		if (type == Token::LBRACE) {
+			++depth;
+		} else if (type == Token::RBRACE) {
+			if (depth == 0 || --depth == 0) {
+				break;
+			}
+		} else if (type == Token::SEMICOLON && depth == 0) {
+			break;
+		}
+	}
+	recovering = false;
+}
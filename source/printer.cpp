@@ -1,67 +1,80 @@
-#include <iostream>
-
 #include "printer.hpp"
 
+Printer::Printer(std::ostream& sink) : out(sink) {}
+
 void Printer::visit(TranslationUnit& node) {
 	for (auto& decl : node.declarations) {
 		decl->accept(*this);
 	}
-	std::cout << std::endl;
+	out << '\n';
+	out.flush();
 }
 
 void Printer::visit(Declaration::NoPtrDeclarator& node) {
-	std::cout << node.name;
+	out << node.name;
 }
 
 void Printer::visit(Declaration::PtrDeclarator& node) {
-	std::cout << "*" << node.name;
+	out << "*" << node.name;
+}
+
+void Printer::visit(Declaration::ArrayDeclarator& node) {
+	out << node.name << "[";
+	if (node.size) {
+		node.size->accept(*this);
+	}
+	out << "]";
 }
 
 void Printer::visit(Declaration::InitDeclarator& node) {
 	node.declarator->accept(*this);
 	if (node.initializer) {
-		std::cout << " = ";
+		out << " = ";
 		node.initializer->accept(*this);
 	}
 }
 
 void Printer::visit(VarDeclaration& node) {
-	std::cout << node.type << " ";
+	out << node.type << " ";
 	for (std::size_t i = 0, size = node.declarator_list.size(); i < size; ++i) {
 		node.declarator_list[i]->accept(*this);
 		if (i != size - 1) {
-			std::cout << ", ";
+			out << ", ";
 		}
 	}
-	std::cout << ";";
+	out << ";";
 }
 
 void Printer::visit(ParameterDeclaration& node) {
-	std::cout << node.type << " ";
+	out << node.type << " ";
 	node.init_declarator->accept(*this);
 }
 
 void Printer::visit(FuncDeclaration& node) {
-	std::cout << node.type << " ";
+	out << node.type << " ";
 	node.declarator->accept(*this);
-	std::cout << "(";
+	out << "(";
 	for (std::size_t i = 0, size = node.args.size(); i < size; ++i) {
 		node.args[i]->accept(*this);
 		if (i != size - 1) {
-			std::cout << ", ";
+			out << ", ";
 		}
 	}
-	std::cout << ")";
-	node.body->accept(*this);
+	out << ")";
+	if (node.body) {
+		node.body->accept(*this);
+	} else {
+		out << ";";
+	}
 }
 
 void Printer::visit(CompoundStatement& node) {
-	std::cout << " {" << std::endl;
+	out << " {\n";
 	for (auto& statement : node.statements) {
 		statement->accept(*this);
-		std::cout << std::endl;
+		out << '\n';
 	}
-	std::cout << "}";
+	out << "}";
 }
 
 void Printer::visit(DeclarationStatement& node) {
@@ -70,30 +83,30 @@ void Printer::visit(DeclarationStatement& node) {
 
 void Printer::visit(ExpressionStatement& node) {
 	node.expression->accept(*this);
-	std::cout << ";";
+	out << ";";
 }
 
 void Printer::visit(ConditionalStatement& node) {
-	std::cout << "if (";
+	out << "if (";
 	node.if_branch.first->accept(*this);
-	std::cout << ")";
+	out << ")";
 	node.if_branch.second->accept(*this);
 	for (auto& branch : node.elif_branches) {
-		std::cout << "elif (";
+		out << "elif (";
 		branch.first->accept(*this);
-		std::cout << ")";
+		out << ")";
 		branch.second->accept(*this);
 	}
 	if (node.else_branch) {
-		std::cout << "else";
+		out << "else";
 		node.else_branch->accept(*this);
 	}
 }
 
 void Printer::visit(WhileStatement& node) {
-	std::cout << "while (";
+	out << "while (";
 	node.condition->accept(*this);
-	std::cout << ")";
+	out << ")";
 	node.statement->accept(*this);
 }
 
@@ -102,93 +115,96 @@ void Printer::visit(ForStatement&) {
 }
 
 void Printer::visit(RepeatStatement& node) {
-	std::cout << "repeat";
+	out << "repeat";
 	node.statement->accept(*this);
 }
 
 void Printer::visit(ReturnStatement& node) {
-	std::cout << "return ";
-	node.expression->accept(*this);
-	std::cout << ";";
+	out << "return";
+	if (node.expression) {
+		out << " ";
+		node.expression->accept(*this);
+	}
+	out << ";";
 }
 
 void Printer::visit(BreakStatement&) {
-	std::cout << "break;";
+	out << "break;";
 }
 
 void Printer::visit(ContinueStatement&) {
-	std::cout << "continue;";
+	out << "continue;";
 }
 
 ///////////////////////////////////////////////////////////////////
 
 void Printer::visit(BinaryOperation& node) {
 	node.lhs->accept(*this);
-	std::cout << " " + node.op + " ";
+	out << " " << Token::spelling(node.op) << " ";
 	node.rhs->accept(*this);
 }
 
 void Printer::visit(PrefixExpression& node) {
-	std::cout << node.op;
+	out << Token::spelling(node.op);
 	node.base->accept(*this);
 }
 
 void Printer::visit(PostfixIncrementExpression& node) {
 	node.base->accept(*this);
-	std::cout << "++";
+	out << "++";
 }
 
 void Printer::visit(PostfixDecrementExpression& node) {
 	node.base->accept(*this);
-	std::cout << "--";
+	out << "--";
 }
 
 void Printer::visit(SubscriptExpression& node) {
 	node.base->accept(*this);
-	std::cout << "[";
+	out << "[";
 	node.index->accept(*this);
-	std::cout << "]";
+	out << "]";
 }
 
 void Printer::visit(FunctionCallExpression& node) {
 	node.base->accept(*this);
-	std::cout << "(";
+	out << "(";
 	for (std::size_t i = 0, size = node.args.size(); i < size; ++i) {
 		node.args[i]->accept(*this);
 		if (i != size - 1) {
-			std::cout << ", ";
+			out << ", ";
 		}
 	}
-	std::cout << ")";
+	out << ")";
 }
 
 
 void Printer::visit(IdentifierExpression& node) {
-	std::cout << node.name;
+	out << node.name;
 }
 
 void Printer::visit(IntLiteral& node) {
-	std::cout << node.value;
+	out << node.value;
 }
 
 void Printer::visit(FloatLiteral& node) {
-	std::cout << node.value;
+	out << node.value;
 }
 
 void Printer::visit(CharLiteral& node) {
-	std::cout << node.value;
+	out << node.value;
 }
 
 void Printer::visit(StringLiteral& node) {
-	std::cout << node.value;
+	out << escape(node.value);
 }
 
 void Printer::visit(BoolLiteral& node) {
-	std::cout << (node.value ? "true" : "false");
+	out << (node.value ? "true" : "false");
 }
 
 void Printer::visit(ParenthesizedExpression& node) {
-	std::cout << "(";
+	out << "(";
 	node.expression->accept(*this);
-	std::cout << ")";
+	out << ")";
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/time.h>
+
+#include "profiler.hpp"
+
+std::atomic<int> Profiler::ticks = 0;
+
+Profiler::Profiler() {
+	struct sigaction action {};
+	action.sa_handler = tick;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (::sigaction(SIGPROF, &action, &previous_action) != 0) {
+		throw std::runtime_error(std::string("Failed to install the profiling signal handler: ") + std::strerror(errno));
+	}
+	ticks = 0;
+	auto microseconds = static_cast<suseconds_t>(interval.count());
+	struct itimerval timer {{0, microseconds}, {0, microseconds}};
+	if (::setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+		::sigaction(SIGPROF, &previous_action, nullptr);
+		throw std::runtime_error(std::string("Failed to start the profiling timer: ") + std::strerror(errno));
+	}
+}
+
+Profiler::~Profiler() {
+	struct itimerval timer {};
+	::setitimer(ITIMER_PROF, &timer, nullptr);
+	::sigaction(SIGPROF, &previous_action, nullptr);
+}
+
+void Profiler::tick(int) {
+	ticks.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint32_t Profiler::function(std::string_view name) {
+	auto [entry, inserted] = ids.emplace(std::string(name), names.size());
+	if (inserted) {
+		names.emplace_back(name);
+		calls.push_back(0);
+	}
+	return entry->second;
+}
+
+void Profiler::enter(std::uint32_t function) {
+	++calls[function];
+}
+
+void Profiler::sample(const std::vector<std::uint32_t>& stack, std::uint32_t offset) {
+	auto weight = static_cast<std::size_t>(ticks.exchange(0, std::memory_order_relaxed));
+	if (weight == 0 || stack.empty()) {
+		return;
+	}
+	samples += weight;
+	stacks[stack] += weight;
+	if (offset != no_offset) {
+		offsets[offset] += weight;
+	}
+}
+
+void Profiler::write_folded(std::ostream& output) const {
+	for (auto& [stack, count] : stacks) {
+		for (std::size_t i = 0; i < stack.size(); ++i) {
+			output << (i ? ";" : "") << names[stack[i]];
+		}
+		output << ' ' << count << '\n';
+	}
+}
+
+void Profiler::write_report(std::ostream& output, const LineTable& lines) const {
+	std::vector<std::size_t> inclusive(names.size()), exclusive(names.size());
+	for (auto& [stack, count] : stacks) {
+		exclusive[stack.back()] += count;
+		std::vector<std::uint32_t> seen(stack);
+		std::sort(seen.begin(), seen.end());
+		seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+		for (auto function : seen) {
+			inclusive[function] += count;
+		}
+	}
+	std::vector<std::uint32_t> order(names.size());
+	for (std::uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return inclusive[a] > inclusive[b]; });
+
+	auto milliseconds = [](std::size_t count) {
+		return std::chrono::duration<double, std::milli>(interval * count).count();
+	};
+	output << "Profile: " << samples << " samples, one every " << interval.count() << " us of CPU time\n";
+	output << std::setw(12) << "calls" << std::setw(14) << "inclusive_ms" << std::setw(14) << "exclusive_ms" << "  function\n";
+	output << std::fixed << std::setprecision(1);
+	for (auto function : order) {
+		output << std::setw(12) << calls[function] << std::setw(14) << milliseconds(inclusive[function])
+			<< std::setw(14) << milliseconds(exclusive[function]) << "  " << names[function] << '\n';
+	}
+
+	std::map<std::size_t, std::size_t> line_samples;
+	for (auto& [offset, count] : offsets) {
+		line_samples[lines.line(offset)] += count;
+	}
+	std::vector<std::pair<std::size_t, std::size_t>> hottest(line_samples.begin(), line_samples.end());
+	std::stable_sort(hottest.begin(), hottest.end(), [](auto& a, auto& b) { return a.second > b.second; });
+	hottest.resize(std::min<std::size_t>(hottest.size(), 20));
+	output << std::setw(12) << "line" << std::setw(14) << "samples" << '\n';
+	for (auto& [line, count] : hottest) {
+		output << std::setw(12) << line << std::setw(14) << count << '\n';
+	}
+	output << std::defaultfloat;
+}
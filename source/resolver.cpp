@@ -0,0 +1,395 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "resolver.hpp"
+#include "builtins.hpp"
+
+static Expression* strip_parentheses(Expression* expression) {
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	return expression;
+}
+
+static IdentifierExpression* variable_of(Expression* expression) {
+	return dynamic_cast<IdentifierExpression*>(strip_parentheses(expression));
+}
+
+// Within a function, two symbols are the same variable exactly when they
+// share a depth and a slot while the first is in scope
+static bool same(const Symbol& lhs, const Symbol& rhs) {
+	return lhs.depth == rhs.depth && lhs.slot == rhs.slot;
+}
+
+// `s += x` or `s = s + x` for a local string s
+static bool appends_to_local_string(const BinaryOperation& node) {
+	auto target = variable_of(node.lhs);
+	if (!target || target->symbol.global() || !target->symbol.type || target->symbol.type->value_type != ValueType::STRING) {
+		return false;
+	}
+	if (node.op == Token::PLUS_ASSIGNMENT) {
+		return true;
+	}
+	auto sum = dynamic_cast<BinaryOperation*>(node.rhs);
+	auto operand = node.op == Token::ASSIGNMENT && sum && sum->op == Token::PLUS ? variable_of(sum->lhs) : nullptr;
+	return operand && same(operand->symbol, target->symbol);
+}
+
+static bool non_negative_literal(Expression* expression) {
+	auto literal = dynamic_cast<IntLiteral*>(strip_parentheses(expression));
+	return literal && literal->value >= 0;
+}
+
+// `int i = 0;` or `i = 0;`, with any literal that is not negative
+static bool starts_non_negative(const Statement* statement, const Symbol& index) {
+	if (auto declaration = dynamic_cast<const DeclarationStatement*>(statement)) {
+		auto& declarators = declaration->declaration->declarator_list;
+		return declarators.size() == 1 && same(declarators[0]->declarator->symbol, index) && declarators[0]->initializer
+			&& non_negative_literal(declarators[0]->initializer);
+	} else if (auto expression = dynamic_cast<const ExpressionStatement*>(statement)) {
+		auto assignment = dynamic_cast<BinaryOperation*>(expression->expression);
+		auto target = assignment ? variable_of(assignment->lhs) : nullptr;
+		return target && assignment->op == Token::ASSIGNMENT && same(target->symbol, index) && non_negative_literal(assignment->rhs);
+	}
+	return false;
+}
+
+// i++, ++i or i += 1. Since i < len(a) held before it, i cannot wrap around.
+static bool steps(Expression* expression, const Symbol& index) {
+	IdentifierExpression* target = nullptr;
+	if (auto increment = dynamic_cast<PostfixIncrementExpression*>(expression)) {
+		target = variable_of(increment->base);
+	} else if (auto prefix = dynamic_cast<PrefixExpression*>(expression); prefix && prefix->op == Token::INCREMENT) {
+		target = variable_of(prefix->base);
+	} else if (auto operation = dynamic_cast<BinaryOperation*>(expression);
+		operation && Token::compound_operator(operation->op) == Token::PLUS) {
+		auto one = dynamic_cast<IntLiteral*>(strip_parentheses(operation->rhs));
+		target = one && one->value == 1 ? variable_of(operation->lhs) : nullptr;
+	}
+	return target && same(target->symbol, index);
+}
+
+void Resolver::resolve(TranslationUnit& unit) {
+	types = &unit.types;
+	symbols = SymbolTable();
+	functions.clear();
+	call_sites = 0;
+	loops.clear();
+	preceding = current = nullptr;
+	unit.accept(*this);
+	unit.call_site_count = call_sites;
+	types = nullptr;
+}
+
+// Globals are visible from every function body regardless of their position
+// in the file, matching the order in which the engines initialize them.
+void Resolver::visit(TranslationUnit& node) {
+	for (auto& decl : node.declarations) {
+		auto func = dynamic_cast<FuncDeclaration*>(decl);
+		if (!func) {
+			continue;
+		}
+		std::vector<const Type*> parameters;
+		for (auto& arg : func->args) {
+			parameters.push_back(declarator_type(*arg->init_declarator->declarator, arg->type));
+		}
+		func->signature = types->function(declarator_type(*func->declarator, func->type), parameters);
+		auto [function, inserted] = functions.emplace(func->declarator->name, func->signature);
+		if (!inserted && function->second != func->signature) {
+			throw std::runtime_error("Conflicting declarations of function " + std::string(func->declarator->name));
+		}
+	}
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<VarDeclaration*>(decl)) {
+			decl->accept(*this);
+		}
+	}
+	for (auto& decl : node.declarations) {
+		if (dynamic_cast<FuncDeclaration*>(decl)) {
+			decl->accept(*this);
+		}
+	}
+	node.global_count = symbols.global_count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Resolver::visit(Declaration::NoPtrDeclarator&) {}
+
+void Resolver::visit(Declaration::PtrDeclarator&) {}
+
+void Resolver::visit(Declaration::ArrayDeclarator& node) {
+	if (node.size) {
+		node.size->accept(*this);
+	}
+}
+
+void Resolver::visit(Declaration::InitDeclarator& node) {
+	if (node.initializer) {
+		node.initializer->accept(*this);
+	}
+	node.declarator->accept(*this);
+}
+
+void Resolver::visit(VarDeclaration& node) {
+	for (auto& declarator : node.declarator_list) {
+		auto array = dynamic_cast<Declaration::ArrayDeclarator*>(declarator->declarator);
+		if (array && array->size && declarator->initializer) {
+			throw std::runtime_error("Array " + std::string(array->name) + " cannot have both a size and an initializer");
+		}
+		declare(*declarator, node.type);
+		if (declarator->declarator->symbol.type->kind == Type::VOID) {
+			throw std::runtime_error("Variable " + std::string(declarator->declarator->name) + " declared void");
+		}
+	}
+}
+
+void Resolver::visit(ParameterDeclaration& node) {
+	auto array = dynamic_cast<Declaration::ArrayDeclarator*>(node.init_declarator->declarator);
+	if (array && array->size) {
+		throw std::runtime_error("Parameter " + std::string(array->name) + " cannot have an array size");
+	}
+	declare(*node.init_declarator, node.type);
+}
+
+void Resolver::visit(FuncDeclaration& node) {
+	function = &node;
+	symbols.begin_function();
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	if (node.body) {
+		node.body->accept(*this);
+	}
+	node.frame_size = symbols.end_function();
+	function = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Resolver::visit(CompoundStatement& node) {
+	symbols.enter();
+	const Statement* previous = nullptr;
+	for (auto& statement : node.statements) {
+		preceding = previous;
+		current = statement;
+		statement->accept(*this);
+		previous = statement;
+	}
+	symbols.leave();
+}
+
+void Resolver::visit(DeclarationStatement& node) {
+	node.declaration->accept(*this);
+}
+
+void Resolver::visit(ExpressionStatement& node) {
+	node.expression->accept(*this);
+}
+
+void Resolver::visit(ConditionalStatement& node) {
+	node.if_branch.first->accept(*this);
+	node.if_branch.second->accept(*this);
+	for (auto& branch : node.elif_branches) {
+		branch.first->accept(*this);
+		branch.second->accept(*this);
+	}
+	if (node.else_branch) {
+		node.else_branch->accept(*this);
+	}
+}
+
+void Resolver::visit(WhileStatement& node) {
+	auto before = current == &node ? preceding : nullptr;
+	node.condition->accept(*this);
+	if (!bound(node, before)) {
+		node.statement->accept(*this);
+		return;
+	}
+	node.statement->accept(*this);
+	// The body's names are only bound now
+	if (loops.back().proved && steps(loops.back().step, loops.back().index)) {
+		for (auto subscript : loops.back().subscripts) {
+			subscript->checked = false;
+		}
+	}
+	loops.pop_back();
+}
+
+void Resolver::visit(RepeatStatement& node) {
+	node.statement->accept(*this);
+}
+
+void Resolver::visit(ForStatement&) {}
+
+void Resolver::visit(ReturnStatement& node) {
+	node.tail_call = nullptr;
+	if (!node.expression) {
+		return;
+	}
+	node.expression->accept(*this);
+	auto expression = node.expression;
+	while (auto parenthesized = dynamic_cast<ParenthesizedExpression*>(expression)) {
+		expression = parenthesized->expression;
+	}
+	auto call = dynamic_cast<FunctionCallExpression*>(expression);
+	auto callee = call ? dynamic_cast<IdentifierExpression*>(call->base) : nullptr;
+	if (callee && function) {
+		auto signature = functions.find(callee->name);
+		if (signature != functions.end() && signature->second->base->value_type == function->signature->base->value_type) {
+			node.tail_call = call;
+		}
+	}
+}
+
+void Resolver::visit(BreakStatement&) {}
+
+void Resolver::visit(ContinueStatement&) {}
+
+///////////////////////////////////////////////////////////////////
+
+void Resolver::visit(BinaryOperation& node) {
+	node.lhs->accept(*this);
+	auto before = writes;
+	node.rhs->accept(*this);
+	node.appends = writes == before && appends_to_local_string(node);
+	if (node.op == Token::ASSIGNMENT || Token::compound_operator(node.op) != Token::INVALID) {
+		write(node.lhs, &node);
+	}
+}
+
+void Resolver::visit(PrefixExpression& node) {
+	node.base->accept(*this);
+	if (node.op == Token::INCREMENT || node.op == Token::DECREMENT) {
+		write(node.base, &node);
+	}
+}
+
+void Resolver::visit(PostfixIncrementExpression& node) {
+	node.base->accept(*this);
+	write(node.base, &node);
+}
+
+void Resolver::visit(PostfixDecrementExpression& node) {
+	node.base->accept(*this);
+	write(node.base, &node);
+}
+
+void Resolver::visit(FunctionCallExpression& node) {
+	auto callee = dynamic_cast<IdentifierExpression*>(node.base);
+	if (!callee) {
+		throw std::runtime_error("Called object is not a function name");
+	}
+	if (!functions.contains(callee->name) && !find_builtin(callee->name)) {
+		throw std::runtime_error("Call to undeclared function " + std::string(callee->name));
+	}
+	node.site = call_sites++;
+	for (auto& arg : node.args) {
+		arg->accept(*this);
+	}
+	if (functions.contains(callee->name) || callee->name == "resize") {
+		for (auto& loop : loops) {
+			loop.proved = false;
+		}
+	}
+}
+
+void Resolver::visit(SubscriptExpression& node) {
+	node.base->accept(*this);
+	node.index->accept(*this);
+	node.checked = true;
+	auto array = variable_of(node.base), index = variable_of(node.index);
+	if (!array || !index) {
+		return;
+	}
+	for (auto& loop : loops) {
+		if (same(array->symbol, loop.array) && same(index->symbol, loop.index)) {
+			loop.subscripts.push_back(&node);
+		}
+	}
+}
+
+void Resolver::visit(IdentifierExpression& node) {
+	auto symbol = symbols.find(node.name);
+	if (!symbol) {
+		throw std::runtime_error("Use of undeclared identifier " + std::string(node.name));
+	}
+	node.symbol = *symbol;
+}
+
+void Resolver::visit(IntLiteral&) {}
+
+void Resolver::visit(FloatLiteral&) {}
+
+void Resolver::visit(CharLiteral&) {}
+
+void Resolver::visit(StringLiteral&) {}
+
+void Resolver::visit(BoolLiteral&) {}
+
+void Resolver::visit(ParenthesizedExpression& node) {
+	node.expression->accept(*this);
+}
+
+///////////////////////////////////////////////////////////////////
+
+const Type* Resolver::declarator_type(Declaration::Declarator& declarator, std::string_view name) {
+	auto type = types->named(name);
+	if (dynamic_cast<Declaration::PtrDeclarator*>(&declarator)) {
+		type = types->pointer(type);
+	} else if (dynamic_cast<Declaration::ArrayDeclarator*>(&declarator)) {
+		type = types->array(type);
+	}
+	return type;
+}
+
+// The initializer is resolved first, so `int x = x;` refers to an outer x.
+void Resolver::declare(Declaration::InitDeclarator& node, std::string_view type) {
+	node.accept(*this);
+	auto& declarator = *node.declarator;
+	declarator.symbol = symbols.declare(declarator.name, declarator_type(declarator, type));
+}
+
+// Starts a BoundedLoop for `while (i < len(a))` when the statement before the
+// loop sets i to a literal that is not negative and the body ends in an
+// expression statement, unless len is a user function.
+bool Resolver::bound(WhileStatement& node, const Statement* before) {
+	auto condition = dynamic_cast<BinaryOperation*>(strip_parentheses(node.condition));
+	if (!condition || condition->op != Token::LESS || functions.contains("len")) {
+		return false;
+	}
+	auto index = variable_of(condition->lhs);
+	auto call = dynamic_cast<FunctionCallExpression*>(strip_parentheses(condition->rhs));
+	if (!index || !call || call->args.size() != 1) {
+		return false;
+	}
+	auto callee = dynamic_cast<IdentifierExpression*>(call->base);
+	auto array = variable_of(call->args[0]);
+	if (!callee || callee->name != "len" || !array || index->symbol.type->kind != Type::INT
+		|| array->symbol.type->kind != Type::ARRAY || !starts_non_negative(before, index->symbol)) {
+		return false;
+	}
+	auto body = dynamic_cast<CompoundStatement*>(node.statement);
+	auto last = body && !body->statements.empty() ? dynamic_cast<ExpressionStatement*>(body->statements.back()) : nullptr;
+	if (!last) {
+		return false;
+	}
+	loops.push_back(BoundedLoop{index->symbol, array->symbol, last->expression, {}});
+	return true;
+}
+
+// Assigning or stepping a variable ends the proof of every enclosing loop
+// over it, except for the loop's own step.
+void Resolver::write(Expression* target, const Expression* node) {
+	auto variable = variable_of(target);
+	if (!variable) {
+		return;
+	}
+	++writes;
+	for (auto& loop : loops) {
+		if (node != loop.step && (same(variable->symbol, loop.index) || same(variable->symbol, loop.array))) {
+			loop.proved = false;
+		}
+	}
+}
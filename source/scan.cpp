@@ -0,0 +1,181 @@
+#include <bit>
+#include <cstdint>
+
+#include "scan.hpp"
+
+#if !defined(SCAN_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+
+struct Simd {
+	using Vector = __m256i;
+	using Mask = std::uint32_t;
+	static constexpr std::size_t width = 32;
+	static constexpr int bits_per_byte = 1;
+	static constexpr Mask all = 0xFFFFFFFF;
+	static constexpr std::string_view name = "avx2";
+
+	static Vector load(const char* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+	static Vector equal(Vector v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+	static Vector lower(Vector v) { return _mm256_or_si256(v, _mm256_set1_epi8(0x20)); }
+	static Vector either(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+	static Vector both(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+	static Vector in_range(Vector v, char low, char high) {
+		auto offset = _mm256_sub_epi8(v, _mm256_set1_epi8(low));
+		return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(high - low)), offset);
+	}
+	static Mask mask(Vector v) { return static_cast<Mask>(_mm256_movemask_epi8(v)); }
+};
+
+#elif !defined(SCAN_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+
+struct Simd {
+	using Vector = __m128i;
+	using Mask = std::uint32_t;
+	static constexpr std::size_t width = 16;
+	static constexpr int bits_per_byte = 1;
+	static constexpr Mask all = 0xFFFF;
+	static constexpr std::string_view name = "sse2";
+
+	static Vector load(const char* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+	static Vector equal(Vector v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+	static Vector lower(Vector v) { return _mm_or_si128(v, _mm_set1_epi8(0x20)); }
+	static Vector either(Vector a, Vector b) { return _mm_or_si128(a, b); }
+	static Vector both(Vector a, Vector b) { return _mm_and_si128(a, b); }
+	static Vector in_range(Vector v, char low, char high) {
+		auto offset = _mm_sub_epi8(v, _mm_set1_epi8(low));
+		return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(high - low)), offset);
+	}
+	static Mask mask(Vector v) { return static_cast<Mask>(_mm_movemask_epi8(v)); }
+};
+
+#elif !defined(SCAN_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+// NEON has no movemask; narrowing each 16-bit lane by 4 leaves one nibble
+// per byte in a 64-bit mask instead.
+struct Simd {
+	using Vector = uint8x16_t;
+	using Mask = std::uint64_t;
+	static constexpr std::size_t width = 16;
+	static constexpr int bits_per_byte = 4;
+	static constexpr Mask all = ~Mask(0);
+	static constexpr std::string_view name = "neon";
+
+	static Vector load(const char* data) { return vld1q_u8(reinterpret_cast<const std::uint8_t*>(data)); }
+	static Vector equal(Vector v, char c) { return vceqq_u8(v, vdupq_n_u8(c)); }
+	static Vector lower(Vector v) { return vorrq_u8(v, vdupq_n_u8(0x20)); }
+	static Vector either(Vector a, Vector b) { return vorrq_u8(a, b); }
+	static Vector both(Vector a, Vector b) { return vandq_u8(a, b); }
+	static Vector in_range(Vector v, char low, char high) {
+		return vcleq_u8(vsubq_u8(v, vdupq_n_u8(low)), vdupq_n_u8(high - low));
+	}
+	static Mask mask(Vector v) {
+		return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+	}
+};
+
+#else
+#define SCAN_SCALAR 1
+#endif
+
+static bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static bool is_identifier(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+}
+
+#ifndef SCAN_SCALAR
+template<typename Mask>
+static std::size_t first(Mask mask) {
+	return std::countr_zero(mask) / Simd::bits_per_byte;
+}
+
+// Advances over whole blocks while every byte belongs to the class and
+// returns the position of the first one that does not.
+template<typename Class>
+static std::size_t skip_blocks(std::string_view input, std::size_t offset, Class in_class) {
+	for (; offset + Simd::width <= input.size(); offset += Simd::width) {
+		if (auto outside = ~Simd::mask(in_class(Simd::load(input.data() + offset))) & Simd::all) {
+			return offset + first(outside);
+		}
+	}
+	return offset;
+}
+#endif
+
+template<typename Class>
+static std::size_t skip_bytes(std::string_view input, std::size_t offset, Class in_class) {
+	while (offset < input.size() && in_class(input[offset])) {
+		++offset;
+	}
+	return offset;
+}
+
+std::size_t scan_whitespace(std::string_view input, std::size_t offset) {
+#ifndef SCAN_SCALAR
+	offset = skip_blocks(input, offset, [](Simd::Vector v) {
+		return Simd::either(Simd::equal(v, ' '), Simd::in_range(v, '\t', '\r'));
+	});
+#endif
+	return skip_bytes(input, offset, is_space);
+}
+
+std::size_t scan_identifier(std::string_view input, std::size_t offset) {
+#ifndef SCAN_SCALAR
+	offset = skip_blocks(input, offset, [](Simd::Vector v) {
+		auto letter = Simd::in_range(Simd::lower(v), 'a', 'z');
+		return Simd::either(Simd::either(letter, Simd::in_range(v, '0', '9')), Simd::equal(v, '_'));
+	});
+#endif
+	return skip_bytes(input, offset, is_identifier);
+}
+
+std::size_t scan_digits(std::string_view input, std::size_t offset) {
+#ifndef SCAN_SCALAR
+	offset = skip_blocks(input, offset, [](Simd::Vector v) {
+		return Simd::in_range(v, '0', '9');
+	});
+#endif
+	return skip_bytes(input, offset, is_digit);
+}
+
+std::size_t scan_line_end(std::string_view input, std::size_t offset) {
+#ifndef SCAN_SCALAR
+	offset = skip_blocks(input, offset, [](Simd::Vector v) {
+		return ~Simd::equal(v, '\n');
+	});
+#endif
+	return skip_bytes(input, offset, [](char c) { return c != '\n'; });
+}
+
+std::size_t scan_comment_end(std::string_view input, std::size_t offset) {
+#ifndef SCAN_SCALAR
+	for (; offset + 1 + Simd::width <= input.size(); offset += Simd::width) {
+		auto data = input.data() + offset;
+		if (auto end = Simd::mask(Simd::both(Simd::equal(Simd::load(data), '*'), Simd::equal(Simd::load(data + 1), '/')))) {
+			return offset + first(end);
+		}
+	}
+#endif
+	for (; offset + 1 < input.size(); ++offset) {
+		if (input[offset] == '*' && input[offset + 1] == '/') {
+			return offset;
+		}
+	}
+	return std::string_view::npos;
+}
+
+std::string_view scan_implementation() {
+#ifndef SCAN_SCALAR
+	return Simd::name;
+#else
+	return "scalar";
+#endif
+}
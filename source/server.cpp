@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "server.hpp"
+
+namespace {
+
+// Buffered reads and whole writes on a stream socket. Reads return false
+// when the peer closes the connection first or, for a line, sends more than
+// max_line bytes without ending it.
+struct Channel {
+	static constexpr std::size_t max_line = 64 * 1024;
+
+	int fd;
+	std::string& buffer;
+
+	bool fill() {
+		char chunk[64 * 1024];
+		while (true) {
+			auto count = ::read(fd, chunk, sizeof(chunk));
+			if (count < 0 && errno == EINTR) {
+				continue;
+			} else if (count <= 0) {
+				return false;
+			}
+			buffer.append(chunk, count);
+			return true;
+		}
+	}
+
+	bool read_line(std::string& line) {
+		std::size_t end;
+		while ((end = buffer.find('\n')) == std::string::npos) {
+			if (buffer.size() > max_line || !fill()) {
+				return false;
+			}
+		}
+		line.assign(buffer, 0, end);
+		buffer.erase(0, end + 1);
+		return true;
+	}
+
+	bool read(std::size_t size, std::string& bytes) {
+		while (buffer.size() < size) {
+			if (!fill()) {
+				return false;
+			}
+		}
+		bytes.assign(buffer, 0, size);
+		buffer.erase(0, size);
+		return true;
+	}
+
+	void write(std::string_view bytes) {
+		while (!bytes.empty()) {
+			auto count = ::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+			if (count < 0 && errno == EINTR) {
+				continue;
+			} else if (count < 0) {
+				throw std::runtime_error(std::string("Failed to write to socket (") + std::strerror(errno) + ")");
+			}
+			bytes.remove_prefix(count);
+		}
+	}
+};
+
+sockaddr_un socket_address(const std::string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Socket path " + path + " is too long");
+	}
+	std::copy(path.begin(), path.end(), address.sun_path);
+	return address;
+}
+
+constexpr const char* shutdown_message = "Server is shutting down";
+
+bool parse_size(std::string_view text, std::size_t& size) {
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), size);
+	return error == std::errc() && end == text.data() + text.size();
+}
+
+}
+
+Server::Server(
+	const Interpreter::Options& options,
+	const std::string& path,
+	std::size_t jobs,
+	std::chrono::milliseconds time_limit
+	) : options(options), path(path), cache(cache_capacity), slots(jobs ? jobs : std::max(1u, std::thread::hardware_concurrency())),
+	time_limit(time_limit), time_limit_message("Time limit of " + std::to_string(time_limit.count()) + " ms exceeded") {
+	this->options.memory_cache = &cache;
+	// Requests already run side by side, and a request's memory limit only
+	// counts the allocations of the thread that runs it
+	this->options.parse_threads = 1;
+}
+
+int Server::run() {
+	auto address = socket_address(path);
+	int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener < 0) {
+		throw std::runtime_error(std::string("Failed to create socket (") + std::strerror(errno) + ")");
+	}
+	// A socket left behind by a server that did not shut down cleanly
+	::unlink(path.c_str());
+	if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+		auto error = std::string(std::strerror(errno));
+		::close(listener);
+		throw std::runtime_error("Failed to listen on " + path + " (" + error + ")");
+	}
+
+	// Blocked before any connection thread starts, so every thread inherits
+	// the mask and the signals are only ever read from the signalfd.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+	int stop = ::signalfd(-1, &signals, SFD_CLOEXEC);
+
+	std::jthread watchdog;
+	if (time_limit.count() > 0) {
+		watchdog = std::jthread([this](std::stop_token token) { watch(token); });
+	}
+
+	pollfd descriptors[] = {{listener, POLLIN, 0}, {stop, POLLIN, 0}};
+	while (true) {
+		if (::poll(descriptors, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (descriptors[1].revents) {
+			// Consumed, or it is delivered once the mask is lifted
+			signalfd_siginfo info;
+			while (::read(stop, &info, sizeof(info)) < 0 && errno == EINTR) {}
+			break;
+		}
+		if (descriptors[0].revents & POLLIN) {
+			int connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (connection < 0) {
+				continue;
+			}
+			// A read or write that waits longer fails and ends the connection
+			timeval timeout{idle_timeout, 0};
+			::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			::setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+			std::lock_guard lock(mutex);
+			if (connections.size() >= max_connections) {
+				::close(connection);
+				continue;
+			}
+			connections.insert(connection);
+			std::thread(&Server::serve, this, connection).detach();
+		}
+	}
+
+	::close(listener);
+	::unlink(path.c_str());
+	// Requests in flight are stopped and answered, then their connections see
+	// end of input and close.
+	std::unique_lock lock(mutex);
+	stopping = true;
+	for (auto request : running) {
+		request->stop.store(shutdown_message, std::memory_order_relaxed);
+	}
+	for (auto connection : connections) {
+		::shutdown(connection, SHUT_RD);
+	}
+	closed.wait(lock, [&] { return connections.empty(); });
+	::close(stop);
+	::pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+	return 0;
+}
+
+void Server::serve(int connection) {
+	std::string buffer;
+	Channel channel{connection, buffer};
+	std::string header;
+	std::string body;
+	auto source_limit = options.memory_limit ? options.memory_limit : max_source_size;
+	auto respond = [&](int status, std::string_view output, std::string_view errors) {
+		channel.write(std::to_string(status) + " " + std::to_string(output.size()) + " " + std::to_string(errors.size()) + "\n");
+		channel.write(output);
+		channel.write(errors);
+	};
+	try {
+		while (channel.read_line(header)) {
+			std::string_view request = header;
+			std::size_t size;
+			bool inline_source = request.starts_with("source ");
+			if (inline_source) {
+				if (!parse_size(request.substr(std::string_view("source ").size()), size) || size > source_limit) {
+					respond(1, {}, "Error: Malformed request\n");
+					break;
+				} else if (!channel.read(size, body)) {
+					break;
+				}
+			} else if (request.starts_with("path ")) {
+				body = request.substr(std::string_view("path ").size());
+			} else {
+				respond(1, {}, "Error: Malformed request\n");
+				break;
+			}
+
+			std::ostringstream output;
+			std::ostringstream errors;
+			int status;
+			slots.acquire();
+			Running job;
+			{
+				std::lock_guard lock(mutex);
+				job.deadline = std::chrono::steady_clock::now() + time_limit;
+				if (stopping) {
+					job.stop.store(shutdown_message, std::memory_order_relaxed);
+				}
+				running.insert(&job);
+			}
+			try {
+				auto request_options = options;
+				request_options.stop = &job.stop;
+				Interpreter interpreter(request_options, output, errors);
+				status = inline_source ? interpreter.interpret(body) : interpreter.interpret_file(body);
+			} catch (const std::exception& e) {
+				errors << "Error: " << e.what() << "\n";
+				status = 1;
+			}
+			{
+				std::lock_guard lock(mutex);
+				running.erase(&job);
+			}
+			slots.release();
+			// A capture that grew past the memory limit stopped taking writes
+			std::string diagnostics(errors.view());
+			if (output.bad() || errors.bad()) {
+				diagnostics += "Error: Output exceeded memory limit\n";
+				status = 1;
+			}
+			respond(status, output.view(), diagnostics);
+		}
+	} catch (const std::exception&) {
+		// The client went away mid-response; nothing is left to answer
+	}
+	// Closed under the lock, so the descriptor cannot be reused by a new
+	// connection while it is still listed
+	std::lock_guard lock(mutex);
+	connections.erase(connection);
+	::close(connection);
+	closed.notify_all();
+}
+
+// Stops the requests past their deadline, checking a tenth of the time limit
+// apart, so a request overruns it by at most that much.
+void Server::watch(std::stop_token token) {
+	auto tick = std::clamp<std::chrono::milliseconds>(time_limit / 10, std::chrono::milliseconds(1), std::chrono::milliseconds(100));
+	std::condition_variable_any wake;
+	std::unique_lock lock(mutex);
+	while (!token.stop_requested()) {
+		wake.wait_for(lock, token, tick, [] { return false; });
+		auto now = std::chrono::steady_clock::now();
+		for (auto request : running) {
+			if (now >= request->deadline) {
+				request->stop.store(time_limit_message.c_str(), std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Client::Client(const std::string& path) {
+	auto address = socket_address(path);
+	fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		auto error = std::string(std::strerror(errno));
+		if (fd >= 0) {
+			::close(fd);
+		}
+		throw std::runtime_error("Failed to connect to " + path + " (" + error + ")");
+	}
+}
+
+Client::~Client() {
+	::close(fd);
+}
+
+Client::Response Client::run_file(const std::string& path) {
+	return request("path " + std::filesystem::absolute(path).string() + "\n", {});
+}
+
+Client::Response Client::run_source(std::string_view source) {
+	return request("source " + std::to_string(source.size()) + "\n", source);
+}
+
+Client::Response Client::request(const std::string& header, std::string_view body) {
+	Channel channel{fd, buffer};
+	channel.write(header);
+	channel.write(body);
+
+	std::string line;
+	if (!channel.read_line(line)) {
+		throw std::runtime_error("Connection closed by server");
+	}
+	Response response;
+	std::size_t output_size;
+	std::size_t error_size;
+	std::istringstream fields(line);
+	if (!(fields >> response.status >> output_size >> error_size)
+		|| !channel.read(output_size, response.output) || !channel.read(error_size, response.errors)) {
+		throw std::runtime_error("Malformed response from server");
+	}
+	return response;
+}
@@ -0,0 +1,234 @@
+#include "sexp_printer.hpp"
+
+SexpPrinter::SexpPrinter(std::ostream& sink) : out(sink) {}
+
+void SexpPrinter::visit(TranslationUnit& node) {
+	out << "(unit";
+	for (auto& decl : node.declarations) {
+		out << "\n ";
+		decl->accept(*this);
+	}
+	out << ")\n";
+	out.flush();
+}
+
+void SexpPrinter::visit(Declaration::NoPtrDeclarator& node) {
+	out << node.name;
+}
+
+void SexpPrinter::visit(Declaration::PtrDeclarator& node) {
+	out << "(ptr " << node.name << ")";
+}
+
+void SexpPrinter::visit(Declaration::ArrayDeclarator& node) {
+	out << "(array " << node.name;
+	if (node.size) {
+		out << " ";
+		node.size->accept(*this);
+	}
+	out << ")";
+}
+
+void SexpPrinter::visit(Declaration::InitDeclarator& node) {
+	if (!node.initializer) {
+		node.declarator->accept(*this);
+		return;
+	}
+	out << "(init ";
+	node.declarator->accept(*this);
+	out << " ";
+	node.initializer->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(VarDeclaration& node) {
+	out << "(var " << node.type;
+	print_all(node.declarator_list);
+	out << ")";
+}
+
+void SexpPrinter::visit(ParameterDeclaration& node) {
+	out << "(param " << node.type << " ";
+	node.init_declarator->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(FuncDeclaration& node) {
+	out << "(function " << node.type << " ";
+	node.declarator->accept(*this);
+	out << " (params";
+	print_all(node.args);
+	out << ") ";
+	if (node.body) {
+		node.body->accept(*this);
+	} else {
+		out << "nil";
+	}
+	out << ")";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SexpPrinter::visit(CompoundStatement& node) {
+	out << "(block";
+	print_all(node.statements);
+	out << ")";
+}
+
+void SexpPrinter::visit(DeclarationStatement& node) {
+	node.declaration->accept(*this);
+}
+
+void SexpPrinter::visit(ExpressionStatement& node) {
+	out << "(expr ";
+	node.expression->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(ConditionalStatement& node) {
+	out << "(if ";
+	node.if_branch.first->accept(*this);
+	out << " ";
+	node.if_branch.second->accept(*this);
+	for (auto& branch : node.elif_branches) {
+		out << " (elif ";
+		branch.first->accept(*this);
+		out << " ";
+		branch.second->accept(*this);
+		out << ")";
+	}
+	if (node.else_branch) {
+		out << " (else ";
+		node.else_branch->accept(*this);
+		out << ")";
+	}
+	out << ")";
+}
+
+void SexpPrinter::visit(WhileStatement& node) {
+	out << "(while ";
+	node.condition->accept(*this);
+	out << " ";
+	node.statement->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(ForStatement&) {
+	out << "(for)";
+}
+
+void SexpPrinter::visit(RepeatStatement& node) {
+	out << "(repeat ";
+	node.statement->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(ReturnStatement& node) {
+	out << "(return";
+	if (node.expression) {
+		out << " ";
+		node.expression->accept(*this);
+	}
+	out << ")";
+}
+
+void SexpPrinter::visit(BreakStatement&) {
+	out << "(break)";
+}
+
+void SexpPrinter::visit(ContinueStatement&) {
+	out << "(continue)";
+}
+
+///////////////////////////////////////////////////////////////////
+
+void SexpPrinter::visit(BinaryOperation& node) {
+	out << "(" << Token::spelling(node.op) << " ";
+	node.lhs->accept(*this);
+	out << " ";
+	node.rhs->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(PrefixExpression& node) {
+	out << "(prefix " << Token::spelling(node.op) << " ";
+	node.base->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(PostfixIncrementExpression& node) {
+	out << "(postfix ++ ";
+	node.base->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(PostfixDecrementExpression& node) {
+	out << "(postfix -- ";
+	node.base->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(SubscriptExpression& node) {
+	out << "(index ";
+	node.base->accept(*this);
+	out << " ";
+	node.index->accept(*this);
+	out << ")";
+}
+
+void SexpPrinter::visit(FunctionCallExpression& node) {
+	out << "(call ";
+	node.base->accept(*this);
+	print_all(node.args);
+	out << ")";
+}
+
+void SexpPrinter::visit(IdentifierExpression& node) {
+	out << node.name;
+}
+
+void SexpPrinter::visit(IntLiteral& node) {
+	out << node.value;
+}
+
+void SexpPrinter::visit(FloatLiteral& node) {
+	out << node.value;
+}
+
+void SexpPrinter::visit(CharLiteral& node) {
+	static const char digits[] = "0123456789abcdef";
+	auto c = static_cast<unsigned char>(node.value);
+	out << '\'';
+	if (c == '\'' || c == '\\') {
+		out << '\\' << node.value;
+	} else if (c < 0x20 || c >= 0x7f) {
+		out << "\\x" << digits[c >> 4] << digits[c & 0xf];
+	} else {
+		out << node.value;
+	}
+	out << '\'';
+}
+
+void SexpPrinter::visit(StringLiteral& node) {
+	out << '"' << escape(node.value) << '"';
+}
+
+void SexpPrinter::visit(BoolLiteral& node) {
+	out << (node.value ? "true" : "false");
+}
+
+void SexpPrinter::visit(ParenthesizedExpression& node) {
+	out << "(paren ";
+	node.expression->accept(*this);
+	out << ")";
+}
+
+///////////////////////////////////////////////////////////////////
+
+template<typename Items>
+void SexpPrinter::print_all(const Items& items) {
+	for (auto& item : items) {
+		out << " ";
+		item->accept(*this);
+	}
+}
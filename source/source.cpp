@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.hpp"
+#include "scan.hpp"
+
+SourceBuffer::SourceBuffer(const std::string& filepath) {
+	bool from_stdin = filepath == "-";
+	int fd = from_stdin ? STDIN_FILENO : ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open file: " + filepath + " (" + std::strerror(errno) + ")");
+	}
+
+	struct stat info;
+	if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		void* address = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address != MAP_FAILED) {
+			::madvise(address, info.st_size, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(address);
+			size = info.st_size;
+			mapped = true;
+		}
+	}
+	try {
+		if (!mapped) {
+			read_all(fd);
+		}
+	} catch (...) {
+		if (!from_stdin) {
+			::close(fd);
+		}
+		throw;
+	}
+	if (!from_stdin) {
+		::close(fd);
+	}
+}
+
+SourceBuffer::~SourceBuffer() {
+	if (mapped) {
+		::munmap(const_cast<char*>(data), size);
+	}
+}
+
+std::string_view SourceBuffer::view() const {
+	return {data, size};
+}
+
+bool SourceBuffer::is_mapped() const {
+	return mapped;
+}
+
+void SourceBuffer::read_all(int fd) {
+	constexpr std::size_t chunk_size = 64 * 1024;
+	for (std::size_t length = 0;;) {
+		buffer.resize(length + chunk_size);
+		auto count = ::read(fd, buffer.data() + length, chunk_size);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		} else if (count < 0) {
+			throw std::runtime_error(std::string("Failed to read source: ") + std::strerror(errno));
+		} else if (count == 0) {
+			buffer.resize(length);
+			break;
+		}
+		length += count;
+	}
+	data = buffer.data();
+	size = buffer.size();
+}
+
+LineTable::LineTable(std::string_view source) : starts{0} {
+	for (auto end = scan_line_end(source, 0); end < source.size(); end = scan_line_end(source, end + 1)) {
+		starts.push_back(end + 1);
+	}
+}
+
+std::size_t LineTable::line(std::size_t offset) const {
+	return std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin();
+}
+
+std::size_t LineTable::column(std::size_t offset) const {
+	return offset - starts[line(offset) - 1] + 1;
+}
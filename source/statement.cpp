@@ -1,7 +1,7 @@
 #include "visitor.hpp"
 
 CompoundStatement::CompoundStatement(
-	const std::vector<std::shared_ptr<Statement>>& statements
+	StatementSeq statements
 	) : statements(statements) {}
 
 void CompoundStatement::accept(Visitor& visitor) {
@@ -9,9 +9,9 @@ void CompoundStatement::accept(Visitor& visitor) {
 }
 
 ConditionalStatement::ConditionalStatement(
-	const std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>& if_branch,
-	const std::vector<std::pair<std::shared_ptr<Expression>, std::shared_ptr<Statement>>>& elif_branches,
-	const std::shared_ptr<Statement>& else_branch
+	const Branch& if_branch,
+	std::span<Branch> elif_branches,
+	Statement* else_branch
 	) : if_branch(if_branch), elif_branches(elif_branches), else_branch(else_branch) {}
 
 void ConditionalStatement::accept(Visitor& visitor) {
@@ -19,8 +19,8 @@ void ConditionalStatement::accept(Visitor& visitor) {
 }
 
 WhileStatement::WhileStatement(
-	const std::shared_ptr<Expression>& condition,
-	const std::shared_ptr<Statement>& statement
+	Expression* condition,
+	Statement* statement
 	) : condition(condition), statement(statement) {}
 
 void WhileStatement::accept(Visitor& visitor) {
@@ -28,7 +28,7 @@ void WhileStatement::accept(Visitor& visitor) {
 }
 
 RepeatStatement::RepeatStatement(
-		const std::shared_ptr<Statement>& statement
+		Statement* statement
 	) : statement(statement) {}
 
 void RepeatStatement::accept(Visitor& visitor) {
@@ -40,7 +40,7 @@ void ForStatement::accept(Visitor& visitor) {
 }
 
 ReturnStatement::ReturnStatement(
-	const std::shared_ptr<Expression>& expression
+	Expression* expression
 	) : expression(expression) {}
 
 void ReturnStatement::accept(Visitor& visitor) {
@@ -56,7 +56,7 @@ void ContinueStatement::accept(Visitor& visitor) {
 }
 
 DeclarationStatement::DeclarationStatement(
-	const std::shared_ptr<VarDeclaration>& declaration
+	VarDeclaration* declaration
 	) : declaration(declaration) {}
 
 void DeclarationStatement::accept(Visitor& visitor) {
@@ -64,7 +64,7 @@ void DeclarationStatement::accept(Visitor& visitor) {
 }
 
 ExpressionStatement::ExpressionStatement(
-	const std::shared_ptr<Expression>& expression
+	Expression* expression
 	) : expression(expression) {}
 
 void ExpressionStatement::accept(Visitor& visitor) {
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "stats.hpp"
+
+static std::atomic<std::size_t> allocation_count = 0;
+static std::atomic<std::size_t> allocation_bytes = 0;
+
+static thread_local std::size_t allocation_limit = 0;
+static thread_local std::ptrdiff_t held_bytes = 0;
+
+static void* account(void* memory) {
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	if (allocation_limit) {
+		held_bytes += ::malloc_usable_size(memory);
+		if (held_bytes > static_cast<std::ptrdiff_t>(allocation_limit)) {
+			held_bytes -= ::malloc_usable_size(memory);
+			std::free(memory);
+			allocation_limit = 0;
+			throw MemoryLimitExceeded();
+		}
+	}
+	return memory;
+}
+
+// A block allocated before the limit took effect and freed under it
+// does not leave room for more
+static void release(void* memory) {
+	if (allocation_limit && memory) {
+		held_bytes = std::max<std::ptrdiff_t>(0, held_bytes - static_cast<std::ptrdiff_t>(::malloc_usable_size(memory)));
+	}
+	std::free(memory);
+}
+
+// The array, nothrow and sized forms all forward to these by default.
+void* operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+	return account(std::malloc(size ? size : 1));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+	auto align = static_cast<std::size_t>(alignment);
+	return account(std::aligned_alloc(align, (size + align - 1) / align * align));
+}
+
+void operator delete(void* memory) noexcept {
+	release(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	release(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	release(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+	release(memory);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void write_string(std::ostream& output, std::string_view text) {
+	output << '"';
+	for (unsigned char c : text) {
+		if (c == '"' || c == '\\') {
+			output << '\\' << c;
+		} else if (c < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			output << escaped;
+		} else {
+			output << c;
+		}
+	}
+	output << '"';
+}
+
+Statistics::Statistics(bool enabled) : enabled(enabled), start(std::chrono::steady_clock::now()) {}
+
+bool Statistics::active() const {
+	return enabled;
+}
+
+void Statistics::count(std::string_view name, long long value) {
+	if (enabled) {
+		counters.emplace_back(name, value);
+	}
+}
+
+void Statistics::note(std::string_view name, std::string_view value) {
+	if (enabled) {
+		notes.emplace_back(name, value);
+	}
+}
+
+void Statistics::write(std::ostream& output) const {
+	std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+	output << "{\"total_ms\":" << total.count() << ",\"phases\":[";
+	for (std::size_t i = 0; i < phases.size(); ++i) {
+		auto& phase = phases[i];
+		output << (i ? "," : "") << "{\"name\":";
+		write_string(output, phase.name);
+		output << ",\"ms\":" << phase.milliseconds << ",\"allocations\":" << phase.allocations
+			<< ",\"allocated_bytes\":" << phase.allocated_bytes << ",\"peak_rss_kb\":" << phase.peak_rss_kb << "}";
+	}
+	output << "],\"counters\":{";
+	for (std::size_t i = 0; i < counters.size(); ++i) {
+		output << (i ? "," : "");
+		write_string(output, counters[i].first);
+		output << ":" << counters[i].second;
+	}
+	output << "},\"notes\":{";
+	for (std::size_t i = 0; i < notes.size(); ++i) {
+		output << (i ? "," : "");
+		write_string(output, notes[i].first);
+		output << ":";
+		write_string(output, notes[i].second);
+	}
+	output << "}}\n";
+}
+
+Statistics::Sample Statistics::sample() {
+	return Sample{std::chrono::steady_clock::now(), allocation_count.load(std::memory_order_relaxed),
+		allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+Statistics::Recorder::~Recorder() {
+	auto end = sample();
+	struct rusage usage;
+	::getrusage(RUSAGE_SELF, &usage);
+	std::chrono::duration<double, std::milli> elapsed = end.time - start.time;
+	statistics.phases.push_back(Phase{std::string(name), elapsed.count(), end.allocations - start.allocations,
+		end.allocated_bytes - start.allocated_bytes, usage.ru_maxrss});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AllocationLimit::AllocationLimit(std::size_t bytes) {
+	allocation_limit = bytes;
+	held_bytes = 0;
+}
+
+AllocationLimit::~AllocationLimit() {
+	allocation_limit = 0;
+}
+
+const char* MemoryLimitExceeded::what() const noexcept {
+	return "Memory limit exceeded";
+}
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "symbols.hpp"
+
+SymbolTable::SymbolTable() : scopes(1, Scope{{}, 0}) {}
+
+void SymbolTable::enter() {
+	scopes.push_back(Scope{{}, next_slot});
+}
+
+void SymbolTable::leave() {
+	next_slot = scopes.back().first_slot;
+	scopes.pop_back();
+}
+
+void SymbolTable::begin_function() {
+	next_slot = 0;
+	frame_size = 0;
+	enter();
+}
+
+std::size_t SymbolTable::end_function() {
+	leave();
+	return frame_size;
+}
+
+Symbol SymbolTable::declare(std::string_view name, const Type* type) {
+	auto depth = static_cast<std::uint32_t>(scopes.size() - 1);
+	Symbol symbol{depth, depth == 0 ? globals++ : next_slot++, type};
+	frame_size = std::max(frame_size, next_slot);
+	if (!scopes.back().symbols.emplace(name, symbol).second) {
+		throw std::runtime_error("Redefinition of " + std::string(depth == 0 ? "global " : "") + std::string(name));
+	}
+	return symbol;
+}
+
+const Symbol* SymbolTable::find(std::string_view name) const {
+	for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+		if (auto symbol = scope->symbols.find(name); symbol != scope->symbols.end()) {
+			return &symbol->second;
+		}
+	}
+	return nullptr;
+}
+
+std::size_t SymbolTable::global_count() const {
+	return globals;
+}
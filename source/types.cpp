@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "types.hpp"
+
+static_assert(Type::STRING == static_cast<int>(ValueType::STRING), "basic kinds must follow ValueType");
+
+std::string to_string(const Type* type) {
+	std::string result = type->is_const ? "const " : "";
+	switch (type->kind) {
+		case Type::POINTER:
+			return to_string(type->base) + "*" + (type->is_const ? " const" : "");
+		case Type::REFERENCE:
+			return to_string(type->base) + "&";
+		case Type::ARRAY:
+			return to_string(type->base) + "[]";
+		case Type::FUNCTION: {
+			result = to_string(type->base) + "(";
+			for (std::size_t i = 0; i < type->parameters.size(); ++i) {
+				result += (i ? ", " : "") + to_string(type->parameters[i]);
+			}
+			return result + ")";
+		}
+		default:
+			return result + std::string(type_name(type->value_type));
+	}
+}
+
+bool convertible(const Type* from, const Type* to) {
+	if (from->kind == Type::REFERENCE) {
+		from = from->base;
+	}
+	if (to->kind == Type::REFERENCE) {
+		to = to->base;
+	}
+	if (from == to || (from->is_arithmetic() && to->is_arithmetic())) {
+		return true;
+	}
+	switch (to->kind) {
+		case Type::STRING:
+			return from->kind == Type::STRING;
+		case Type::POINTER:
+			return from->kind == Type::POINTER && from->base == to->base;
+		case Type::ARRAY:
+			return from->kind == Type::ARRAY && from->base == to->base;
+		default:
+			return false;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TypeContext::TypeContext() {
+	for (int kind = Type::VOID; kind <= Type::STRING; ++kind) {
+		auto value_type = static_cast<ValueType>(kind);
+		for (bool is_const : {false, true}) {
+			basics[kind][is_const] = arena.make<Type>(static_cast<Type::Kind>(kind), is_const, value_type, nullptr,
+				std::span<const Type* const>());
+		}
+	}
+}
+
+const Type* TypeContext::basic(Type::Kind kind, bool is_const) {
+	if (kind > Type::STRING) {
+		throw std::logic_error("Type kind is not basic");
+	}
+	return basics[kind][is_const];
+}
+
+const Type* TypeContext::named(std::string_view name, bool is_const) {
+	return basic(static_cast<Type::Kind>(type_from_name(name)), is_const);
+}
+
+const Type* TypeContext::pointer(const Type* base, bool is_const) {
+	return intern(Key{Type::POINTER, is_const, base, {}});
+}
+
+const Type* TypeContext::reference(const Type* base) {
+	if (base->kind == Type::REFERENCE) {
+		return base;
+	}
+	return intern(Key{Type::REFERENCE, false, base, {}});
+}
+
+const Type* TypeContext::function(const Type* result, std::span<const Type* const> parameters) {
+	return intern(Key{Type::FUNCTION, false, result, parameters});
+}
+
+const Type* TypeContext::array(const Type* element) {
+	if (!element->is_arithmetic()) {
+		throw std::runtime_error("Arrays of " + to_string(element) + " are not supported");
+	}
+	return intern(Key{Type::ARRAY, false, basic(element->kind), {}});
+}
+
+std::size_t TypeContext::size() const {
+	return std::size(basics) * 2 + derived.size();
+}
+
+const Type* TypeContext::intern(const Key& key) {
+	if (auto type = derived.find(key); type != derived.end()) {
+		return type->second;
+	}
+	auto parameters = arena.copy(std::vector<const Type*>(key.parameters.begin(), key.parameters.end()));
+	// Arrays are the only derived types with a runtime representation
+	auto value_type = key.kind == Type::ARRAY ? array_of(key.base->value_type) : ValueType::NONE;
+	auto type = arena.make<Type>(key.kind, key.is_const, value_type, key.base, parameters);
+	derived.emplace(Key{key.kind, key.is_const, key.base, type->parameters}, type);
+	return type;
+}
+
+bool TypeContext::Key::operator==(const Key& other) const {
+	return kind == other.kind && is_const == other.is_const && base == other.base
+		&& std::ranges::equal(parameters, other.parameters);
+}
+
+std::size_t TypeContext::KeyHash::operator()(const Key& key) const {
+	auto hash = std::hash<const Type*>()(key.base) * 31 + key.kind * 2 + key.is_const;
+	for (auto parameter : key.parameters) {
+		hash = hash * 31 + std::hash<const Type*>()(parameter);
+	}
+	return hash;
+}
@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "value.hpp"
+#include "array.hpp"
+
+Value::Value(std::string_view text) : tag(ValueType::STRING) {
+	if (text.size() <= inline_capacity) {
+		inline_size = static_cast<std::uint8_t>(text.size());
+		std::copy_n(text.data(), text.size(), inline_data());
+	} else {
+		allocate(text.size(), text, {});
+	}
+}
+
+// Points the value at a new buffer holding head and then tail. The value's
+// own reference, if any, is released only once both have been copied.
+void Value::allocate(std::size_t capacity, std::string_view head, std::string_view tail) {
+	auto string = new (::operator new(sizeof(String) + capacity)) String{1, head.size() + tail.size(), capacity};
+	std::copy_n(head.data(), head.size(), string->data());
+	std::copy_n(tail.data(), tail.size(), string->data() + head.size());
+	if (inline_size == counted) {
+		release();
+	}
+	tag = ValueType::STRING;
+	inline_size = counted;
+	payload.string = string;
+}
+
+void Value::append(std::string_view tail) {
+	static_assert(offsetof(Value, text) + inline_capacity == sizeof(Value));
+	auto head = as_string();
+	auto size = head.size() + tail.size();
+	bool shared = false;
+	if (inline_size != counted) {
+		if (size <= inline_capacity) {
+			std::copy_n(tail.data(), tail.size(), inline_data() + inline_size);
+			inline_size = static_cast<std::uint8_t>(size);
+			return;
+		}
+	} else if (payload.string->references.load(std::memory_order_acquire) != 1) {
+		shared = true;
+	} else if (size <= payload.string->capacity) {
+		std::copy_n(tail.data(), tail.size(), payload.string->data() + head.size());
+		payload.string->size = size;
+		return;
+	}
+	// A copy of a shared buffer is most likely a one-off concatenation
+	allocate(shared ? size : std::max(size, 2 * head.size()), head, tail);
+}
+
+void Value::release() {
+	if (payload.string->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		payload.string->~String();
+		::operator delete(payload.string);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool is_numeric(const Value& value) {
+	auto type = type_of(value);
+	return type == ValueType::INT || type == ValueType::DOUBLE || type == ValueType::CHAR || type == ValueType::BOOL;
+}
+
+static int integer_of(const Value& value) {
+	switch (type_of(value)) {
+		case ValueType::INT: return value.as_int();
+		case ValueType::CHAR: return value.as_char();
+		case ValueType::BOOL: return value.as_bool();
+		case ValueType::DOUBLE: {
+			double number = value.as_double();
+			if (std::isnan(number)) {
+				return 0;
+			}
+			return number >= INT_MAX ? INT_MAX : number <= INT_MIN ? INT_MIN : static_cast<int>(number);
+		}
+		default: throw std::runtime_error("Expected a numeric value, got " + std::string(type_name(type_of(value))));
+	}
+}
+
+static double double_of(const Value& value) {
+	if (type_of(value) == ValueType::DOUBLE) {
+		return value.as_double();
+	}
+	return integer_of(value);
+}
+
+template<typename IntOperation, typename DoubleOperation>
+static Value arithmetic(const Value& lhs, const Value& rhs, const char* name, IntOperation int_operation, DoubleOperation double_operation) {
+	if (!is_numeric(lhs) || !is_numeric(rhs)) {
+		throw std::runtime_error(std::string("Invalid operands to ") + name + ": "
+			+ std::string(type_name(type_of(lhs))) + " and " + std::string(type_name(type_of(rhs))));
+	}
+	if (type_of(lhs) == ValueType::DOUBLE || type_of(rhs) == ValueType::DOUBLE) {
+		return double_operation(double_of(lhs), double_of(rhs));
+	}
+	return int_operation(integer_of(lhs), integer_of(rhs));
+}
+
+static int wrap(long long number) {
+	return static_cast<int>(static_cast<unsigned>(number));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+ValueType type_of(const Value& value) {
+	return value.type();
+}
+
+ValueType type_from_name(std::string_view name) {
+	if (name == "int") {
+		return ValueType::INT;
+	} else if (name == "double") {
+		return ValueType::DOUBLE;
+	} else if (name == "char") {
+		return ValueType::CHAR;
+	} else if (name == "bool") {
+		return ValueType::BOOL;
+	} else if (name == "string") {
+		return ValueType::STRING;
+	} else if (name == "void") {
+		return ValueType::NONE;
+	}
+	throw std::runtime_error("Unknown type " + std::string(name));
+}
+
+std::string_view type_name(ValueType type) {
+	switch (type) {
+		case ValueType::NONE: return "void";
+		case ValueType::INT: return "int";
+		case ValueType::DOUBLE: return "double";
+		case ValueType::CHAR: return "char";
+		case ValueType::BOOL: return "bool";
+		case ValueType::STRING: return "string";
+		case ValueType::INT_ARRAY: return "int[]";
+		case ValueType::DOUBLE_ARRAY: return "double[]";
+		case ValueType::CHAR_ARRAY: return "char[]";
+		case ValueType::BOOL_ARRAY: return "bool[]";
+	}
+	return "unknown";
+}
+
+Value default_value(ValueType type) {
+	switch (type) {
+		case ValueType::INT: return 0;
+		case ValueType::DOUBLE: return 0.0;
+		case ValueType::CHAR: return '\0';
+		case ValueType::BOOL: return false;
+		case ValueType::STRING: return std::string();
+		case ValueType::NONE: return Value();
+		default: return Array::make(element_of(type), 0, false);
+	}
+}
+
+Value convert(const Value& value, ValueType type) {
+	if (type_of(value) == type) {
+		return value;
+	}
+	if (type == ValueType::NONE) {
+		return Value();
+	}
+	if (type_of(value) == ValueType::NONE) {
+		throw std::runtime_error("Cannot use a void value as " + std::string(type_name(type)));
+	}
+	if (type != ValueType::STRING && is_numeric(value)) {
+		switch (type) {
+			case ValueType::INT: return integer_of(value);
+			case ValueType::DOUBLE: return double_of(value);
+			case ValueType::CHAR: return static_cast<char>(integer_of(value));
+			case ValueType::BOOL: return truthy(value);
+			default: break;
+		}
+	}
+	throw std::runtime_error("Cannot convert " + std::string(type_name(type_of(value))) + " to " + std::string(type_name(type)));
+}
+
+bool truthy(const Value& value) {
+	switch (type_of(value)) {
+		case ValueType::BOOL: return value.as_bool();
+		case ValueType::INT: return value.as_int() != 0;
+		case ValueType::DOUBLE: return value.as_double() != 0.0;
+		case ValueType::CHAR: return value.as_char() != '\0';
+		case ValueType::STRING: return !value.as_string().empty();
+		case ValueType::NONE: throw std::runtime_error("A void value cannot be used as a condition");
+		default: return value.as_array().size() != 0;
+	}
+}
+
+std::string to_string(const Value& value) {
+	switch (type_of(value)) {
+		case ValueType::INT: return std::to_string(value.as_int());
+		case ValueType::DOUBLE: {
+			char buffer[32];
+			auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.as_double());
+			return std::string(buffer, result.ptr);
+		}
+		case ValueType::CHAR: return std::string(1, value.as_char());
+		case ValueType::BOOL: return value.as_bool() ? "true" : "false";
+		case ValueType::STRING: return std::string(value.as_string());
+		case ValueType::NONE: return "";
+		default: {
+			auto& array = value.as_array();
+			std::string text = "[";
+			for (std::size_t i = 0; i < array.size(); ++i) {
+				text += (i ? ", " : "") + to_string(array.get(i));
+			}
+			return text + "]";
+		}
+	}
+}
+
+std::ostream& operator<<(std::ostream& output, const Value& value) {
+	switch (type_of(value)) {
+		case ValueType::INT: {
+			char buffer[16];
+			auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.as_int());
+			return output.write(buffer, result.ptr - buffer);
+		}
+		case ValueType::DOUBLE: {
+			char buffer[32];
+			auto result = std::to_chars(buffer, buffer + sizeof(buffer), value.as_double());
+			return output.write(buffer, result.ptr - buffer);
+		}
+		case ValueType::CHAR: return output << value.as_char();
+		case ValueType::BOOL: return output << (value.as_bool() ? "true" : "false");
+		case ValueType::STRING: return output << value.as_string();
+		case ValueType::NONE: return output;
+		default: {
+			auto& array = value.as_array();
+			output << '[';
+			for (std::size_t i = 0; i < array.size(); ++i) {
+				output << (i ? ", " : "") << array.get(i);
+			}
+			return output << ']';
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+Value add(const Value& lhs, const Value& rhs) {
+	if (type_of(lhs) == ValueType::STRING || type_of(rhs) == ValueType::STRING) {
+		Value sum = type_of(lhs) == ValueType::STRING ? lhs : Value(to_string(lhs));
+		add_to(sum, rhs);
+		return sum;
+	}
+	return arithmetic(lhs, rhs, "+",
+		[](int a, int b) -> Value { return wrap(static_cast<long long>(a) + b); },
+		[](double a, double b) -> Value { return a + b; });
+}
+
+void add_to(Value& lhs, const Value& rhs) {
+	if (type_of(lhs) != ValueType::STRING) {
+		lhs = add(lhs, rhs);
+	} else if (type_of(rhs) == ValueType::STRING) {
+		lhs.append(rhs.as_string());
+	} else {
+		lhs.append(to_string(rhs));
+	}
+}
+
+Value subtract(const Value& lhs, const Value& rhs) {
+	return arithmetic(lhs, rhs, "-",
+		[](int a, int b) -> Value { return wrap(static_cast<long long>(a) - b); },
+		[](double a, double b) -> Value { return a - b; });
+}
+
+Value multiply(const Value& lhs, const Value& rhs) {
+	return arithmetic(lhs, rhs, "*",
+		[](int a, int b) -> Value { return wrap(static_cast<long long>(a) * b); },
+		[](double a, double b) -> Value { return a * b; });
+}
+
+Value divide(const Value& lhs, const Value& rhs) {
+	return arithmetic(lhs, rhs, "/",
+		[](int a, int b) -> Value {
+			if (b == 0) {
+				throw std::runtime_error("Division by zero");
+			}
+			return wrap(static_cast<long long>(a) / b);
+		},
+		[](double a, double b) -> Value { return a / b; });
+}
+
+Value modulo(const Value& lhs, const Value& rhs) {
+	return arithmetic(lhs, rhs, "%",
+		[](int a, int b) -> Value {
+			if (b == 0) {
+				throw std::runtime_error("Division by zero");
+			}
+			return wrap(static_cast<long long>(a) % b);
+		},
+		[](double a, double b) -> Value { return std::fmod(a, b); });
+}
+
+Value power(const Value& lhs, const Value& rhs) {
+	return arithmetic(lhs, rhs, "**",
+		[](int a, int b) -> Value {
+			if (b < 0) {
+				return std::pow(static_cast<double>(a), b);
+			}
+			unsigned result = 1, base = a;
+			for (unsigned exponent = b; exponent; exponent >>= 1) {
+				if (exponent & 1) {
+					result *= base;
+				}
+				base *= base;
+			}
+			return static_cast<int>(result);
+		},
+		[](double a, double b) -> Value { return std::pow(a, b); });
+}
+
+template<typename ShiftOperation>
+static Value shift(const Value& lhs, const Value& rhs, const char* name, ShiftOperation shift_operation) {
+	if (!is_numeric(lhs) || !is_numeric(rhs) || type_of(lhs) == ValueType::DOUBLE || type_of(rhs) == ValueType::DOUBLE) {
+		throw std::runtime_error(std::string("Invalid operands to ") + name + ": "
+			+ std::string(type_name(type_of(lhs))) + " and " + std::string(type_name(type_of(rhs))));
+	}
+	auto count = integer_of(rhs);
+	if (count < 0 || count > 31) {
+		throw std::runtime_error("Shift count " + std::to_string(count) + " is out of range");
+	}
+	return shift_operation(integer_of(lhs), count);
+}
+
+Value shift_left(const Value& lhs, const Value& rhs) {
+	return shift(lhs, rhs, "<<", [](int a, int b) -> Value { return static_cast<int>(static_cast<unsigned>(a) << b); });
+}
+
+Value shift_right(const Value& lhs, const Value& rhs) {
+	return shift(lhs, rhs, ">>", [](int a, int b) -> Value { return a >> b; });
+}
+
+bool equal(const Value& lhs, const Value& rhs) {
+	if (is_numeric(lhs) && is_numeric(rhs)) {
+		if (type_of(lhs) == ValueType::DOUBLE || type_of(rhs) == ValueType::DOUBLE) {
+			return double_of(lhs) == double_of(rhs);
+		}
+		return integer_of(lhs) == integer_of(rhs);
+	}
+	if (type_of(lhs) != type_of(rhs)) {
+		return false;
+	}
+	if (is_array(type_of(lhs))) {
+		return &lhs.as_array() == &rhs.as_array();
+	}
+	return type_of(lhs) != ValueType::STRING || lhs.as_string() == rhs.as_string();
+}
+
+bool less(const Value& lhs, const Value& rhs) {
+	if (type_of(lhs) == ValueType::STRING && type_of(rhs) == ValueType::STRING) {
+		return lhs.as_string() < rhs.as_string();
+	}
+	return arithmetic(lhs, rhs, "<",
+		[](int a, int b) -> Value { return a < b; },
+		[](double a, double b) -> Value { return a < b; }).as_bool();
+}
+
+Value negate(const Value& value) {
+	if (type_of(value) == ValueType::DOUBLE) {
+		return -value.as_double();
+	}
+	return wrap(-static_cast<long long>(integer_of(value)));
+}
+
+Value unary_plus(const Value& value) {
+	if (type_of(value) == ValueType::DOUBLE) {
+		return value;
+	}
+	return integer_of(value);
+}
+
+Value binary_operation(Token::Type op, const Value& lhs, const Value& rhs) {
+	switch (op) {
+		case Token::PLUS: return add(lhs, rhs);
+		case Token::MINUS: return subtract(lhs, rhs);
+		case Token::MULTIPLY: return multiply(lhs, rhs);
+		case Token::DIVIDE: return divide(lhs, rhs);
+		case Token::MODULO: return modulo(lhs, rhs);
+		case Token::POWER: return power(lhs, rhs);
+		case Token::SHIFT_LEFT: return shift_left(lhs, rhs);
+		case Token::SHIFT_RIGHT: return shift_right(lhs, rhs);
+		case Token::EQUAL: return equal(lhs, rhs);
+		case Token::NOT_EQUAL: return !equal(lhs, rhs);
+		case Token::LESS: return less(lhs, rhs);
+		case Token::LESS_EQUAL: return !less(rhs, lhs);
+		case Token::GREATER: return less(rhs, lhs);
+		case Token::GREATER_EQUAL: return !less(lhs, rhs);
+		case Token::AND: return truthy(lhs) && truthy(rhs);
+		case Token::OR: return truthy(lhs) || truthy(rhs);
+		default: throw std::runtime_error("Unsupported binary operator " + std::string(Token::spelling(op)));
+	}
+}
+
+Value unary_operation(Token::Type op, const Value& value) {
+	switch (op) {
+		case Token::MINUS: return negate(value);
+		case Token::PLUS: return unary_plus(value);
+		case Token::NOT: return !truthy(value);
+		default: throw std::runtime_error("Unsupported unary operator " + std::string(Token::spelling(op)));
+	}
+}
@@ -0,0 +1,571 @@
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+#include <span>
+#include <utility>
+
+#include "vm.hpp"
+#include "builtins.hpp"
+#include "array.hpp"
+
+VirtualMachine::VirtualMachine(
+	const Program& program,
+	std::ostream& output,
+	Profiler* profiler,
+	std::size_t recursion_limit,
+	bool native,
+	std::size_t nursery_size,
+	const StopRequest* stop
+	) : program(program), heap(nursery_size), output(output), call_caches(program.call_sites.size()), globals(program.global_count), profiler(profiler), recursion_limit(recursion_limit), stop(stop) {
+	if (native && !profiler) {
+		jit = std::make_unique<Jit>(stop);
+		tiers.resize(program.functions.size());
+	}
+	for (auto& function : program.functions) {
+		if (function.defined) {
+			functions.emplace(function.name, &function);
+		}
+		if (profiler) {
+			profile_ids.push_back(profiler->function(function.name));
+		}
+	}
+}
+
+int VirtualMachine::run() {
+	auto execute = [this](std::size_t index) {
+		return profiler ? this->execute<true>(index) : this->execute<false>(index);
+	};
+	Heap::Scope scope(heap);
+	execute(program.initializer);
+	auto main = functions.find("main");
+	if (main == functions.end()) {
+		throw std::runtime_error("No main function defined");
+	} else if (!main->second->parameter_types.empty()) {
+		throw std::runtime_error("main must not take parameters");
+	}
+	auto result = execute(main->second - program.functions.data());
+	return type_of(result) == ValueType::INT ? result.as_int() : 0;
+}
+
+// Locals are addressed through the base index rather than a pointer, since
+// pushing an operand can move the whole stack.
+
+#define SAFEPOINT()                        \
+	if constexpr (profiled) {              \
+		if (Profiler::pending()) {         \
+			sample(pc);                    \
+		}                                  \
+	}
+
+#if VM_THREADED
+#define TARGET(name) op_##name
+#define DISPATCH()                         \
+	do {                                   \
+		SAFEPOINT();                       \
+		goto *(instruction = pc++)->handler; \
+	} while (0)
+#else
+#define TARGET(name) case OpCode::name
+#define DISPATCH() break
+#endif
+
+#define BINARY(operation)                                  \
+	{                                                      \
+		auto rhs = std::move(stack.back());                \
+		stack.pop_back();                                  \
+		stack.back() = operation(stack.back(), rhs);       \
+	}
+
+#define COMPARE_AND_JUMP(int_comparison, comparison)                         \
+	{                                                                      \
+		auto& lhs = stack[stack.size() - 2];                               \
+		auto& rhs = stack.back();                                          \
+		bool holds;                                                        \
+		if (auto a = lhs.int_if(), b = rhs.int_if(); a && b) { \
+			holds = int_comparison;                                        \
+		} else {                                                           \
+			holds = comparison;                                            \
+		}                                                                  \
+		stack.resize(stack.size() - 2);                                    \
+		if (!holds) {                                                      \
+			pc = frame->code + instruction->operand;                       \
+		}                                                                  \
+	}
+
+// A VirtualMachine only ever runs one of the two instantiations, so the
+// threaded code translated on first use always points into the right one.
+template<bool profiled>
+Value VirtualMachine::execute(std::size_t index) {
+#if VM_THREADED
+	static const void* const handlers[] = {
+#define OPCODE_HANDLER(name) &&op_##name,
+		OPCODES(OPCODE_HANDLER)
+#undef OPCODE_HANDLER
+	};
+	if (threaded_code.empty()) {
+		threaded_code.reserve(program.functions.size());
+		for (auto& function : program.functions) {
+			auto& code = threaded_code.emplace_back();
+			code.reserve(function.code.size());
+			for (auto& instruction : function.code) {
+				code.push_back(Code{handlers[static_cast<std::size_t>(instruction.op)], instruction.operand});
+			}
+		}
+	}
+#endif
+
+	auto& function = program.functions[index];
+	if constexpr (profiled) {
+		profiler->enter(profile_ids[index]);
+	}
+	auto depth = frames.size();
+	auto start = stack.size();
+	stack.resize(start + function.frame_size);
+	frames.push_back(Frame{&function, code_of(function), code_of(function), start});
+
+	Frame* frame = &frames.back();
+	const Code* pc = frame->pc;
+	const Code* instruction;
+	std::size_t base = frame->base;
+
+	auto enter = [&]() {
+		frame = &frames.back();
+		pc = frame->pc;
+		base = frame->base;
+	};
+
+#if VM_THREADED
+	DISPATCH();
+#else
+	while (true) {
+		SAFEPOINT();
+		instruction = pc++;
+		switch (instruction->op) {
+#endif
+			TARGET(CONSTANT):
+				stack.push_back(program.constants[instruction->operand]);
+				DISPATCH();
+			TARGET(POP):
+				stack.pop_back();
+				DISPATCH();
+			TARGET(DUP):
+				stack.push_back(stack.back());
+				DISPATCH();
+			TARGET(LOAD_LOCAL):
+				stack.push_back(stack[base + instruction->operand]);
+				DISPATCH();
+			TARGET(STORE_LOCAL):
+				stack[base + instruction->operand] = std::move(stack.back());
+				stack.pop_back();
+				DISPATCH();
+			TARGET(LOAD_GLOBAL):
+				stack.push_back(globals[instruction->operand]);
+				DISPATCH();
+			TARGET(STORE_GLOBAL):
+				globals[instruction->operand] = std::move(stack.back());
+				stack.pop_back();
+				DISPATCH();
+			TARGET(ADD): {
+				auto rhs = std::move(stack.back());
+				stack.pop_back();
+				add_to(stack.back(), rhs);
+				DISPATCH();
+			}
+			TARGET(SUBTRACT):
+				BINARY(subtract);
+				DISPATCH();
+			TARGET(MULTIPLY):
+				BINARY(multiply);
+				DISPATCH();
+			TARGET(DIVIDE):
+				BINARY(divide);
+				DISPATCH();
+			TARGET(MODULO):
+				BINARY(modulo);
+				DISPATCH();
+			TARGET(POWER):
+				BINARY(power);
+				DISPATCH();
+			TARGET(SHIFT_LEFT):
+				BINARY(shift_left);
+				DISPATCH();
+			TARGET(SHIFT_RIGHT):
+				BINARY(shift_right);
+				DISPATCH();
+			TARGET(EQUAL):
+				BINARY(equal);
+				DISPATCH();
+			TARGET(NOT_EQUAL):
+				BINARY(!equal);
+				DISPATCH();
+			TARGET(LESS):
+				BINARY(less);
+				DISPATCH();
+			TARGET(LESS_EQUAL): {
+				auto rhs = std::move(stack.back());
+				stack.pop_back();
+				stack.back() = !less(rhs, stack.back());
+				DISPATCH();
+			}
+			TARGET(GREATER): {
+				auto rhs = std::move(stack.back());
+				stack.pop_back();
+				stack.back() = less(rhs, stack.back());
+				DISPATCH();
+			}
+			TARGET(GREATER_EQUAL):
+				BINARY(!less);
+				DISPATCH();
+			TARGET(NEGATE):
+				stack.back() = negate(stack.back());
+				DISPATCH();
+			TARGET(PLUS):
+				stack.back() = unary_plus(stack.back());
+				DISPATCH();
+			TARGET(NOT):
+				stack.back() = !truthy(stack.back());
+				DISPATCH();
+			TARGET(CONVERT):
+				if (static_cast<std::int32_t>(type_of(stack.back())) != instruction->operand) {
+					stack.back() = convert(stack.back(), static_cast<ValueType>(instruction->operand));
+				}
+				DISPATCH();
+			TARGET(JUMP):
+				pc = frame->code + instruction->operand;
+				DISPATCH();
+			TARGET(LOOP):
+				check_stop();
+				pc = frame->code + instruction->operand;
+				if (jit) {
+					auto function = static_cast<std::size_t>(frame->function - program.functions.data());
+					if (auto code = native(function, false); code && code->enters(instruction->operand)) {
+						++tiers[function].loop_entries;
+						stack.push_back(run_native(*code, base, instruction->operand));
+						goto returned;
+					}
+				}
+				DISPATCH();
+			TARGET(JUMP_IF_FALSE): {
+				bool condition = truthy(stack.back());
+				stack.pop_back();
+				if (!condition) {
+					pc = frame->code + instruction->operand;
+				}
+				DISPATCH();
+			}
+			TARGET(CALL):
+				frame->pc = pc;
+				call<dynamic_arity>(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(CALL_0):
+				frame->pc = pc;
+				call<0>(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(CALL_1):
+				frame->pc = pc;
+				call<1>(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(CALL_2):
+				frame->pc = pc;
+				call<2>(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(CALL_3):
+				frame->pc = pc;
+				call<3>(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(RETURN):
+			returned: {
+				auto result = std::move(stack.back());
+				stack.resize(frame->base);
+				frames.pop_back();
+				if (frames.size() == depth) {
+					return result;
+				}
+				stack.push_back(std::move(result));
+				enter();
+				DISPATCH();
+			}
+			TARGET(TAIL_CALL):
+				frame->pc = pc;
+				tail_call(instruction->operand);
+				enter();
+				DISPATCH();
+			TARGET(DUP2):
+				stack.push_back(stack[stack.size() - 2]);
+				stack.push_back(stack[stack.size() - 2]);
+				DISPATCH();
+			TARGET(NEW_ARRAY):
+				stack.push_back(Array::make(element_of(static_cast<ValueType>(instruction->operand)), 0, false));
+				if (heap.due()) {
+					collect();
+				}
+				DISPATCH();
+			TARGET(NEW_FIXED_ARRAY):
+				stack.back() = Array::make(element_of(static_cast<ValueType>(instruction->operand)), array_size(stack.back()), true);
+				if (heap.due()) {
+					collect();
+				}
+				DISPATCH();
+			TARGET(LOAD_ELEMENT): {
+				auto element = load_element(stack[stack.size() - 2], stack.back(), instruction->operand);
+				stack.pop_back();
+				stack.back() = std::move(element);
+				DISPATCH();
+			}
+			TARGET(STORE_ELEMENT): {
+				auto top = stack.size();
+				auto stored = store_element(stack[top - 3], stack[top - 2], stack[top - 1], instruction->operand);
+				stack.resize(top - 2);
+				stack.back() = std::move(stored);
+				DISPATCH();
+			}
+			TARGET(INCREMENT_ELEMENT): {
+				auto& base = stack[stack.size() - 2];
+				auto index = element_index(base, stack.back(), true);
+				auto previous = base.as_array().get(index);
+				base.as_array().set(index, add(previous, instruction->operand));
+				stack.pop_back();
+				stack.back() = std::move(previous);
+				DISPATCH();
+			}
+			TARGET(APPEND_LOCAL):
+				add_to(stack[base + instruction->operand], stack.back());
+				stack.pop_back();
+				DISPATCH();
+			TARGET(JUMP_UNLESS_EQUAL):
+				COMPARE_AND_JUMP(*a == *b, equal(lhs, rhs));
+				DISPATCH();
+			TARGET(JUMP_UNLESS_NOT_EQUAL):
+				COMPARE_AND_JUMP(*a != *b, !equal(lhs, rhs));
+				DISPATCH();
+			TARGET(JUMP_UNLESS_LESS):
+				COMPARE_AND_JUMP(*a < *b, less(lhs, rhs));
+				DISPATCH();
+			TARGET(JUMP_UNLESS_LESS_EQUAL):
+				COMPARE_AND_JUMP(*a <= *b, !less(rhs, lhs));
+				DISPATCH();
+			TARGET(JUMP_UNLESS_GREATER):
+				COMPARE_AND_JUMP(*a > *b, less(rhs, lhs));
+				DISPATCH();
+			TARGET(JUMP_UNLESS_GREATER_EQUAL):
+				COMPARE_AND_JUMP(*a >= *b, !less(lhs, rhs));
+				DISPATCH();
+			TARGET(INCREMENT_LOCAL): {
+				auto& local = stack[base + instruction->operand];
+				if (auto number = local.int_if()) {
+					*number = static_cast<int>(static_cast<unsigned>(*number) + 1u);
+				} else {
+					local = convert(add(local, 1), type_of(local));
+				}
+				DISPATCH();
+			}
+			TARGET(DECREMENT_LOCAL): {
+				auto& local = stack[base + instruction->operand];
+				if (auto number = local.int_if()) {
+					*number = static_cast<int>(static_cast<unsigned>(*number) - 1u);
+				} else {
+					local = convert(subtract(local, 1), type_of(local));
+				}
+				DISPATCH();
+			}
+#if !VM_THREADED
+		}
+	}
+#endif
+}
+
+#undef COMPARE_AND_JUMP
+#undef BINARY
+#undef DISPATCH
+#undef TARGET
+#undef SAFEPOINT
+
+template<std::size_t Arity>
+void VirtualMachine::call(std::int32_t site) {
+	check_stop();
+	const std::size_t argument_count = Arity == dynamic_arity ? program.call_sites[site].argument_count : Arity;
+	auto base = stack.size() - argument_count;
+	auto& cache = resolve(site);
+	if (!cache.function) {
+		auto result = cache.builtin->call(std::span<const Value>(stack.data() + base, argument_count), output);
+		stack.resize(base);
+		stack.push_back(std::move(result));
+		return;
+	}
+	if (profiler) {
+		profiler->enter(profile_ids[cache.function - program.functions.data()]);
+	}
+	if (frames.size() >= recursion_limit) {
+		throw std::runtime_error("Recursion limit of " + std::to_string(recursion_limit) + " calls exceeded in " + cache.function->name);
+	}
+	bind(*cache.function, base, base);
+	if (jit) {
+		auto function = static_cast<std::size_t>(cache.function - program.functions.data());
+		if (auto code = native(function, true)) {
+			++tiers[function].native_calls;
+			auto result = run_native(*code, base, 0);
+			stack.resize(base);
+			stack.push_back(std::move(result));
+			return;
+		}
+	}
+	frames.push_back(Frame{cache.function, cache.code, cache.code, base});
+}
+
+// The arguments are moved down over the caller's locals, so a chain of tail
+// calls runs in one frame.
+void VirtualMachine::tail_call(std::int32_t site) {
+	check_stop();
+	auto& cache = resolve(site);
+	if (!cache.function) {
+		call<dynamic_arity>(site);
+		return;
+	}
+	if (profiler) {
+		profiler->enter(profile_ids[cache.function - program.functions.data()]);
+	}
+	auto& frame = frames.back();
+	bind(*cache.function, frame.base, stack.size() - program.call_sites[site].argument_count);
+	frame.function = cache.function;
+	frame.code = frame.pc = cache.code;
+}
+
+// Looks the callee up on a site's first call and checks the argument count,
+// which is fixed per site, then answers from the site's cache.
+const VirtualMachine::CallCache& VirtualMachine::resolve(std::int32_t index) {
+	auto& cache = call_caches[index];
+	if (cache.function || cache.builtin) {
+		++cache_hits;
+		return cache;
+	}
+	++cache_misses;
+	auto& site = program.call_sites[index];
+	if (auto callee = functions.find(site.name); callee != functions.end()) {
+		auto& function = *callee->second;
+		if (function.parameter_types.size() != site.argument_count) {
+			throw std::runtime_error("Function " + site.name + " expects " + std::to_string(function.parameter_types.size())
+				+ " arguments, got " + std::to_string(site.argument_count));
+		}
+		cache.function = &function;
+		cache.code = code_of(function);
+	} else if (!(cache.builtin = find_builtin(site.name))) {
+		throw std::runtime_error("Function " + site.name + " is declared but not defined");
+	}
+	return cache;
+}
+
+// Turns the arguments at the top of the stack into the locals of a frame
+// starting at base, which may be where they already are.
+void VirtualMachine::bind(const Function& function, std::size_t base, std::size_t arguments) {
+	auto count = function.parameter_types.size();
+	for (std::size_t i = 0; i < count; ++i) {
+		auto& argument = stack[arguments + i];
+		if (type_of(argument) != function.parameter_types[i]) {
+			argument = convert(argument, function.parameter_types[i]);
+		}
+		if (arguments != base) {
+			stack[base + i] = std::move(argument);
+		}
+	}
+	stack.resize(base + count);
+	stack.resize(base + function.frame_size);
+}
+
+// The function's native code, compiling it the first time it is found hot.
+const Jit::Code* VirtualMachine::native(std::size_t index, bool called) {
+	auto& tier = tiers[index];
+	++(called ? tier.calls : tier.iterations);
+	if (tier.code || !tier.rejection.empty() || (tier.calls < hot_calls && tier.iterations < hot_iterations)) {
+		return tier.code;
+	}
+	tier.code = jit->compile(program.functions[index], program, tier.rejection);
+	return tier.code;
+}
+
+// Runs native code on the locals of the frame at base, which the VM has
+// already set up.
+Value VirtualMachine::run_native(const Jit::Code& code, std::size_t base, std::uint32_t start) {
+	Value result;
+	switch (code.entry(stack.data() + base, start, &result)) {
+		case Jit::Status::DIVISION_BY_ZERO:
+			throw std::runtime_error("Division by zero");
+		case Jit::Status::SHIFT_OUT_OF_RANGE:
+			throw std::runtime_error("Shift count " + std::to_string(result.as_int()) + " is out of range");
+		case Jit::Status::STOPPED:
+			stopped(stop->load(std::memory_order_relaxed));
+		default:
+			return result;
+	}
+}
+
+void VirtualMachine::write_jit_report(std::ostream& output) const {
+	if (!jit) {
+		output << "JIT: off\n";
+		return;
+	}
+	std::size_t ran = 0;
+	std::size_t compiled = 0;
+	std::size_t bytes = 0;
+	for (auto& tier : tiers) {
+		ran += tier.calls || tier.iterations;
+		if (tier.code) {
+			++compiled;
+			bytes += tier.code->size;
+		}
+	}
+	output << "JIT: " << compiled << " of " << ran << " functions compiled, " << bytes << " bytes of native code\n";
+	output << std::setw(12) << "calls" << std::setw(12) << "iterations" << std::setw(8) << "native" << std::setw(8) << "loops"
+		<< std::setw(8) << "bytes" << "  function\n";
+	for (std::size_t i = 0; i < tiers.size(); ++i) {
+		auto& tier = tiers[i];
+		if (!tier.calls && !tier.iterations) {
+			continue;
+		}
+		output << std::setw(12) << tier.calls << std::setw(12) << tier.iterations << std::setw(8) << tier.native_calls
+			<< std::setw(8) << tier.loop_entries << std::setw(8) << (tier.code ? std::to_string(tier.code->size) : "-")
+			<< "  " << program.functions[i].name;
+		if (!tier.rejection.empty()) {
+			output << " (not compiled: " << tier.rejection << ")";
+		}
+		output << '\n';
+	}
+}
+
+const VirtualMachine::Code* VirtualMachine::code_of(const Function& function) const {
+#if VM_THREADED
+	return threaded_code[&function - program.functions.data()].data();
+#else
+	return function.code.data();
+#endif
+}
+
+void VirtualMachine::sample(const Code* pc) {
+	std::vector<std::uint32_t> stack;
+	stack.reserve(frames.size());
+	for (auto& frame : frames) {
+		stack.push_back(profile_ids[frame.function - program.functions.data()]);
+	}
+	auto& top = frames.back();
+	auto& locations = top.function->locations;
+	auto instruction = static_cast<std::uint32_t>(pc - top.code);
+	auto location = std::upper_bound(locations.begin(), locations.end(), instruction,
+		[](std::uint32_t instruction, const Location& location) { return instruction < location.instruction; });
+	profiler->sample(stack, location == locations.begin() ? Profiler::no_offset : std::prev(location)->offset);
+}
+
+void VirtualMachine::stopped(const char* reason) {
+	throw std::runtime_error(reason);
+}
+
+void VirtualMachine::collect() {
+	heap.collect([this] {
+		heap.mark(globals);
+		heap.mark(stack);
+	});
+}